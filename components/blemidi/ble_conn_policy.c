@@ -0,0 +1,105 @@
+/**
+ * @file ble_conn_policy.c
+ *
+ * @brief Connection parameter negotiation for low latency MIDI.
+ */
+
+#include "ble_conn_policy.h"
+#include <string.h>
+
+/**
+ * BLE MIDI asks for 15 ms or less, 7.5 ms being the shortest interval the
+ * spec allows. Latency stays 0 on every step: a skipped connection event
+ * is a late MIDI message.
+ */
+static const ble_conn_params_t steps[] = {
+    { .min_int = 6,  .max_int = 12, .latency = 0, .timeout = BLE_CONN_POLICY_TIMEOUT },     // 7.5 - 15 ms
+    { .min_int = 12, .max_int = 12, .latency = 0, .timeout = BLE_CONN_POLICY_TIMEOUT },     // 15 ms, for centrals that want a fixed value
+    { .min_int = 12, .max_int = 24, .latency = 0, .timeout = BLE_CONN_POLICY_TIMEOUT },     // 15 - 30 ms
+    { .min_int = 24, .max_int = 40, .latency = 0, .timeout = BLE_CONN_POLICY_TIMEOUT },     // 30 - 50 ms
+};
+#define STEP_COUNT  (sizeof(steps) / sizeof(steps[0]))
+
+static const char * state_names[BLE_CONN_POLICY_MAX] = {"idle", "requested", "accepted", "gave up"};
+
+//***************************************************************************************************************
+
+// Request the given step, or the next one the backend manages to send
+static void ble_conn_policy_request(ble_conn_policy_t * policy, uint8_t step) {
+    for(; step < STEP_COUNT; step++) {
+        policy->step = step;
+        policy->stats.requests++;
+        if(policy->backend->request(policy->backend->ctx, &steps[step]) == ESP_OK) {
+            policy->state = BLE_CONN_POLICY_REQUESTED;
+            return;
+        }
+        policy->stats.rejections++;
+    }
+    policy->state = BLE_CONN_POLICY_GAVE_UP;
+}
+
+//***************************************************************************************************************
+
+esp_err_t ble_conn_policy_init(ble_conn_policy_t * policy, const ble_conn_policy_backend_t * backend) {
+    if(!policy || !backend || !backend->request) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(policy, 0, sizeof(ble_conn_policy_t));
+    policy->backend = backend;
+    return ESP_OK;
+}
+
+void ble_conn_policy_on_connect(ble_conn_policy_t * policy, uint16_t interval, uint16_t latency, uint16_t timeout) {
+    if(!policy) return;
+
+    policy->interval = interval;
+    policy->latency = latency;
+    policy->timeout = timeout;
+    ble_conn_policy_request(policy, 0);
+}
+
+void ble_conn_policy_on_update(ble_conn_policy_t * policy, bool accepted, uint16_t interval, uint16_t latency, uint16_t timeout) {
+    if(!policy || policy->state == BLE_CONN_POLICY_IDLE) return;
+
+    if(accepted) {
+        policy->stats.updates++;
+        policy->interval = interval;
+        policy->latency = latency;
+        policy->timeout = timeout;
+    }
+
+    // Updates the central starts on its own are only recorded
+    if(policy->state != BLE_CONN_POLICY_REQUESTED) return;
+
+    const ble_conn_params_t * step = &steps[policy->step];
+    if(accepted && interval >= step->min_int && interval <= step->max_int && latency <= step->latency) {
+        policy->state = BLE_CONN_POLICY_ACCEPTED;
+        return;
+    }
+
+    policy->stats.rejections++;
+    ble_conn_policy_request(policy, policy->step + 1);
+}
+
+void ble_conn_policy_on_disconnect(ble_conn_policy_t * policy) {
+    if(!policy) return;
+
+    policy->state = BLE_CONN_POLICY_IDLE;
+    policy->step = 0;
+    policy->interval = 0;
+    policy->latency = 0;
+    policy->timeout = 0;
+}
+
+uint8_t ble_conn_policy_step_count(void) {
+    return STEP_COUNT;
+}
+
+const ble_conn_params_t * ble_conn_policy_step(uint8_t step) {
+    return step < STEP_COUNT ? &steps[step] : NULL;
+}
+
+const char * ble_conn_policy_state_to_string(ble_conn_policy_state_e state) {
+    return state < BLE_CONN_POLICY_MAX ? state_names[state] : "unknown";
+}
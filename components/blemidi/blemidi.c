@@ -39,6 +39,9 @@
 
 #include "esp_system.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #include "esp_bt.h"
 #include "esp_gap_ble_api.h"
@@ -46,10 +49,16 @@
 #include "esp_bt_main.h"
 #include "esp_gatt_common_api.h"
 
+#if CONFIG_HEAP_TRACING_STANDALONE
+#include "esp_heap_trace.h"
+#endif
+
 // Services
 #include "ble_common.h"
 #include "ble_midi_service.h"
 #include "ble_battery_service.h"
+#include "ble_conn_policy.h"
+#include "blemidi_packet.h"
 
 
 #define BIOMIDI_PROFILE_NUM                 1       // Number of profiles in application
@@ -65,8 +74,18 @@
 
 static uint8_t adv_config_done       = 0;
 
-// the MTU can be changed by the client during runtime
-static size_t blemidi_mtu = GATTS_MIDI_CHAR_VAL_LEN_MAX - 3;
+// the MTU can be changed by the client during runtime, the packet builders follow it
+// negotiated ATT MTU, 23 until the client exchanges it
+#define BLEMIDI_ATT_MTU_DEFAULT 23
+static uint16_t blemidi_att_mtu = BLEMIDI_ATT_MTU_DEFAULT;
+
+// connection parameters are negotiated by the policy, see ble_conn_policy.h
+// the policy only runs in the BTC task, the application reads a copy taken after every event
+static ble_conn_policy_t blemidi_conn_policy;
+static ble_conn_policy_t blemidi_conn_snapshot;
+static esp_bd_addr_t blemidi_remote_bda;
+static uint8_t blemidi_connected = 0;
+static portMUX_TYPE blemidi_conn_lock = portMUX_INITIALIZER_UNLOCKED;
 
 
 
@@ -80,6 +99,10 @@ typedef struct {
 
 static prepare_type_env_t prepare_write_env;
 
+// nothing on the send and receive paths comes from the heap, the GATT callbacks all run in the BTC task
+static uint8_t blemidi_prepare_buf[PREPARE_BUF_MAX_SIZE];
+static esp_gatt_rsp_t blemidi_gatt_rsp;
+
 
 /* The length of adv data must be less than 31 bytes */
 static esp_ble_adv_data_t adv_data = {
@@ -87,7 +110,7 @@ static esp_ble_adv_data_t adv_data = {
     .include_name        = false, // exclude name to ensure that we don't exceed 31 bytes...
     .include_txpower     = true,
     .min_interval        = 0x0006, //slave connection min interval, Time = min_interval * 1.25 msec
-    .max_interval        = 0x0010, //slave connection max interval, Time = max_interval * 1.25 msec
+    .max_interval        = 0x000C, //slave connection max interval, Time = max_interval * 1.25 msec
     .appearance          = 0x00,
     .manufacturer_len    = 0,    //TEST_MANUFACTURER_DATA_LEN,
     .p_manufacturer_data = NULL, //test_manufacturer,
@@ -103,8 +126,8 @@ static esp_ble_adv_data_t scan_rsp_data = {
     .set_scan_rsp        = true,
     .include_name        = true,
     .include_txpower     = true,
-    .min_interval        = 0x0001,  // The minimum and maximum slave preferred connection intervals are set in units of 1.25 ms
-    .max_interval        = 0x000A,  //The BLE MIDI device must request a connection interval of 15 ms or less
+    .min_interval        = 0x0006,  // The minimum and maximum slave preferred connection intervals are set in units of 1.25 ms
+    .max_interval        = 0x000C,  //The BLE MIDI device must request a connection interval of 15 ms or less
     .appearance          = 0x00,
     .manufacturer_len    = 0, //TEST_MANUFACTURER_DATA_LEN,
     .p_manufacturer_data = NULL, //&test_manufacturer[0],
@@ -161,9 +184,14 @@ void (*blemidi_callback_on_disconnect)();
 static uint16_t blemidi_timestamp = 0;
 
 // we buffer outgoing MIDI messages for 10 mS - this should avoid that multiple BLE packets have to be queued for small messages
-static uint8_t  blemidi_outbuffer[BLEMIDI_NUM_PORTS][GATTS_MIDI_CHAR_VAL_LEN_MAX];
-static uint16_t blemidi_outbuffer_len[BLEMIDI_NUM_PORTS];
+// packets are built by blemidi_packet.c, see blemidi_packet.h for the running status rules
+static blemidi_packet_t blemidi_outbuffer[BLEMIDI_NUM_PORTS];
 static uint16_t blemidi_outbuffer_timestamp_last_flush = 0;
+// the builders are used by the controller task, the BTC task (MTU changes) and blemidi_heap_check()
+static StaticSemaphore_t blemidi_outbuffer_mutex_buffer;
+static SemaphoreHandle_t blemidi_outbuffer_mutex = NULL;
+// set by blemidi_heap_check() while it holds the mutex, packets are built but not indicated
+static volatile uint8_t blemidi_outbuffer_dry_run = 0;
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Timestamp handling
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -184,6 +212,68 @@ void blemidi_tick(void)
   }
 }
 
+static void blemidi_conn_publish(void)
+{
+  portENTER_CRITICAL(&blemidi_conn_lock);
+  blemidi_conn_snapshot = blemidi_conn_policy;
+  portEXIT_CRITICAL(&blemidi_conn_lock);
+}
+
+uint32_t blemidi_get_conn_interval_us(void)
+{
+  portENTER_CRITICAL(&blemidi_conn_lock);
+  uint16_t interval = blemidi_conn_snapshot.interval;
+  portEXIT_CRITICAL(&blemidi_conn_lock);
+
+  if( interval == 0 )
+    interval = BLEMIDI_CONN_INTERVAL_DEFAULT;
+  return (uint32_t)interval * BLE_CONN_INTERVAL_UNIT_US;
+}
+
+int32_t blemidi_get_conn_info(blemidi_conn_info_t *info)
+{
+  if( info == NULL )
+    return -1;
+
+  portENTER_CRITICAL(&blemidi_conn_lock);
+  ble_conn_policy_t policy = blemidi_conn_snapshot;
+  info->connected = blemidi_connected;
+  info->mtu = blemidi_att_mtu;
+  portEXIT_CRITICAL(&blemidi_conn_lock);
+
+  info->interval_us = (uint32_t)policy.interval * BLE_CONN_INTERVAL_UNIT_US;
+  info->latency = policy.latency;
+  info->timeout_ms = (uint32_t)policy.timeout * BLE_CONN_TIMEOUT_UNIT_MS;
+  info->policy_state = ble_conn_policy_state_to_string(policy.state);
+  info->policy_step = policy.step;
+  info->requests = policy.stats.requests;
+  info->rejections = policy.stats.rejections;
+  info->updates = policy.stats.updates;
+
+  return 0; // no error
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Connection parameter requests on behalf of the policy, called from the BTC task
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static esp_err_t blemidi_conn_request(void *ctx, const ble_conn_params_t *params)
+{
+  esp_ble_conn_update_params_t conn_params = {0};
+  memcpy(conn_params.bda, blemidi_remote_bda, sizeof(esp_bd_addr_t));
+  conn_params.min_int = params->min_int;
+  conn_params.max_int = params->max_int;
+  conn_params.latency = params->latency;
+  conn_params.timeout = params->timeout;
+
+  ESP_LOGI(BLEMIDI_TAG, "requesting connection interval %d..%d, latency %d", conn_params.min_int, conn_params.max_int, conn_params.latency);
+  return esp_ble_gap_update_conn_params(&conn_params);
+}
+
+static const ble_conn_policy_backend_t blemidi_conn_policy_backend = {
+  .request = blemidi_conn_request,
+  .ctx = NULL,
+};
+
 uint8_t blemidi_timestamp_high(void)
 {
   return (0x80 | ((blemidi_timestamp >> 7) & 0x3f));
@@ -195,6 +285,23 @@ uint8_t blemidi_timestamp_low(void)
 }
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Indicates a finished packet, called by the packet builder
+////////////////////////////////////////////////////////////////////////////////////////////////////
+static void blemidi_outbuffer_indicate(void *ctx, const uint8_t *packet, size_t len)
+{
+  if( blemidi_outbuffer_dry_run )
+    return;
+
+  esp_ble_gatts_send_indicate(midi_profile_tab[BIOMIDI_APP_PROFILE_IDX].gatts_if, midi_profile_tab[BIOMIDI_APP_PROFILE_IDX].conn_id, midi_handle_table[BIOMIDI_IDX_VAL], len, (uint8_t *)packet, false);
+}
+
+static const blemidi_packet_backend_t blemidi_outbuffer_backend = {
+  .send = blemidi_outbuffer_indicate,
+  .ctx = NULL,
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Flush Output Buffer (normally done by blemidi_tick_ms each 15 mS)
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -202,107 +309,105 @@ int32_t blemidi_outbuffer_flush(uint8_t blemidi_port)
 {
   if( blemidi_port >= BLEMIDI_NUM_PORTS )
     return -1; // invalid port
+  if( blemidi_outbuffer_mutex == NULL )
+    return -2; // not initialized
 
-  if( blemidi_outbuffer_len[blemidi_port] > 0 ) {
-    esp_ble_gatts_send_indicate(midi_profile_tab[BIOMIDI_APP_PROFILE_IDX].gatts_if, midi_profile_tab[BIOMIDI_APP_PROFILE_IDX].conn_id, midi_handle_table[BIOMIDI_IDX_VAL], blemidi_outbuffer_len[blemidi_port], blemidi_outbuffer[blemidi_port], false);
-    blemidi_outbuffer_len[blemidi_port] = 0;
-  }
+  xSemaphoreTake(blemidi_outbuffer_mutex, portMAX_DELAY);
+  blemidi_packet_flush(&blemidi_outbuffer[blemidi_port]);
+  xSemaphoreGive(blemidi_outbuffer_mutex);
   return 0; // no error
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// Push a new MIDI message to the output buffer
+// Sends a BLE MIDI message
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-static int32_t blemidi_outbuffer_push(uint8_t blemidi_port, uint8_t *stream, size_t len)
+int32_t blemidi_send_message(uint8_t blemidi_port, uint8_t *stream, size_t len)
 {
-  const size_t max_header_size = 2;
-
   if( blemidi_port >= BLEMIDI_NUM_PORTS )
     return -1; // invalid port
 
-  // if len >= MTU, it makes sense to send out immediately
-  if( len >= (blemidi_mtu-max_header_size) ) {
-    // this is very unlikely, since applemidi_send_message() maintains the size
-    // but just in case of future extensions, we prepare dynamic memory allocation for "big packets"
-    blemidi_outbuffer_flush(blemidi_port);
-    {
-      size_t packet_len = max_header_size + len;
-      uint8_t *packet = malloc(packet_len);
-      if( packet == NULL ) {
-        return -1; // couldn't create temporary packet
-      } else {
-        // new packet: with timestampHigh and timestampLow, or in case of continued SysEx packet: only timestampHigh
-        packet[0] = blemidi_timestamp_high();
-        if( stream[0] >= 0x80 ) {
-          packet[1] = blemidi_timestamp_low();
-          memcpy((uint8_t *)packet + 2, stream, len);
-        } else {
-          packet_len -= 1;
-          memcpy((uint8_t *)packet + 1, stream, len);
-        }
-
-        esp_ble_gatts_send_indicate(midi_profile_tab[BIOMIDI_APP_PROFILE_IDX].gatts_if, midi_profile_tab[BIOMIDI_APP_PROFILE_IDX].conn_id, midi_handle_table[BIOMIDI_IDX_VAL], packet_len, packet, false);
-        free(packet);
-      }
-    }
-  } else {
-    // flush buffer before adding new message
-    if( (blemidi_outbuffer_len[blemidi_port] + len) >= blemidi_mtu )
-      blemidi_outbuffer_flush(blemidi_port);
-
-    // adding new message
-    if( blemidi_outbuffer_len[blemidi_port] == 0 ) {
-      // new packet: with timestampHigh and timestampLow, or in case of continued SysEx packet: only timestampHigh
-      blemidi_outbuffer[blemidi_port][blemidi_outbuffer_len[blemidi_port]++] = blemidi_timestamp_high();
-      if( stream[0] >= 0x80 ) {
-        blemidi_outbuffer[blemidi_port][blemidi_outbuffer_len[blemidi_port]++] = blemidi_timestamp_low();
-      }
-    } else {
-      blemidi_outbuffer[blemidi_port][blemidi_outbuffer_len[blemidi_port]++] = blemidi_timestamp_low();
-    }
+  if( blemidi_outbuffer_mutex == NULL )
+    return -2; // not initialized
 
-    memcpy(&blemidi_outbuffer[blemidi_port][blemidi_outbuffer_len[blemidi_port]], stream, len);
-    blemidi_outbuffer_len[blemidi_port] += len;
-  }
+  // messages that don't fit into one packet are split over multiple packets
+  xSemaphoreTake(blemidi_outbuffer_mutex, portMAX_DELAY);
+  esp_err_t err = blemidi_packet_send(&blemidi_outbuffer[blemidi_port], blemidi_timestamp, stream, len);
+  xSemaphoreGive(blemidi_outbuffer_mutex);
+  if( err != ESP_OK )
+    return -1;
 
   return 0; // no error
 }
 
-
+#if CONFIG_HEAP_TRACING_STANDALONE
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-// Sends a BLE MIDI message
+// Heap tracing test mode: runs the packetizer on CCs and a segmented SysEx and counts allocations
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-int32_t blemidi_send_message(uint8_t blemidi_port, uint8_t *stream, size_t len)
+#define BLEMIDI_HEAP_TRACE_RECORDS 64
+static heap_trace_record_t blemidi_heap_trace_records[BLEMIDI_HEAP_TRACE_RECORDS];
+
+int32_t blemidi_heap_check(size_t *allocations)
 {
-  const size_t max_header_size = 2;
+  // big enough for several packets at the largest MTU
+  static uint8_t sysex[3 * GATTS_MIDI_CHAR_VAL_LEN_MAX];
+  uint8_t cc[3] = { 0xb0, 0x10, 0x00 };
+  blemidi_packet_t *packet = &blemidi_outbuffer[0];
 
-  if( blemidi_port >= BLEMIDI_NUM_PORTS )
-    return -1; // invalid port
+  if( allocations == NULL || blemidi_outbuffer_mutex == NULL )
+    return -1;
 
-  // we've to consider blemidi_mtu
-  // if more bytes need to be sent, split over multiple packets
-  // this will cost some extra stack space :-/ therefore handled separatly?
-
-  if( len < (blemidi_mtu-max_header_size) ) {
-    // just add to output buffer
-    blemidi_outbuffer_push(blemidi_port, stream, len);
-  } else {
-    // sending packets
-    size_t max_size = blemidi_mtu - max_header_size; // -3 since blemidi_outbuffer_push() will add the timestamps
-    int pos;
-    for(pos=0; pos<len; pos += max_size) {
-      size_t packet_len = len-pos;
-      if( packet_len >= max_size ) {
-        packet_len = max_size;
-      }
-      blemidi_outbuffer_push(blemidi_port, &stream[pos], packet_len);
-    }
+  sysex[0] = 0xf0;
+  for(size_t i = 1; i < sizeof(sysex) - 1; ++i) {
+    sysex[i] = i & 0x7f;
+  }
+  sysex[sizeof(sysex) - 1] = 0xf7;
+
+  if( heap_trace_init_standalone(blemidi_heap_trace_records, BLEMIDI_HEAP_TRACE_RECORDS) != ESP_OK )
+    return -2;
+
+  // the controller tick and the MTU event wait on the mutex until the check is done
+  xSemaphoreTake(blemidi_outbuffer_mutex, portMAX_DELAY);
+  blemidi_packet_flush(packet);
+  // indications would hand the packets to Bluedroid, which copies them into its own buffers
+  blemidi_outbuffer_dry_run = 1;
+
+  // the trace sees every allocation in the system: with the scheduler suspended nothing else
+  // runs on this core, so the records made on this core come from the packetizer
+  uint32_t core = xPortGetCoreID();
+  vTaskSuspendAll();
+  heap_trace_start(HEAP_TRACE_ALL);
+  for(uint8_t i = 0; i < 128; ++i) {
+    cc[1] = 0x10 + (i & 0x07);
+    cc[2] = i;
+    blemidi_packet_send(packet, blemidi_timestamp, cc, sizeof(cc));
   }
+  blemidi_packet_send(packet, blemidi_timestamp, sysex, sizeof(sysex));
+  blemidi_packet_flush(packet);
+  heap_trace_stop();
+  xTaskResumeAll();
 
+  blemidi_outbuffer_dry_run = 0;
+  xSemaphoreGive(blemidi_outbuffer_mutex);
 
+  // a full record buffer may have dropped some of ours
+  size_t count = heap_trace_get_count();
+  if( count >= BLEMIDI_HEAP_TRACE_RECORDS )
+    return -3;
+
+  *allocations = 0;
+  for(size_t i = 0; i < count; ++i) {
+    heap_trace_record_t record;
+    // the LSB of ccount is the core that allocated
+    if( heap_trace_get(i, &record) != ESP_OK || (record.ccount & 1) != core )
+      continue;
+
+    ESP_LOGW(BLEMIDI_TAG, "packetizer allocated %u bytes, called from %p", (unsigned)record.size, record.alloced_by[0]);
+    ++*allocations;
+  }
   return 0; // no error
 }
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Sends a BLE Battery Level
@@ -358,6 +463,13 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
                   param->update_conn_params.conn_int,
                   param->update_conn_params.latency,
                   param->update_conn_params.timeout);
+            // the policy moves on to the next fallback when the central said no
+            ble_conn_policy_on_update(&blemidi_conn_policy,
+                                      param->update_conn_params.status == ESP_BT_STATUS_SUCCESS,
+                                      param->update_conn_params.conn_int,
+                                      param->update_conn_params.latency,
+                                      param->update_conn_params.timeout);
+            blemidi_conn_publish();
             break;
         default:
             break;
@@ -369,35 +481,28 @@ static void blemidi_prepare_write_event_env(esp_gatt_if_t gatts_if, prepare_type
     ESP_LOGI(BLEMIDI_TAG, "prepare write, handle = %d, value len = %d", param->write.handle, param->write.len);
     esp_gatt_status_t status = ESP_GATT_OK;
     if (prepare_write_env->prepare_buf == NULL) {
-        prepare_write_env->prepare_buf = (uint8_t *)malloc(PREPARE_BUF_MAX_SIZE * sizeof(uint8_t));
+        prepare_write_env->prepare_buf = blemidi_prepare_buf;
         prepare_write_env->prepare_len = 0;
-        if (prepare_write_env->prepare_buf == NULL) {
-            ESP_LOGE(BLEMIDI_TAG, "%s, Gatt_server prep no mem", __func__);
-            status = ESP_GATT_NO_RESOURCES;
-        }
-    } else {
-        if(param->write.offset > PREPARE_BUF_MAX_SIZE) {
-            status = ESP_GATT_INVALID_OFFSET;
-        } else if ((param->write.offset + param->write.len) > PREPARE_BUF_MAX_SIZE) {
-            status = ESP_GATT_INVALID_ATTR_LEN;
-        }
+    }
+    if(param->write.offset > PREPARE_BUF_MAX_SIZE) {
+        status = ESP_GATT_INVALID_OFFSET;
+    } else if ((param->write.offset + param->write.len) > PREPARE_BUF_MAX_SIZE) {
+        status = ESP_GATT_INVALID_ATTR_LEN;
     }
     /*send response when param->write.need_rsp is true */
     if (param->write.need_rsp){
-        esp_gatt_rsp_t *gatt_rsp = (esp_gatt_rsp_t *)malloc(sizeof(esp_gatt_rsp_t));
-        if (gatt_rsp != NULL){
-            gatt_rsp->attr_value.len = param->write.len;
-            gatt_rsp->attr_value.handle = param->write.handle;
-            gatt_rsp->attr_value.offset = param->write.offset;
-            gatt_rsp->attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
+        esp_gatt_rsp_t *gatt_rsp = &blemidi_gatt_rsp;
+        memset(gatt_rsp, 0, sizeof(esp_gatt_rsp_t));
+        gatt_rsp->attr_value.len = param->write.len;
+        gatt_rsp->attr_value.handle = param->write.handle;
+        gatt_rsp->attr_value.offset = param->write.offset;
+        gatt_rsp->attr_value.auth_req = ESP_GATT_AUTH_REQ_NONE;
+        if (param->write.len <= sizeof(gatt_rsp->attr_value.value)) {
             memcpy(gatt_rsp->attr_value.value, param->write.value, param->write.len);
-            esp_err_t response_err = esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, status, gatt_rsp);
-            if (response_err != ESP_OK){
-               ESP_LOGE(BLEMIDI_TAG, "Send response error");
-            }
-            free(gatt_rsp);
-        }else{
-            ESP_LOGE(BLEMIDI_TAG, "%s, malloc failed", __func__);
+        }
+        esp_err_t response_err = esp_ble_gatts_send_response(gatts_if, param->write.conn_id, param->write.trans_id, status, gatt_rsp);
+        if (response_err != ESP_OK){
+           ESP_LOGE(BLEMIDI_TAG, "Send response error");
         }
     }
     if (status != ESP_GATT_OK){
@@ -416,10 +521,7 @@ static void blemidi_exec_write_event_env(prepare_type_env_t *prepare_write_env,
     }else{
         ESP_LOGI(BLEMIDI_TAG,"ESP_GATT_PREP_WRITE_CANCEL");
     }
-    if (prepare_write_env->prepare_buf) {
-        free(prepare_write_env->prepare_buf);
-        prepare_write_env->prepare_buf = NULL;
-    }
+    prepare_write_env->prepare_buf = NULL;
     prepare_write_env->prepare_len = 0;
 }
 
@@ -489,16 +591,29 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
             ESP_LOGI(BLEMIDI_TAG, "ESP_GATTS_MTU_EVT, MTU %d", param->mtu.mtu);
 
             // change MTU for BLE MIDI transactions
-            if( param->mtu.mtu <= 3 ) {
-              blemidi_mtu = 3; // very unlikely...
-            } else {
-              // we decrease -10 to prevent following driver warning:
-              //  (30774) BT_GATT: attribute value too long, to be truncated to 97
-              blemidi_mtu = param->mtu.mtu - 3;
-              // failsave
-              if( blemidi_mtu > (GATTS_MIDI_CHAR_VAL_LEN_MAX-3) )
-                blemidi_mtu = (GATTS_MIDI_CHAR_VAL_LEN_MAX-3);
+            {
+              size_t blemidi_mtu;
+              if( param->mtu.mtu <= 3 ) {
+                blemidi_mtu = 3; // very unlikely...
+              } else {
+                // we decrease -10 to prevent following driver warning:
+                //  (30774) BT_GATT: attribute value too long, to be truncated to 97
+                blemidi_mtu = param->mtu.mtu - 3;
+                // failsave
+                if( blemidi_mtu > (GATTS_MIDI_CHAR_VAL_LEN_MAX-3) )
+                  blemidi_mtu = (GATTS_MIDI_CHAR_VAL_LEN_MAX-3);
+              }
+
+              uint8_t blemidi_port;
+              xSemaphoreTake(blemidi_outbuffer_mutex, portMAX_DELAY);
+              for(blemidi_port=0; blemidi_port<BLEMIDI_NUM_PORTS; ++blemidi_port) {
+                blemidi_packet_set_mtu(&blemidi_outbuffer[blemidi_port], blemidi_mtu);
+              }
+              xSemaphoreGive(blemidi_outbuffer_mutex);
             }
+            portENTER_CRITICAL(&blemidi_conn_lock);
+            blemidi_att_mtu = param->mtu.mtu;
+            portEXIT_CRITICAL(&blemidi_conn_lock);
             break;
         case ESP_GATTS_CONF_EVT:
             // ESP_LOGI(BLEMIDI_TAG, "ESP_GATTS_CONF_EVT, status = %d, attr_handle %d", param->conf.status, param->conf.handle);
@@ -509,21 +624,27 @@ static void gatts_profile_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_
         case ESP_GATTS_CONNECT_EVT:
             ESP_LOGI(BLEMIDI_TAG, "ESP_GATTS_CONNECT_EVT, conn_id = %d", param->connect.conn_id);
             esp_log_buffer_hex(BLEMIDI_TAG, param->connect.remote_bda, 6);
-            esp_ble_conn_update_params_t conn_params = {0};
-            memcpy(conn_params.bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+            memcpy(blemidi_remote_bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
             /* For the iOS system, please refer to Apple official documents about the BLE connection parameters restrictions. */
-            conn_params.latency = 0;
-            conn_params.max_int = 0x10;    // max_int = 0x10*1.25ms = 20ms
-            conn_params.min_int = 0x0b;    // min_int = 0x0b*1.25ms = 15ms
-            conn_params.timeout = 400;    // timeout = 400*10ms = 4000ms
-            //start sent the update connection parameters to the peer device.
-            esp_ble_gap_update_conn_params(&conn_params);
+            // ask for the shortest interval, the policy falls back on rejection
+            ble_conn_policy_on_connect(&blemidi_conn_policy, param->connect.conn_params.interval,
+                                       param->connect.conn_params.latency, param->connect.conn_params.timeout);
+            portENTER_CRITICAL(&blemidi_conn_lock);
+            blemidi_connected = 1;
+            portEXIT_CRITICAL(&blemidi_conn_lock);
+            blemidi_conn_publish();
 
             // Call on_connect callback
             blemidi_callback_on_connect();
             break;
         case ESP_GATTS_DISCONNECT_EVT:
             ESP_LOGI(BLEMIDI_TAG, "ESP_GATTS_DISCONNECT_EVT, reason = 0x%x", param->disconnect.reason);
+            ble_conn_policy_on_disconnect(&blemidi_conn_policy);
+            portENTER_CRITICAL(&blemidi_conn_lock);
+            blemidi_connected = 0;
+            blemidi_att_mtu = BLEMIDI_ATT_MTU_DEFAULT;
+            portEXIT_CRITICAL(&blemidi_conn_lock);
+            blemidi_conn_publish();
             esp_ble_gap_start_advertising(&adv_params);
             // Call on_disconnect callback
             blemidi_callback_on_disconnect();
@@ -677,11 +798,16 @@ int32_t blemidi_init(void *_callback_midi_message_received, void *_callback_midi
     return -8;
   }
 
+  // Connection parameter negotiation
+  ESP_ERROR_CHECK(ble_conn_policy_init(&blemidi_conn_policy, &blemidi_conn_policy_backend));
+  blemidi_conn_publish();
+
   // Output Buffer
   {
+    blemidi_outbuffer_mutex = xSemaphoreCreateMutexStatic(&blemidi_outbuffer_mutex_buffer);
     uint32_t blemidi_port;
     for(blemidi_port=0; blemidi_port<BLEMIDI_NUM_PORTS; ++blemidi_port) {
-      blemidi_outbuffer_len[blemidi_port] = 0;
+      ESP_ERROR_CHECK(blemidi_packet_init(&blemidi_outbuffer[blemidi_port], &blemidi_outbuffer_backend, GATTS_MIDI_CHAR_VAL_LEN_MAX - 3));
       blemidi_continued_sysex_pos[blemidi_port] = 0;
     }
   }
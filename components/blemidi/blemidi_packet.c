@@ -0,0 +1,140 @@
+/**
+ * @file blemidi_packet.c
+ *
+ * @brief BLE-MIDI packet builder for outgoing messages.
+ */
+
+#include "blemidi_packet.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define MAX_HEADER_SIZE     2       // timestampHigh and timestampLow
+#define MIN_MTU             3
+
+//***************************************************************************************************************
+
+static inline uint8_t timestamp_high(uint16_t timestamp) {
+    return 0x80 | ((timestamp >> 7) & 0x3F);
+}
+
+static inline uint8_t timestamp_low(uint16_t timestamp) {
+    return 0x80 | (timestamp & 0x7F);
+}
+
+static inline bool is_channel_status(uint8_t status) {
+    return status >= 0x80 && status < 0xF0;
+}
+
+static size_t clamp_mtu(size_t mtu) {
+    if(mtu < MIN_MTU) return MIN_MTU;
+    if(mtu > BLEMIDI_PACKET_MAX_LEN) return BLEMIDI_PACKET_MAX_LEN;
+    return mtu;
+}
+
+//***************************************************************************************************************
+
+esp_err_t blemidi_packet_init(blemidi_packet_t * packet, const blemidi_packet_backend_t * backend, size_t mtu) {
+    if(!packet || !backend || !backend->send || mtu < MIN_MTU || mtu > BLEMIDI_PACKET_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(packet, 0, sizeof(blemidi_packet_t));
+    packet->backend = backend;
+    packet->mtu = mtu;
+    return ESP_OK;
+}
+
+void blemidi_packet_set_mtu(blemidi_packet_t * packet, size_t mtu) {
+    if(!packet) return;
+    packet->mtu = clamp_mtu(mtu);
+}
+
+void blemidi_packet_flush(blemidi_packet_t * packet) {
+    if(!packet) return;
+
+    if(packet->len > 0) {
+        packet->backend->send(packet->backend->ctx, packet->buffer, packet->len);
+        packet->len = 0;
+    }
+    // Running status never spans packets
+    packet->running_status = 0;
+}
+
+esp_err_t blemidi_packet_push(blemidi_packet_t * packet, uint16_t timestamp, const uint8_t * stream, size_t len) {
+    if(!packet || !stream || len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t status = stream[0];
+    size_t max_size = packet->mtu - MAX_HEADER_SIZE;
+
+    // Too long to share a packet, send it on its own right away
+    if(len >= max_size) {
+        blemidi_packet_flush(packet);
+        if(MAX_HEADER_SIZE + len > sizeof(packet->buffer)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        // Continued SysEx only has timestampHigh
+        packet->buffer[packet->len++] = timestamp_high(timestamp);
+        if(status >= 0x80) {
+            packet->buffer[packet->len++] = timestamp_low(timestamp);
+        }
+        memcpy(&packet->buffer[packet->len], stream, len);
+        packet->len += len;
+        blemidi_packet_flush(packet);
+        return ESP_OK;
+    }
+
+    if(packet->len + len >= packet->mtu) {
+        blemidi_packet_flush(packet);
+    }
+
+    // Repeated channel status in this packet, timestampLow and the data bytes only
+    bool running = packet->len > 0 && is_channel_status(status) && status == packet->running_status && len > 1;
+
+    if(packet->len == 0) {
+        packet->buffer[packet->len++] = timestamp_high(timestamp);
+        if(status >= 0x80) {
+            packet->buffer[packet->len++] = timestamp_low(timestamp);
+        }
+    } else {
+        packet->buffer[packet->len++] = timestamp_low(timestamp);
+    }
+
+    if(running) {
+        memcpy(&packet->buffer[packet->len], stream + 1, len - 1);
+        packet->len += len - 1;
+    } else {
+        memcpy(&packet->buffer[packet->len], stream, len);
+        packet->len += len;
+    }
+
+    // Channel messages set the running status, any system message ends it
+    if(is_channel_status(status)) {
+        packet->running_status = status;
+    } else if(status >= 0xF0) {
+        packet->running_status = 0;
+    }
+    return ESP_OK;
+}
+
+esp_err_t blemidi_packet_send(blemidi_packet_t * packet, uint16_t timestamp, const uint8_t * stream, size_t len) {
+    if(!packet || !stream || len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t max_size = packet->mtu - MAX_HEADER_SIZE;
+    if(len < max_size) {
+        return blemidi_packet_push(packet, timestamp, stream, len);
+    }
+
+    for(size_t pos = 0; pos < len; pos += max_size) {
+        size_t segment = len - pos < max_size ? len - pos : max_size;
+        esp_err_t err = blemidi_packet_push(packet, timestamp, &stream[pos], segment);
+        if(err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file ble_conn_policy.h
+ *
+ * @brief Connection parameter negotiation for low latency MIDI.
+ *
+ * After connect the peripheral asks for the shortest interval first and
+ * walks down a fallback table every time the central rejects a request or
+ * settles outside the requested range. Once a step is accepted, or the
+ * table runs out, whatever the central picked is kept.
+ *
+ * The policy has no knowledge of the BLE stack: sending the update request
+ * is provided by a backend, events are fed in by the GAP handler.
+ */
+
+#ifndef _BLE_CONN_POLICY_H_
+#define _BLE_CONN_POLICY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+// Intervals are in 1.25 ms units, supervision timeout in 10 ms units
+#define BLE_CONN_INTERVAL_UNIT_US       1250
+#define BLE_CONN_TIMEOUT_UNIT_MS        10
+
+#ifndef BLE_CONN_POLICY_TIMEOUT
+#define BLE_CONN_POLICY_TIMEOUT         400         // 4 s
+#endif
+
+typedef struct {
+    uint16_t min_int;
+    uint16_t max_int;
+    uint16_t latency;               // Connection events the peripheral may skip
+    uint16_t timeout;
+} ble_conn_params_t;
+
+typedef enum {
+    BLE_CONN_POLICY_IDLE = 0,       // Not connected
+    BLE_CONN_POLICY_REQUESTED,      // Waiting for the central to answer a request
+    BLE_CONN_POLICY_ACCEPTED,       // Central settled inside a requested range
+    BLE_CONN_POLICY_GAVE_UP,        // Fallbacks exhausted, the central's choice is kept
+    BLE_CONN_POLICY_MAX,
+} ble_conn_policy_state_e;
+
+typedef struct {
+    esp_err_t (*request)(void * ctx, const ble_conn_params_t * params);    // Send a parameter update request
+    void * ctx;
+} ble_conn_policy_backend_t;
+
+typedef struct {
+    uint32_t requests;              // Update requests sent
+    uint32_t rejections;            // Requests refused or answered outside the range
+    uint32_t updates;               // Parameter updates reported by the central
+} ble_conn_policy_stats_t;
+
+typedef struct {
+    const ble_conn_policy_backend_t * backend;
+    ble_conn_policy_state_e state;
+    uint8_t step;                   // Fallback table entry last requested
+    uint16_t interval;              // Current connection interval, 0 if unknown
+    uint16_t latency;
+    uint16_t timeout;
+    ble_conn_policy_stats_t stats;
+} ble_conn_policy_t;
+
+esp_err_t ble_conn_policy_init(ble_conn_policy_t * policy, const ble_conn_policy_backend_t * backend);
+
+// Record the parameters the central connected with and request the first table entry
+void ble_conn_policy_on_connect(ble_conn_policy_t * policy, uint16_t interval, uint16_t latency, uint16_t timeout);
+
+/**
+ * @brief Feed a connection parameter update from the central.
+ *
+ * @param accepted False if the central rejected the last request.
+ * @param interval Interval in use, only read when accepted.
+ */
+void ble_conn_policy_on_update(ble_conn_policy_t * policy, bool accepted, uint16_t interval, uint16_t latency, uint16_t timeout);
+
+void ble_conn_policy_on_disconnect(ble_conn_policy_t * policy);
+
+// Number of entries of the fallback table and one of them
+uint8_t ble_conn_policy_step_count(void);
+const ble_conn_params_t * ble_conn_policy_step(uint8_t step);
+
+const char * ble_conn_policy_state_to_string(ble_conn_policy_state_e state);
+
+#endif //_BLE_CONN_POLICY_H_
@@ -4,10 +4,11 @@
 #include "stdint.h"
 #include "esp_gatt_defs.h"
 #include <string.h>
+#include "blemidi_packet.h"
 /* The max length of characteristic value. When the GATT client performs a write or prepare write operation,
 *  the data length must be less than GATTS_MIDI_CHAR_VAL_LEN_MAX.
 */
-#define GATTS_MIDI_CHAR_VAL_LEN_MAX 100
+#define GATTS_MIDI_CHAR_VAL_LEN_MAX BLEMIDI_PACKET_MAX_LEN
 #define BLEMIDI_NUM_PORTS 1
 
 /* Enumeration of the services and characteristics */
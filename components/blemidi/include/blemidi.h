@@ -39,6 +39,7 @@ extern "C" {
 
 #include <stdint.h>
 #include <stddef.h>
+#include "sdkconfig.h"
 
 
 #ifndef BLEMIDI_DEVICE_NAME
@@ -56,6 +57,11 @@ extern "C" {
 #define BLEMIDI_OUTBUFFER_FLUSH_MS 15
 #endif
 
+// Connection interval assumed until the central reports one, in 1.25 mS units
+#ifndef BLEMIDI_CONN_INTERVAL_DEFAULT
+#define BLEMIDI_CONN_INTERVAL_DEFAULT 12
+#endif
+
 /**
  * @brief Initializes the BLEMIDI Server
  *
@@ -120,6 +126,35 @@ extern void blemidi_receive_packet_callback_for_debugging(uint8_t blemidi_port,
  */
 extern void blemidi_tick(void);
 
+typedef struct {
+  uint8_t connected;
+  uint32_t interval_us;         // negotiated connection interval, 0 if unknown
+  uint16_t latency;             // connection events the peripheral may skip
+  uint32_t timeout_ms;          // supervision timeout
+  uint16_t mtu;                 // ATT MTU
+  const char *policy_state;     // where the interval negotiation stands
+  uint8_t policy_step;          // fallback step last requested
+  uint32_t requests;            // connection parameter requests sent
+  uint32_t rejections;          // requests refused by the central
+  uint32_t updates;             // parameter updates reported by the central
+} blemidi_conn_info_t;
+
+/**
+ * @brief Returns the negotiated connection parameters and the negotiation counters
+ *
+ * @param  info         filled with the current values
+ *
+ * @return < 0 on errors
+ */
+extern int32_t blemidi_get_conn_info(blemidi_conn_info_t *info);
+
+/**
+ * @brief Returns the current connection interval, one BLE packet per connection event is what the link carries
+ *
+ * @return interval in uS, BLEMIDI_CONN_INTERVAL_DEFAULT while no update was received
+ */
+extern uint32_t blemidi_get_conn_interval_us(void);
+
 /**
  * @brief This function returns the high part of the timestamp
 
@@ -134,6 +169,19 @@ extern uint8_t blemidi_timestamp_high(void);
  */
 extern uint8_t blemidi_timestamp_low(void);
 
+#if CONFIG_HEAP_TRACING_STANDALONE
+/**
+ * @brief Heap tracing test mode, runs CCs and a SysEx longer than the MTU through the packetizer
+ *        with heap tracing on. Packets are built but not indicated. Sends and flushes from other
+ *        tasks wait until the check is done.
+ *
+ * @param  allocations  number of allocations made by the packetizer, expected to be 0 (the callers are logged otherwise)
+ *
+ * @return < 0 on errors, -3 if the trace buffer filled up and the count can't be trusted
+ */
+extern int32_t blemidi_heap_check(size_t *allocations);
+#endif
+
 #if BLEMIDI_ENABLE_CONSOLE
 /**
  * @brief Register Console Commands
@@ -0,0 +1,73 @@
+/**
+ * @file blemidi_packet.h
+ *
+ * @brief BLE-MIDI packet builder for outgoing messages.
+ *
+ * Messages are collected into one packet until the next one would not fit
+ * the MTU or the packet is flushed. The packet starts with timestampHigh and
+ * every message gets a timestampLow. A channel message repeating the status
+ * of the previous one in the same packet is sent as running status, without
+ * its status byte. Running status never spans packets and any system
+ * message ends it, realtime included: MIDI lets realtime messages keep it,
+ * but not every BLE-MIDI parser does (ours in ble_midi_service.c doesn't).
+ *
+ * Messages of MTU - 2 bytes or more go out in packets of their own, longer
+ * streams are split over several. Continuation packets of a SysEx stream
+ * only carry timestampHigh.
+ *
+ * The builder has no knowledge of the BLE stack, finished packets are
+ * handed to a backend.
+ */
+
+#ifndef _BLEMIDI_PACKET_H_
+#define _BLEMIDI_PACKET_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+// Largest characteristic value, also the size of the packet buffer
+#define BLEMIDI_PACKET_MAX_LEN      100
+
+typedef struct {
+    void (*send)(void * ctx, const uint8_t * packet, size_t len);     // Send a finished packet
+    void * ctx;
+} blemidi_packet_backend_t;
+
+typedef struct {
+    const blemidi_packet_backend_t * backend;
+    uint8_t buffer[BLEMIDI_PACKET_MAX_LEN];
+    uint16_t len;                   // Bytes in the packet being built
+    uint16_t mtu;                   // Largest packet to build
+    uint8_t running_status;         // Last channel status in the packet, 0 if none
+} blemidi_packet_t;
+
+/**
+ * @brief Set up a packet builder.
+ *
+ * @param packet Builder state.
+ * @param backend Where finished packets go.
+ * @param mtu Largest packet in bytes, at least 3 and at most BLEMIDI_PACKET_MAX_LEN.
+ */
+esp_err_t blemidi_packet_init(blemidi_packet_t * packet, const blemidi_packet_backend_t * backend, size_t mtu);
+
+// Change the largest packet size, clamped to the range blemidi_packet_init() takes
+void blemidi_packet_set_mtu(blemidi_packet_t * packet, size_t mtu);
+
+// Send the packet being built, if any, and end running status
+void blemidi_packet_flush(blemidi_packet_t * packet);
+
+/**
+ * @brief Add a MIDI message, or a part of a longer stream, to the packet.
+ *
+ * @param packet Builder state.
+ * @param timestamp Milliseconds, only the low 13 bits are sent.
+ * @param stream Message bytes, starting with the status unless it continues a SysEx stream.
+ * @param len Number of bytes, up to BLEMIDI_PACKET_MAX_LEN - 2.
+ */
+esp_err_t blemidi_packet_push(blemidi_packet_t * packet, uint16_t timestamp, const uint8_t * stream, size_t len);
+
+// Like blemidi_packet_push(), streams that don't fit one packet are split over several
+esp_err_t blemidi_packet_send(blemidi_packet_t * packet, uint16_t timestamp, const uint8_t * stream, size_t len);
+
+#endif //_BLEMIDI_PACKET_H_
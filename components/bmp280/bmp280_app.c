@@ -3,6 +3,7 @@
 #include "esp_log.h"
 #include "esp_err.h"
 #include "common.h"
+#include "app_mailbox.h"
 
 static const char *TAG = "BMP280_App";
 SemaphoreHandle_t xBMP280DataMutex;
@@ -10,25 +11,8 @@ SemaphoreHandle_t xBMP280DataMutex;
 static bmp280_data_t bmp_data;
 
 esp_err_t bmp280_send_data() {
-    app_data_t data_temperature = {
-        .id = DATA_ID_TEMPERATURE,
-        .data = bmp_data.temperature
-    };
-
-    if (xQueueSend( xQueueAppData, (void *)&data_temperature, 0 ) == pdFAIL) {
-        ESP_LOGE(TAG, "ERROR sendig data to queue");
-        return ESP_ERR_TIMEOUT;
-    }
-    app_data_t data_pressure = {
-        .id = DATA_ID_PRESSURE,
-        .data = bmp_data.pressure
-    };
-
-    if (xQueueSend( xQueueAppData, (void *)&data_pressure, 0 ) == pdFAIL) {
-        ESP_LOGE(TAG, "ERROR sendig data to queue");
-        return ESP_ERR_TIMEOUT;
-    }
-
+    app_mailbox_publish(DATA_ID_TEMPERATURE, bmp_data.temperature);
+    app_mailbox_publish(DATA_ID_PRESSURE, bmp_data.pressure);
     return ESP_OK;
 }
 
@@ -45,7 +29,7 @@ void vBMP280Task( void *pvParameters ) {
 
     // Wait for I2C tasks
     xEventGroupWaitBits(xEventGroupTasks,
-                        BIT_TASK_I2C_READ | BIT_TASK_I2C_WRITE,
+                        BIT_TASK_I2C,
                         pdFALSE,
                         pdTRUE,
                         portMAX_DELAY);
@@ -1,5 +1,7 @@
 #include "bmp280_driver.h"
 #include "i2c_app.h"
+#include "i2c_scheduler.h"
+#include "i2c_driver.h"
 #include <esp_log.h>
 
 //***************************************************************************************************************
@@ -7,64 +9,57 @@
 static const char *TAG = "BMP280_Driver";
 
 static esp_err_t bmp280_read(uint8_t reg, size_t len, uint8_t * data_buf) {
-
-    I2C_Status i2c_msg = {
-        .data = data_buf,
-        .device_address = BMP280_I2C_ADDRESS_0,
-        .register_address = reg,
-        .size = len
-    };
-
-    if(xQueueSend( xQueueI2CReadBuffer, (void *)&i2c_msg, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "Error writing to I2C Buffer");
-        return ESP_ERR_TIMEOUT;
+    esp_err_t err = i2c_app_read(BMP280_I2C_ADDRESS_0, reg, len, data_buf);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error reading from I2C: %s", esp_err_to_name(err));
     }
-
-    if (xSemaphoreTake( xBinarySemaphoreI2CAppEndOfRead, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "Error waiting i2c end of write");
-        return ESP_ERR_TIMEOUT;
-	}
-
-    return ESP_OK;
+    return err;
 }
 
 static esp_err_t bmp280_write(uint8_t reg, size_t len, uint8_t * data_buf) {
-    // Write data to i2c
-    I2C_Status i2c_msg = {
-        .data = data_buf,
-        .device_address = BMP280_I2C_ADDRESS_0,
-        .register_address = reg,
-        .size = len
-    };
-
-    if(xQueueSend( xQueueI2CWriteBuffer, (void *)&i2c_msg, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "Error writing to I2C Buffer");
-        return ESP_ERR_TIMEOUT;
+    esp_err_t err = i2c_app_write(BMP280_I2C_ADDRESS_0, reg, len, data_buf);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error writing to I2C: %s", esp_err_to_name(err));
     }
-
-    if (xSemaphoreTake( xBinarySemaphoreI2CAppEndOfWrite, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "Error waiting i2c end of write");
-        return ESP_ERR_TIMEOUT;
-	}
-    return ESP_OK;
+    return err;
 }
 
 //***********************************************************************************************
 
 static esp_err_t read_calibration_data(BMP280_compensation_t * compensation)
 {
-    ESP_ERROR_CHECK(bmp280_read(BMP_280_REG_COMP_T1, 2, (uint8_t *)&compensation->dig_T1));
-    ESP_ERROR_CHECK(bmp280_read(BMP_280_REG_COMP_T2, 2, (uint8_t *)&compensation->dig_T2));
-    ESP_ERROR_CHECK(bmp280_read(BMP_280_REG_COMP_T3, 2, (uint8_t *)&compensation->dig_T3));
-    ESP_ERROR_CHECK(bmp280_read(BMP_280_REG_COMP_P1, 2, (uint8_t *)&compensation->dig_P1));
-    ESP_ERROR_CHECK(bmp280_read(BMP_280_REG_COMP_P2, 2, (uint8_t *)&compensation->dig_P2));
-    ESP_ERROR_CHECK(bmp280_read(BMP_280_REG_COMP_P3, 2, (uint8_t *)&compensation->dig_P3));
-    ESP_ERROR_CHECK(bmp280_read(BMP_280_REG_COMP_P4, 2, (uint8_t *)&compensation->dig_P4));
-    ESP_ERROR_CHECK(bmp280_read(BMP_280_REG_COMP_P5, 2, (uint8_t *)&compensation->dig_P5));
-    ESP_ERROR_CHECK(bmp280_read(BMP_280_REG_COMP_P6, 2, (uint8_t *)&compensation->dig_P6));
-    ESP_ERROR_CHECK(bmp280_read(BMP_280_REG_COMP_P7, 2, (uint8_t *)&compensation->dig_P7));
-    ESP_ERROR_CHECK(bmp280_read(BMP_280_REG_COMP_P8, 2, (uint8_t *)&compensation->dig_P8));
-    ESP_ERROR_CHECK(bmp280_read(BMP_280_REG_COMP_P9, 2, (uint8_t *)&compensation->dig_P9));
+    struct {
+        uint8_t reg;
+        void * data;
+    } calibration[] = {
+        {BMP_280_REG_COMP_T1, &compensation->dig_T1},
+        {BMP_280_REG_COMP_T2, &compensation->dig_T2},
+        {BMP_280_REG_COMP_T3, &compensation->dig_T3},
+        {BMP_280_REG_COMP_P1, &compensation->dig_P1},
+        {BMP_280_REG_COMP_P2, &compensation->dig_P2},
+        {BMP_280_REG_COMP_P3, &compensation->dig_P3},
+        {BMP_280_REG_COMP_P4, &compensation->dig_P4},
+        {BMP_280_REG_COMP_P5, &compensation->dig_P5},
+        {BMP_280_REG_COMP_P6, &compensation->dig_P6},
+        {BMP_280_REG_COMP_P7, &compensation->dig_P7},
+        {BMP_280_REG_COMP_P8, &compensation->dig_P8},
+        {BMP_280_REG_COMP_P9, &compensation->dig_P9},
+    };
+
+    // Queue every read and wait once for all of them
+    i2c_completion_t done;
+    i2c_app_completion_init(&done, I2C_APP_NOTIFY_BIT);
+    for(uint8_t i = 0; i < sizeof(calibration)/sizeof(calibration[0]); i++) {
+        I2C_Status i2c_msg = {
+            .op = I2C_OP_READ,
+            .device_address = BMP280_I2C_ADDRESS_0,
+            .register_address = calibration[i].reg,
+            .size = 2,
+            .data = (uint8_t *)calibration[i].data,
+        };
+        ESP_ERROR_CHECK(i2c_app_submit(&i2c_msg, &done, portMAX_DELAY));
+    }
+    ESP_ERROR_CHECK(i2c_app_wait(&done, portMAX_DELAY));
 
     ESP_LOGD(TAG, "Calibration data received:");
     ESP_LOGD(TAG, "dig_T1=%d", compensation->dig_T1);
@@ -143,6 +138,8 @@ static inline uint32_t compensate_pressure(BMP280_compensation_t *comp, int32_t
 esp_err_t bmp280_init(bmp280_params_t * params, BMP280_compensation_t * comp) {
     if(!params) return ESP_ERR_INVALID_ARG;
 
+    i2c_bus_register_device(BMP280_I2C_ADDRESS_0, BMP280_MAX_CLK_HZ);
+
     // Check presence
     uint8_t id;
     bmp280_read(BMP280_REG_ID, 1, &id);
@@ -150,6 +147,9 @@ esp_err_t bmp280_init(bmp280_params_t * params, BMP280_compensation_t * comp) {
         ESP_LOGE(TAG, "Invalid chip ID: expected: 0x%x (BME280) got: 0x%x", BMP280_CHIP_ID, id);
     }
 
+    // Start-up time after soft reset is 2 ms (datasheet 1.1)
+    i2c_sched_add_constraint(BMP280_I2C_ADDRESS_0, BMP280_REG_RESET, 2000);
+
     // Soft reset
     uint8_t reset_value = BMP280_RESET_VALUE;
     bmp280_write(BMP280_REG_RESET, 1, &reset_value);
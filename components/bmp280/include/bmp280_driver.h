@@ -11,6 +11,7 @@ extern "C" {
 
 #define BMP280_I2C_ADDRESS_0  0x76 //!< I2C address when SDO pin is low
 #define BMP280_CHIP_ID  0x58 //!< BMP280 has chip-id 0x58
+#define BMP280_MAX_CLK_HZ  400000 //!< I2C fast mode
 
 /**
  * BMP280 registers
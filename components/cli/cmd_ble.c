@@ -0,0 +1,80 @@
+#include "cmd_ble.h"
+#include "blemidi.h"
+#include <stdio.h>
+#include <string.h>
+#include "argtable3/argtable3.h"
+#include "esp_console.h"
+#include "esp_log.h"
+
+static const char *TAG = "cmd_ble";
+
+static int cmd_ble_conn(int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    blemidi_conn_info_t info;
+    if (blemidi_get_conn_info(&info) < 0) {
+        ESP_LOGE(TAG, "Connection info not available");
+        return 1;
+    }
+
+    printf("Connected: %s\n", info.connected ? "yes" : "no");
+    if (info.connected) {
+        printf("Interval: %u.%02u ms\nLatency: %u\nTimeout: %u ms\nMTU: %u\n",
+                (unsigned) (info.interval_us / 1000), (unsigned) (info.interval_us % 1000) / 10,
+                (unsigned) info.latency, (unsigned) info.timeout_ms, (unsigned) info.mtu);
+    }
+    printf("Negotiation: %s, step %u\nRequests: %u\nRejections: %u\nUpdates: %u\n",
+            info.policy_state, (unsigned) info.policy_step, (unsigned) info.requests,
+            (unsigned) info.rejections, (unsigned) info.updates);
+    return 0;
+}
+
+static void register_ble_conn(void)
+{
+    const esp_console_cmd_t ble_conn_cmd = {
+        .command = "ble_conn",
+        .help = "Show the negotiated BLE connection interval, latency and MTU",
+        .hint = NULL,
+        .func = &cmd_ble_conn
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&ble_conn_cmd));
+}
+
+#if CONFIG_HEAP_TRACING_STANDALONE
+static int cmd_ble_heap_check(int argc, char **argv)
+{
+    (void) argc;
+    (void) argv;
+
+    size_t allocations = 0;
+    int32_t err = blemidi_heap_check(&allocations);
+    if (err < 0) {
+        ESP_LOGE(TAG, "Heap check failed (%d)", (int) err);
+        return 1;
+    }
+
+    printf("BLE MIDI packetizer: %u allocations\n", (unsigned) allocations);
+    return allocations == 0 ? 0 : 1;
+}
+
+static void register_ble_heap_check(void)
+{
+    const esp_console_cmd_t ble_heap_check_cmd = {
+        .command = "ble_heap_check",
+        .help = "Trace the heap while CCs and a long SysEx go through the BLE MIDI packetizer, nothing is sent",
+        .hint = NULL,
+        .func = &cmd_ble_heap_check
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&ble_heap_check_cmd));
+}
+#endif
+
+void register_ble(void)
+{
+    register_ble_conn();
+#if CONFIG_HEAP_TRACING_STANDALONE
+    register_ble_heap_check();
+#endif
+}
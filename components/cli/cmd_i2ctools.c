@@ -11,6 +11,7 @@
 #include "argtable3/argtable3.h"
 #include "i2c_driver.h"
 #include "i2c_app.h"
+#include "i2c_scheduler.h"
 #include "esp_console.h"
 #include "esp_log.h"
 
@@ -81,22 +82,10 @@ static int do_i2cget_cmd(int argc, char **argv)
     }
     uint8_t *data = malloc(len);
 
-    portBASE_TYPE xStatus;
-    I2C_Status i2c_command;
-    memset(&i2c_command, 0, sizeof(I2C_Status));
-
-    i2c_command.device_address = chip_addr;
-    i2c_command.register_address = data_addr;
-    i2c_command.data = data;
-    i2c_command.size = len;
-
-    xStatus = xQueueSend( xQueueI2CReadBuffer, (void *)&i2c_command, portMAX_DELAY );
-
-    // Wait for end of writing process
-    xStatus = xSemaphoreTake( xBinarySemaphoreI2CAppEndOfRead, portMAX_DELAY );
-
-    if (xStatus == pdFAIL)
+    esp_err_t err = i2c_app_read(chip_addr, data_addr, len, data);
+    if (err != ESP_OK)
 	{
+        free(data);
 		return 1;
 	}
 
@@ -153,27 +142,17 @@ static int do_i2cset_cmd(int argc, char **argv)
     int len = i2cset_args.data->count;
 
 
-    portBASE_TYPE xStatus;
-    I2C_Status i2c_command;
-    memset(&i2c_command, 0, sizeof(I2C_Status));
-    uint8_t * data = (uint8_t *) i2cset_args.data->ival;
-
-
-    i2c_command.device_address = chip_addr;
-    i2c_command.register_address = data_addr;
-    i2c_command.data = data;
-    i2c_command.size = len;
-
-    xStatus = xQueueSend( xQueueI2CWriteBuffer, (void *)&i2c_command, portMAX_DELAY );
-
-    // Wait for end of writing process
-    xStatus = xSemaphoreTake( xBinarySemaphoreI2CAppEndOfWrite, portMAX_DELAY );
+    uint8_t data[256];
+    for (int i = 0; i < len; i++) {
+        data[i] = (uint8_t) i2cset_args.data->ival[i];
+    }
 
-    if (xStatus == pdFAIL)
+    esp_err_t err = i2c_app_write(chip_addr, data_addr, len, data);
+    if (err != ESP_OK)
 	{
 		return 1;
 	}
-    
+
     return 0;
 }
 
@@ -193,6 +172,116 @@ static void register_i2cset(void)
     ESP_ERROR_CHECK(esp_console_cmd_register(&i2cset_cmd));
 }
 
+static struct {
+    struct arg_lit *reset;
+    struct arg_end *end;
+} i2cstats_args;
+
+static int do_i2cstats_cmd(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&i2cstats_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, i2cstats_args.end, argv[0]);
+        return 0;
+    }
+
+    i2c_sched_stats_t stats;
+    i2c_sched_get_stats(&stats);
+
+    printf("\nTransactions: %u \
+    \nErrors: %u \
+    \nBusy: %llu us \
+    \nSettle wait: %llu us \
+    \nWindow: %llu us \
+    \nLongest transaction: %u us \
+    \nUtilization: %.2f %%\n", (unsigned) stats.transactions, (unsigned) stats.errors, stats.busy_us, stats.settle_wait_us, stats.window_us, (unsigned) stats.max_transaction_us, stats.utilization);
+
+    i2c_engine_stats_t engine_stats;
+    i2c_app_get_engine_stats(&engine_stats);
+
+    printf("\nSubmitted: %u \
+    \nCompleted: %u \
+    \nRejected: %u \
+    \nMax pending: %u \
+    \nMax latency: %u us\n", (unsigned) engine_stats.submitted, (unsigned) engine_stats.completed, (unsigned) engine_stats.rejected, (unsigned) engine_stats.max_pending, (unsigned) engine_stats.max_latency_us);
+
+    if (i2cstats_args.reset->count) {
+        i2c_sched_reset_stats();
+    }
+
+    return 0;
+}
+
+static void register_i2cstats(void)
+{
+    i2cstats_args.reset = arg_lit0("r", "reset", "Reset statistics after printing");
+    i2cstats_args.end = arg_end(1);
+    const esp_console_cmd_t i2cstats_cmd = {
+        .command = "i2cstats",
+        .help = "Show I2C bus utilization",
+        .hint = NULL,
+        .func = &do_i2cstats_cmd,
+        .argtable = &i2cstats_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&i2cstats_cmd));
+}
+
+static struct {
+    struct arg_str *profile;
+    struct arg_end *end;
+} i2cprofile_args;
+
+static int do_i2cprofile_cmd(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&i2cprofile_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, i2cprofile_args.end, argv[0]);
+        return 0;
+    }
+
+    /* Change profile: "-p" option */
+    if (i2cprofile_args.profile->count) {
+        const char *name = i2cprofile_args.profile->sval[0];
+        i2c_bus_profile_e profile;
+        for (profile = 0; profile < I2C_BUS_PROFILE_MAX; profile++) {
+            if (strcmp(name, i2c_bus_profile_to_string(profile)) == 0) {
+                break;
+            }
+        }
+        if (profile == I2C_BUS_PROFILE_MAX) {
+            ESP_LOGE(TAG, "Unknown profile %s", name);
+            return 1;
+        }
+        if (i2c_bus_set_profile(profile) != ESP_OK) {
+            return 1;
+        }
+    }
+
+    printf("Profile: %s\nClock: %u Hz\n", i2c_bus_profile_to_string(i2c_bus_get_profile()), (unsigned) i2c_bus_get_clock());
+
+    i2c_bus_device_t devices[I2C_BUS_MAX_DEVICES];
+    uint8_t len = i2c_bus_get_devices(devices, I2C_BUS_MAX_DEVICES);
+    for (uint8_t i = 0; i < len; i++) {
+        printf("Device 0x%02x: max %u Hz\n", devices[i].device_address, (unsigned) devices[i].max_clk_hz);
+    }
+
+    return 0;
+}
+
+static void register_i2cprofile(void)
+{
+    i2cprofile_args.profile = arg_str0("p", "profile", "<standard|fast|fast-plus>", "Set the bus profile");
+    i2cprofile_args.end = arg_end(1);
+    const esp_console_cmd_t i2cprofile_cmd = {
+        .command = "i2cprofile",
+        .help = "Show or change the I2C bus clock profile",
+        .hint = NULL,
+        .func = &do_i2cprofile_cmd,
+        .argtable = &i2cprofile_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&i2cprofile_cmd));
+}
+
 // static struct {
 //     struct arg_int *chip_address;
 //     struct arg_int *size;
@@ -294,5 +383,7 @@ void register_i2ctools(void)
     register_i2cdectect();
     register_i2cget();
     register_i2cset();
+    register_i2cstats();
+    register_i2cprofile();
     // register_i2cdump();
 }
@@ -0,0 +1,107 @@
+#include "cmd_mic.h"
+#include "mic_app.h"
+#include "stft.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "argtable3/argtable3.h"
+#include "esp_console.h"
+#include "esp_log.h"
+
+static const char *TAG = "cmd_mic";
+
+static struct {
+    struct arg_int *rate;
+    struct arg_int *dma_len;
+    struct arg_int *dma_count;
+    struct arg_int *window;
+    struct arg_int *hop;
+    struct arg_end *end;
+} audio_cfg_args;
+
+/* Range check an option as an int before it is narrowed into the config, value is kept if not given */
+static bool audio_cfg_arg(struct arg_int *arg, int min, int max, int *value)
+{
+    if (arg->count == 0) {
+        return true;
+    }
+    if (arg->ival[0] < min || arg->ival[0] > max) {
+        ESP_LOGE(TAG, "--%s out of range, %d to %d", arg->hdr.longopts, min, max);
+        return false;
+    }
+    *value = arg->ival[0];
+    return true;
+}
+
+static int cmd_audio_cfg(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&audio_cfg_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, audio_cfg_args.end, argv[0]);
+        return 0;
+    }
+
+    audio_config_t config;
+    mic_app_get_config(&config);
+
+    /* Only the given options change, the rest is kept */
+    int rate = config.sample_rate;
+    int dma_len = config.dma_buf_len;
+    int dma_count = config.dma_buf_count;
+    int window = config.fft_window;
+    int hop = config.fft_hop;
+    if (!audio_cfg_arg(audio_cfg_args.rate, I2S_SAMPLE_RATE_MIN, I2S_SAMPLE_RATE_MAX, &rate) ||
+        !audio_cfg_arg(audio_cfg_args.dma_len, I2S_DMA_BUF_LEN_MIN, I2S_DMA_BUF_LEN_MAX, &dma_len) ||
+        !audio_cfg_arg(audio_cfg_args.dma_count, I2S_DMA_BUF_COUNT_MIN, I2S_DMA_BUF_COUNT_MAX, &dma_count) ||
+        !audio_cfg_arg(audio_cfg_args.window, 4, STFT_MAX_WINDOW, &window) ||
+        !audio_cfg_arg(audio_cfg_args.hop, 1, STFT_MAX_WINDOW, &hop)) {
+        return 1;
+    }
+    config.sample_rate = rate;
+    config.dma_buf_len = dma_len;
+    config.dma_buf_count = dma_count;
+    config.fft_window = window;
+    config.fft_hop = hop;
+
+    bool changed = audio_cfg_args.rate->count || audio_cfg_args.dma_len->count || audio_cfg_args.dma_count->count ||
+                    audio_cfg_args.window->count || audio_cfg_args.hop->count;
+
+    if (changed) {
+        if (mic_app_set_config(&config) != ESP_OK) {
+            ESP_LOGE(TAG, "Invalid audio config");
+            return 1;
+        }
+        printf("Requested:\n");
+    } else {
+        printf("Active:\n");
+    }
+
+    printf("Sample rate: %u Hz\nDMA: %u x %u samples (%.1f ms)\nFFT: %u window, %u hop\n",
+            (unsigned) config.sample_rate, (unsigned) config.dma_buf_count, (unsigned) config.dma_buf_len,
+            1000.0f * config.dma_buf_count * config.dma_buf_len / config.sample_rate,
+            (unsigned) config.fft_window, (unsigned) config.fft_hop);
+    return 0;
+}
+
+static void register_audio_cfg(void)
+{
+    audio_cfg_args.rate = arg_int0("r", "rate", "<hz>", "Sample rate, 8000 to 48000");
+    audio_cfg_args.dma_len = arg_int0("l", "dma-len", "<samples>", "Samples per DMA block, 8 to 1024");
+    audio_cfg_args.dma_count = arg_int0("c", "dma-count", "<n>", "Number of DMA blocks, 2 to 32");
+    audio_cfg_args.window = arg_int0("w", "window", "<samples>", "FFT window, power of two up to 1024");
+    audio_cfg_args.hop = arg_int0("o", "hop", "<samples>", "Samples between spectra");
+    audio_cfg_args.end = arg_end(5);
+    const esp_console_cmd_t audio_cfg_cmd = {
+        .command = "audio_cfg",
+        .help = "Show or change the I2S and FFT configuration",
+        .hint = NULL,
+        .func = &cmd_audio_cfg,
+        .argtable = &audio_cfg_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&audio_cfg_cmd));
+}
+
+void register_mic(void)
+{
+    register_audio_cfg();
+}
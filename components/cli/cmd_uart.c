@@ -2,18 +2,32 @@
 #include "cmd_uart.h"
 #include "mic_app.h"
 #include "uart_app.h"
+#include "uart_driver.h"
 #include <stdio.h>
 #include <string.h>
 #include "argtable3/argtable3.h"
 #include "esp_console.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 static const char *TAG = "cmd_uart";
 static const char *UART_ID = "CONSOLE_CMD";
 
+// Stream given by name, UART_STREAM_MAX if unknown
+static uart_stream_id_e uart_stream_from_string(const char * name)
+{
+    uart_stream_id_e stream;
+    for (stream = 0; stream < UART_STREAM_MAX; stream++) {
+        if (strcmp(name, uart_stream_to_string(stream)) == 0) {
+            break;
+        }
+    }
+    return stream;
+}
+
 static struct {
+    struct arg_str *stream;
     struct arg_dbl *data;
-    struct arg_int *id;
     struct arg_end *end;
 } uart_write_args;
 
@@ -25,42 +39,46 @@ static int cmd_uart_write(int argc, char **argv)
         return 0;
     }
 
-    uint8_t data_size = uart_write_args.data->count;
-    uint8_t id_size = uart_write_args.id->count;
-
-    if(data_size != id_size) {
-        ESP_LOGE(TAG, "ID don't match DATA, id=%d | data=%d", id_size, data_size);
+    uart_stream_id_e stream = uart_stream_from_string(uart_write_args.stream->sval[0]);
+    if (stream != UART_STREAM_IMU && stream != UART_STREAM_HEART_RATE) {
+        ESP_LOGE(TAG, "Only value streams (imu, hr) can be written");
         return 1;
     }
 
-    // Set UART MODE to DATA Stream
-    uart_set_stream_mode(UART_MODE_DATA_STREAM);
+    uint8_t data_size = uart_write_args.data->count;
+    if(data_size > UART_VALUES_MAX) {
+        ESP_LOGE(TAG, "Too many values, max %d", UART_VALUES_MAX);
+        return 1;
+    }
 
-    portBASE_TYPE xStatus;
-    uart_data_t uart_data;
-    memset(&uart_data, 0, sizeof(uart_data_t));
+    // Make sure the stream is sent
+    if(!uart_stream_is_subscribed(stream)) {
+        uart_stream_subscribe(stream, 1);
+    }
 
+    uart_values_t uart_data;
+    memset(&uart_data, 0, sizeof(uart_values_t));
     for(uint8_t i = 0; i<data_size; i++) {
-        uart_data.id = uart_write_args.id->ival[i];
-        uart_data.data = uart_write_args.data->dval[i];
+        uart_data.value[i] = uart_write_args.data->dval[i];
+    }
+    uart_data.len = data_size;
+    uart_data.timestamp = (uint32_t)esp_timer_get_time();
 
-        xStatus = xQueueSend( xQueueUartWriteBuffer, (void *)&uart_data, portMAX_DELAY );
-        if (xStatus == pdFAIL) {
-            ESP_LOGE(TAG, "ERROR sendig data to queue");
-        	return 1;
-        }
+    if (uart_stream_write_values(stream, &uart_data, portMAX_DELAY) != ESP_OK) {
+        ESP_LOGE(TAG, "ERROR sendig data to queue");
+        return 1;
     }
     return 0;
 }
 
 static void register_uart_write(void)
 {
-    uart_write_args.data = arg_dbln("d", "data", "<data>", 0, 256, "Specify the data to write to UART");
-    uart_write_args.id = arg_intn("i", "id", "<ID>", 0, 256, "ID = 1 -> 8");
-    uart_write_args.end = arg_end(1);
+    uart_write_args.stream = arg_str1("s", "stream", "<imu|hr>", "Stream to write to");
+    uart_write_args.data = arg_dbln("d", "data", "<data>", 0, UART_VALUES_MAX, "Values of the sample");
+    uart_write_args.end = arg_end(2);
     const esp_console_cmd_t uart_write_cmd = {
         .command = "uart_wr",
-        .help = "Write to UART",
+        .help = "Write a sample to a UART stream",
         .hint = NULL,
         .func = &cmd_uart_write,
         .argtable = &uart_write_args
@@ -68,6 +86,189 @@ static void register_uart_write(void)
     ESP_ERROR_CHECK(esp_console_cmd_register(&uart_write_cmd));
 }
 
+static struct {
+    struct arg_str *stream;
+    struct arg_int *decimation;
+    struct arg_lit *off;
+    struct arg_end *end;
+} uart_stream_args;
+
+static int cmd_uart_stream(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&uart_stream_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, uart_stream_args.end, argv[0]);
+        return 0;
+    }
+
+    /* Change subscription: stream name, with "-d" or "--off" */
+    if (uart_stream_args.stream->count) {
+        uart_stream_id_e stream = uart_stream_from_string(uart_stream_args.stream->sval[0]);
+        if (stream == UART_STREAM_MAX) {
+            ESP_LOGE(TAG, "Unknown stream %s", uart_stream_args.stream->sval[0]);
+            return 1;
+        }
+
+        esp_err_t err;
+        if (uart_stream_args.off->count) {
+            err = uart_stream_unsubscribe(stream);
+        } else {
+            int decimation = uart_stream_args.decimation->count ? uart_stream_args.decimation->ival[0] : 1;
+            err = (decimation > 0 && decimation <= UINT16_MAX) ? uart_stream_subscribe(stream, decimation) : ESP_ERR_INVALID_ARG;
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Can't change %s: %s", uart_stream_args.stream->sval[0], esp_err_to_name(err));
+            return 1;
+        }
+    }
+
+    printf("%-10s %-4s %6s %10s %10s %12s\n", "Stream", "On", "1/N", "Frames", "Skipped", "Bytes");
+    for (uart_stream_id_e stream = 0; stream < UART_STREAM_MAX; stream++) {
+        uart_stream_info_t info;
+        uart_stream_get_info(stream, &info);
+        printf("%-10s %-4s %6u %10u %10u %12llu\n", uart_stream_to_string(stream), info.subscribed ? "yes" : "no",
+                (unsigned) info.decimation, (unsigned) info.frames, (unsigned) info.skipped, (unsigned long long) info.bytes);
+    }
+    return 0;
+}
+
+static void register_uart_stream(void)
+{
+    uart_stream_args.stream = arg_str0(NULL, NULL, "<imu|hr|mic|fft>", "Stream to change");
+    uart_stream_args.decimation = arg_int0("d", "decimation", "<n>", "Send one item out of n, default 1");
+    uart_stream_args.off = arg_lit0(NULL, "off", "Stop sending the stream");
+    uart_stream_args.end = arg_end(3);
+    const esp_console_cmd_t uart_stream_cmd = {
+        .command = "uart_stream",
+        .help = "Show stream subscriptions, or subscribe to a stream",
+        .hint = NULL,
+        .func = &cmd_uart_stream,
+        .argtable = &uart_stream_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&uart_stream_cmd));
+}
+
+static struct {
+    struct arg_int *baud;
+    struct arg_str *flow;
+    struct arg_lit *stream;
+    struct arg_end *end;
+} uart_link_args;
+
+static int cmd_uart_link(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&uart_link_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, uart_link_args.end, argv[0]);
+        return 0;
+    }
+
+    uart_link_config_t config;
+    uart_link_get_config(&config);
+
+    if (uart_link_args.baud->count || uart_link_args.flow->count || uart_link_args.stream->count) {
+        /* "--stream" preset, then explicit options on top */
+        uint32_t baud_rate = config.baud_rate;
+        bool flow_ctrl = config.flow_ctrl;
+        if (uart_link_args.stream->count) {
+            baud_rate = UART_STREAM_BAUDRATE;
+            flow_ctrl = false;
+        }
+        if (uart_link_args.baud->count) {
+            baud_rate = uart_link_args.baud->ival[0];
+        }
+        if (uart_link_args.flow->count) {
+            const char *flow = uart_link_args.flow->sval[0];
+            if (strcmp(flow, "on") == 0) {
+                flow_ctrl = true;
+            } else if (strcmp(flow, "off") == 0) {
+                flow_ctrl = false;
+            } else {
+                ESP_LOGE(TAG, "Flow control is on or off");
+                return 1;
+            }
+        }
+
+        esp_err_t err = uart_stream_configure_link(baud_rate, flow_ctrl);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Link not changed: %s", esp_err_to_name(err));
+            return 1;
+        }
+        uart_link_get_config(&config);
+    }
+
+    printf("Baud rate: %u\nFlow control: %s\nTX ring: %u bytes\n", (unsigned) config.baud_rate,
+            config.flow_ctrl ? "RTS/CTS" : "off", (unsigned) config.tx_buffer_size);
+    return 0;
+}
+
+static void register_uart_link(void)
+{
+    uart_link_args.baud = arg_int0("b", "baud", "<baud>", "Line rate, up to 3000000");
+    uart_link_args.flow = arg_str0("f", "flow", "<on|off>", "RTS/CTS flow control, not supported yet");
+    uart_link_args.stream = arg_lit0(NULL, "stream", "Streaming preset, 2 Mbaud without flow control");
+    uart_link_args.end = arg_end(3);
+    const esp_console_cmd_t uart_link_cmd = {
+        .command = "uart_link",
+        .help = "Show or change the data stream link, the TX ring follows the stream bandwidth",
+        .hint = NULL,
+        .func = &cmd_uart_link,
+        .argtable = &uart_link_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&uart_link_cmd));
+}
+
+static struct {
+    struct arg_lit *reset;
+    struct arg_end *end;
+} uart_stats_args;
+
+static int cmd_uart_stats(int argc, char **argv)
+{
+    int nerrors = arg_parse(argc, argv, (void **)&uart_stats_args);
+    if (nerrors != 0) {
+        arg_print_errors(stderr, uart_stats_args.end, argv[0]);
+        return 0;
+    }
+
+    uart_link_config_t config;
+    uart_link_stats_t stats;
+    uart_link_get_config(&config);
+    uart_link_get_stats(&stats);
+
+    printf("Link: %u B/s capacity, %u B/s offered\n", (unsigned) (config.baud_rate / 10), (unsigned) uart_stream_get_bandwidth());
+    printf("Frames: %u sent, %u dropped (%llu bytes)\nMax TX backlog: %u of %u bytes\n",
+            (unsigned) stats.frames, (unsigned) stats.dropped_frames, (unsigned long long) stats.dropped_bytes,
+            (unsigned) stats.max_backlog, (unsigned) config.tx_buffer_size);
+
+    printf("%-10s %10s %10s %10s\n", "Stream", "B/s", "Dropped", "Overflow");
+    for (uart_stream_id_e stream = 0; stream < UART_STREAM_MAX; stream++) {
+        uart_stream_info_t info;
+        uart_stream_get_info(stream, &info);
+        printf("%-10s %10u %10u %10u\n", uart_stream_to_string(stream), (unsigned) info.rate,
+                (unsigned) info.dropped, (unsigned) info.overflows);
+    }
+
+    if (uart_stats_args.reset->count) {
+        uart_link_reset_stats();
+    }
+    return 0;
+}
+
+static void register_uart_stats(void)
+{
+    uart_stats_args.reset = arg_lit0("r", "reset", "Reset the link counters after printing");
+    uart_stats_args.end = arg_end(1);
+    const esp_console_cmd_t uart_stats_cmd = {
+        .command = "uart_stats",
+        .help = "Show data stream bandwidth, drop and overrun counters",
+        .hint = NULL,
+        .func = &cmd_uart_stats,
+        .argtable = &uart_stats_args
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&uart_stats_cmd));
+}
+
 static int cmd_uart_mic_stream(int argc, char **argv)
 {
     (void) argc;
@@ -159,6 +360,9 @@ static void register_uart_data_disable(void)
 void register_uart(void)
 {
     register_uart_write();
+    register_uart_stream();
+    register_uart_link();
+    register_uart_stats();
     register_uart_mic_stream();
     register_uart_data_stream();
     register_uart_fft_stream();
@@ -0,0 +1,11 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void register_mic(void);
+
+#ifdef __cplusplus
+}
+#endif
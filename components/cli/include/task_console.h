@@ -12,6 +12,8 @@ extern "C" {
 #include "cmd_uart.h"
 #include "cmd_bmp.h"
 #include "cmd_mpu6050.h"
+#include "cmd_mic.h"
+#include "cmd_ble.h"
 
 #define MOUNT_PATH "/data"
 #define HISTORY_PATH MOUNT_PATH "/history.txt"
@@ -20,7 +20,7 @@ static void initialize_console(void)
 {
     // Wait for all tasks
     xEventGroupWaitBits(xEventGroupTasks,
-                        BIT_TASK_I2C_READ | BIT_TASK_I2C_WRITE | BIT_TASK_MPU6050 | BIT_TASK_LED_CONTROL | BIT_TASK_DATA_STREAM | BIT_TASK_MIC | BIT_TASK_BMP280 | BIT_TASK_HEART_RATE,
+                        BIT_TASK_I2C | BIT_TASK_MPU6050 | BIT_TASK_LED_CONTROL | BIT_TASK_DATA_STREAM | BIT_TASK_MIC | BIT_TASK_BMP280 | BIT_TASK_HEART_RATE,
                         pdFALSE,
                         pdTRUE,
                         portMAX_DELAY);
@@ -95,6 +95,8 @@ const char* configure_console() {
     register_uart();
     register_bmp280();
     register_mpu6050();
+    register_mic();
+    register_ble();
 
     /* Prompt to be printed before each line.
      * This can be customized, made dynamic, etc.
@@ -0,0 +1,70 @@
+#include "app_mailbox.h"
+#include <stdatomic.h>
+#include <esp_timer.h>
+
+typedef struct {
+    _Atomic uint32_t seq;       // Odd while the slot is being written
+    float value;
+    uint32_t timestamp;
+} app_mailbox_slot_t;
+
+static app_mailbox_slot_t slots[DATA_ID_MAX];
+static _Atomic uint32_t dirty = 0;
+static _Atomic uint32_t overwrites = 0;
+
+_Static_assert(DATA_ID_MAX <= 32, "Dirty mask holds 32 IDs");
+
+//******************************************************************************************************************
+
+void app_mailbox_publish(data_id_e id, float value) {
+    if(id >= DATA_ID_MAX) return;
+
+    app_mailbox_slot_t * slot = &slots[id];
+    uint32_t timestamp = (uint32_t)esp_timer_get_time();
+    uint32_t seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+    // Interrupts are masked on this core only, so a reader can't preempt the
+    // write and spin on an odd count. Readers on the other core wait a few cycles.
+    UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->value = value;
+    slot->timestamp = timestamp;
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+
+    uint32_t previous = atomic_fetch_or_explicit(&dirty, APP_MAILBOX_BIT(id), memory_order_release);
+    if(previous & APP_MAILBOX_BIT(id)) {
+        atomic_fetch_add_explicit(&overwrites, 1, memory_order_relaxed);
+    }
+}
+
+uint32_t app_mailbox_take() {
+    return atomic_exchange_explicit(&dirty, 0, memory_order_acquire);
+}
+
+bool app_mailbox_read(data_id_e id, float * value, uint32_t * timestamp) {
+    if(id >= DATA_ID_MAX || !value) return false;
+
+    app_mailbox_slot_t * slot = &slots[id];
+    uint32_t before, after;
+    float v;
+    uint32_t t;
+    do {
+        before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        v = slot->value;
+        t = slot->timestamp;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    } while((before & 1) || before != after);
+
+    if(before == 0) return false;
+
+    *value = v;
+    if(timestamp) *timestamp = t;
+    return true;
+}
+
+uint32_t app_mailbox_get_overwrites() {
+    return atomic_load_explicit(&overwrites, memory_order_relaxed);
+}
@@ -0,0 +1,44 @@
+#ifndef _APP_MAILBOX_H_
+#define _APP_MAILBOX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "common.h"
+
+/**
+ * Latest value of every data_id_e for the MIDI controller.
+ *
+ * Each ID has one slot guarded by a sequence counter: the writer makes it
+ * odd, stores the value and makes it even again, a reader retries until it
+ * sees the same even count on both sides of its copy. A publish overwrites
+ * whatever the controller has not picked up yet, so only the freshest value
+ * is ever sent, and sets the ID in a dirty mask. The controller takes the
+ * mask once per tick and handles every dirty ID in one pass.
+ *
+ * Each ID must be published from a single task.
+ */
+
+// Dirty mask bit of an ID
+#define APP_MAILBOX_BIT(id)     (1UL << (id))
+
+// Store the newest value of an ID, never blocks
+void app_mailbox_publish(data_id_e id, float value);
+
+// Take the mask of the IDs published since the last take, never blocks
+uint32_t app_mailbox_take();
+
+/**
+ * @brief Read the newest value of an ID.
+ *
+ * @param id Data ID.
+ * @param value Value.
+ * @param timestamp esp_timer time of the publish in us, may be NULL.
+ * @return False if the ID was never published.
+ */
+bool app_mailbox_read(data_id_e id, float * value, uint32_t * timestamp);
+
+// Publishes that replaced a value the controller had not read yet
+uint32_t app_mailbox_get_overwrites();
+
+#endif //_APP_MAILBOX_H_
@@ -10,8 +10,7 @@
  * Necessary for task synchronization
 */
 
-#define BIT_TASK_I2C_WRITE      (1<<0)
-#define BIT_TASK_I2C_READ       (1<<1)
+#define BIT_TASK_I2C            (1<<0)
 #define BIT_TASK_MPU6050        (1<<2)
 #define BIT_TASK_LED_CONTROL    (1<<3)
 #define BIT_TASK_TOUCH_BUTTON   (1<<4)
@@ -44,8 +43,7 @@ extern EventGroupHandle_t xEventGroupApp;
 #define  osPriorityHigh             configMAX_PRIORITIES - 1
 #define  osPriorityRealtime         configMAX_PRIORITIES - 0
 
-// Queue for the application to receive data from the other tasks
-extern QueueHandle_t xQueueAppData;
+// Values for the application from the other tasks go through app_mailbox.h
 
 typedef enum {
     DATA_ID_ROLL = 0,
@@ -53,14 +51,22 @@ typedef enum {
     DATA_ID_YAW,
     DATA_ID_TEMPERATURE,
     DATA_ID_PRESSURE,
-    DATA_ID_FFT,
+    DATA_ID_FFT,            // Dominant frequency of the mic spectrum in Hz
     DATA_ID_HEART_RATE,
+    DATA_ID_BAND_0,         // First bands of the mic band engine, in dB
+    DATA_ID_BAND_1,
+    DATA_ID_BAND_2,
+    DATA_ID_BAND_3,
+    DATA_ID_BAND_4,
+    DATA_ID_BAND_5,
+    DATA_ID_BAND_6,
+    DATA_ID_BAND_7,
+    DATA_ID_RMS,            // Mic level in dB
+    DATA_ID_CENTROID,       // Spectral centroid in Hz
+    DATA_ID_FLUX,           // Spectral flux, 0 to 1
     DATA_ID_MAX,
 }data_id_e;
 
+#define DATA_ID_BAND_COUNT      (DATA_ID_BAND_7 - DATA_ID_BAND_0 + 1)
 
-typedef struct {
-    data_id_e id;
-    float data;
-}app_data_t;
 #endif //_COMMON_H_
\ No newline at end of file
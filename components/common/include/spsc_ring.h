@@ -0,0 +1,72 @@
+#ifndef _SPSC_RING_H_
+#define _SPSC_RING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <esp_err.h>
+
+/**
+ * Lock free ring of fixed size items, one producer and one consumer.
+ *
+ * A push never blocks: when the ring is full it either refuses the new item
+ * (SPSC_RING_DROP_NEWEST) or takes the oldest one away from the consumer
+ * (SPSC_RING_DROP_OLDEST) and hands it back to the producer, so anything
+ * the item owns can be released. Every lost item is counted.
+ *
+ * The consumer copies the tail slot and then claims it with a compare and
+ * swap on the tail index. If the producer evicted that slot in the meantime
+ * the swap fails and the copy, possibly torn, is thrown away.
+ */
+
+typedef enum {
+    SPSC_RING_DROP_NEWEST = 0,      // Full ring refuses the new item
+    SPSC_RING_DROP_OLDEST,          // Full ring evicts the oldest item
+} spsc_ring_policy_e;
+
+typedef enum {
+    SPSC_RING_PUSHED = 0,
+    SPSC_RING_EVICTED,              // Pushed, the oldest item was evicted
+    SPSC_RING_REJECTED,             // Not pushed
+} spsc_ring_result_e;
+
+typedef struct {
+    uint8_t * buffer;
+    size_t item_size;
+    uint32_t mask;                  // Capacity - 1
+    spsc_ring_policy_e policy;
+    _Atomic uint32_t head;          // Next slot to write, moved by the producer only
+    _Atomic uint32_t tail;          // Next slot to read, moved by the consumer or an eviction
+    _Atomic uint32_t overflows;     // Items evicted or refused
+} spsc_ring_t;
+
+/**
+ * @brief Set up a ring over caller provided storage.
+ *
+ * @param ring Ring state.
+ * @param buffer Storage for capacity items of item_size bytes.
+ * @param item_size Size of an item in bytes.
+ * @param capacity Number of items, a power of two.
+ * @param policy What a push does when the ring is full.
+ */
+esp_err_t spsc_ring_init(spsc_ring_t * ring, void * buffer, size_t item_size, uint32_t capacity, spsc_ring_policy_e policy);
+
+/**
+ * @brief Producer side, copy an item into the ring.
+ *
+ * @param ring Ring state.
+ * @param item Item to copy in.
+ * @param evicted Receives the evicted item on SPSC_RING_EVICTED, may be NULL.
+ */
+spsc_ring_result_e spsc_ring_push(spsc_ring_t * ring, const void * item, void * evicted);
+
+// Consumer side, copy out and remove the oldest item. False if the ring is empty
+bool spsc_ring_pop(spsc_ring_t * ring, void * item);
+// Consumer side, copy out the oldest item and leave it in the ring. False if the ring is empty
+bool spsc_ring_peek(spsc_ring_t * ring, void * item);
+
+uint32_t spsc_ring_count(spsc_ring_t * ring);
+uint32_t spsc_ring_get_overflows(spsc_ring_t * ring);
+
+#endif //_SPSC_RING_H_
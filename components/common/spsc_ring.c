@@ -0,0 +1,93 @@
+#include "spsc_ring.h"
+#include <string.h>
+
+//******************************************************************************************************************
+
+static inline uint8_t * spsc_ring_slot(spsc_ring_t * ring, uint32_t index) {
+    return &ring->buffer[(index & ring->mask) * ring->item_size];
+}
+
+//******************************************************************************************************************
+
+esp_err_t spsc_ring_init(spsc_ring_t * ring, void * buffer, size_t item_size, uint32_t capacity, spsc_ring_policy_e policy) {
+    if(!ring || !buffer || item_size == 0 || capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ring->buffer = buffer;
+    ring->item_size = item_size;
+    ring->mask = capacity - 1;
+    ring->policy = policy;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->overflows, 0);
+    return ESP_OK;
+}
+
+spsc_ring_result_e spsc_ring_push(spsc_ring_t * ring, const void * item, void * evicted) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    spsc_ring_result_e result = SPSC_RING_PUSHED;
+
+    if(head - tail > ring->mask) {
+        if(ring->policy == SPSC_RING_DROP_NEWEST) {
+            atomic_fetch_add_explicit(&ring->overflows, 1, memory_order_relaxed);
+            return SPSC_RING_REJECTED;
+        }
+
+        // Claim the oldest slot, if the consumer took it first there is room already
+        if(atomic_compare_exchange_strong_explicit(&ring->tail, &tail, tail + 1, memory_order_acq_rel, memory_order_acquire)) {
+            if(evicted) {
+                memcpy(evicted, spsc_ring_slot(ring, tail), ring->item_size);
+            }
+            atomic_fetch_add_explicit(&ring->overflows, 1, memory_order_relaxed);
+            result = SPSC_RING_EVICTED;
+        }
+    }
+
+    memcpy(spsc_ring_slot(ring, head), item, ring->item_size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return result;
+}
+
+bool spsc_ring_pop(spsc_ring_t * ring, void * item) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    do {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if(tail == head) {
+            return false;
+        }
+        memcpy(item, spsc_ring_slot(ring, tail), ring->item_size);
+        // A failed swap means the slot was evicted while it was copied, tail now holds the new one
+    } while(!atomic_compare_exchange_weak_explicit(&ring->tail, &tail, tail + 1, memory_order_acq_rel, memory_order_acquire));
+    return true;
+}
+
+bool spsc_ring_peek(spsc_ring_t * ring, void * item) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    while(1) {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if(tail == head) {
+            return false;
+        }
+        memcpy(item, spsc_ring_slot(ring, tail), ring->item_size);
+
+        // The copy holds if nothing was evicted meanwhile
+        atomic_thread_fence(memory_order_acquire);
+        uint32_t check = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        if(check == tail) {
+            return true;
+        }
+        tail = check;
+    }
+}
+
+uint32_t spsc_ring_count(spsc_ring_t * ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return head - tail;
+}
+
+uint32_t spsc_ring_get_overflows(spsc_ring_t * ring) {
+    return atomic_load_explicit(&ring->overflows, memory_order_relaxed);
+}
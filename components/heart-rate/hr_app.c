@@ -2,6 +2,7 @@
 #include "hr_driver.h"
 #include "uart_app.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "common.h"
 
 static const char *TAG = "HEART_RATE_App";
@@ -10,14 +11,12 @@ SemaphoreHandle_t xHeartRateDataMutex;
 static uint16_t heart_rate_data;
 
 static void heart_rate_data_stream() {
-    uart_data_t uart_data_heart_rate = {
-        .id = UART_DATA_ID_HEART_RATE,
-        .data = (double)heart_rate_data
+    uart_values_t uart_data_heart_rate = {
+        .value = { (float)heart_rate_data },
+        .len = 1,
+        .timestamp = (uint32_t)esp_timer_get_time(),
     };
-    if (xQueueSend( xQueueUartWriteBuffer, (void *)&uart_data_heart_rate, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "ERROR sendig data to queue");
-        return;
-    }
+    uart_stream_send(UART_STREAM_HEART_RATE, &uart_data_heart_rate);
 }
 
 void vHeartRateTask( void *pvParameters ) {
@@ -50,7 +49,7 @@ void vHeartRateTask( void *pvParameters ) {
         err = heart_rate_read(&heart_rate_data);
 
         // Check if Data Stream is enabled
-        if(xEventGroupGetBits(xEventGroupDataStreamMode) & BIT_UART_STREAM_MODE_ALL) {
+        if(xEventGroupGetBits(xEventGroupDataStreamMode) & BIT_UART_STREAM(UART_STREAM_HEART_RATE)) {
             heart_rate_data_stream();
         }
 
@@ -11,165 +11,217 @@
 **********************************************************************/
 #include "i2c_app.h"
 #include "i2c_driver.h"
+#include "i2c_scheduler.h"
 #include <esp_log.h>
+#include <esp_timer.h>
 #include "common.h"
 
-#define I2C_APP_QUEUE_LENGTH            1
-#define I2C_APP_WRITE_ITEM_SIZE         sizeof( I2C_Status )
-#define I2C_APP_READ_ITEM_SIZE          sizeof( I2C_Status )
+static const char *TAG = "I2c_App";
 
-#define GUARD_CYCLE		10
+static i2c_engine_t engine;
+static TaskHandle_t engine_task = NULL;
+/* Counts free transfer slots so submitters can block while the ring is full */
+static SemaphoreHandle_t xSemaphoreI2CSlots = NULL;
 
-static const char *TAG = "I2c_App";
+static portMUX_TYPE completion_lock = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE engine_lock = portMUX_INITIALIZER_UNLOCKED;
 
-/* Extern Variables	*/
-/* Declare a variable of type xQueueHandle.  This is used to store the queue
-	that is accessed by any task wants to write to I2C. */
-QueueHandle_t xQueueI2CWriteBuffer;
-QueueHandle_t xQueueI2CReadBuffer;
+//***************************************************************************************************************
 
-SemaphoreHandle_t xBinarySemaphoreI2CAppEndOfWrite;
-SemaphoreHandle_t xBinarySemaphoreI2CAppEndOfRead;
+/* Engine backend: legacy driver transactions run from the I2C task */
 
+static esp_err_t i2c_app_backend_transfer(const i2c_transfer_t * transfer) {
+	esp_err_t err;
 
-/**
-  * @brief  Write to I2C.
-  * @param  None
-  * @retval None
-  */
-void vI2CWrite( void *pvParameters )
-{
-	/* Declare the variable that will hold the values received from the queue. */
-	I2C_Status lReceivedValue;
-	portBASE_TYPE xStatus;
+	/* Run transaction, only holding off if the device is still settling */
+	int64_t start = i2c_sched_begin(transfer->device_address);
+	if(transfer->op == I2C_OP_WRITE) {
+		err = i2c_write_register(transfer->device_address, transfer->register_address, transfer->size, transfer->data);
+	} else {
+		err = i2c_read_register(transfer->device_address, transfer->register_address, transfer->size, transfer->data);
+	}
+	i2c_sched_end(transfer->device_address, transfer->register_address, transfer->op == I2C_OP_WRITE, start, err);
 
-	/* The queue is created xStaticReadQueueto hold a maximum of 1 structure entry. */
-	xQueueI2CWriteBuffer = xQueueCreate(I2C_APP_QUEUE_LENGTH, I2C_APP_WRITE_ITEM_SIZE);
+	if(err != ESP_OK) {
+		ESP_LOGE(TAG, "%s 0x%02x:0x%02x failed: %s", transfer->op == I2C_OP_WRITE ? "Write" : "Read",
+				transfer->device_address, transfer->register_address, esp_err_to_name(err));
+	}
+	return err;
+}
 
-	/* Create a binary semaphore without using any dynamic memory
-	allocation.  The semaphore's data structures will be saved into
-	the xSemaphoreWriteBuffer variable. */
-	xBinarySemaphoreI2CAppEndOfWrite = xSemaphoreCreateBinary();
+static void i2c_app_backend_lock(void) {
+	portENTER_CRITICAL(&engine_lock);
+}
 
-	/* The pxSemaphoreBuffer was not NULL, so it is expected that the
-	handle will not be NULL. */
-	configASSERT( xBinarySemaphoreI2CAppEndOfWrite );
+static void i2c_app_backend_unlock(void) {
+	portEXIT_CRITICAL(&engine_lock);
+}
 
-	/* Rest of the task code goes here. */
+static void i2c_app_backend_kick(void) {
+	xTaskNotifyGive(engine_task);
+}
 
-	/* Check the semaphore was created successfully. */
-	if( xBinarySemaphoreI2CAppEndOfWrite != NULL )
-	{
-		/* As per most tasks, this task is implemented within an infinite loop.
-			Take the semaphore once to start with so the semaphore is empty before the
-			infinite loop is entered.  The semaphore was created before the scheduler
-			was started so before this task ran for the first time.*/
-		xSemaphoreTake( xBinarySemaphoreI2CAppEndOfWrite, 0 );
+/* Given before the completion callback, which may block on the slots to submit again */
+static void i2c_app_backend_release(void) {
+	xSemaphoreGive(xSemaphoreI2CSlots);
+}
+
+static const i2c_engine_backend_t i2c_app_backend = {
+	.transfer = i2c_app_backend_transfer,
+	.now_us = esp_timer_get_time,
+	.lock = i2c_app_backend_lock,
+	.unlock = i2c_app_backend_unlock,
+	.kick = i2c_app_backend_kick,
+	.release = i2c_app_backend_release,
+};
+
+static void i2c_app_complete(void * ctx, esp_err_t err) {
+	i2c_completion_t * done = (i2c_completion_t *)ctx;
+	bool notify = false;
+
+	portENTER_CRITICAL(&completion_lock);
+	if(err != ESP_OK && done->status == ESP_OK) {
+		done->status = err;
 	}
+	done->pending--;
+	notify = (done->pending == 0);
+	portEXIT_CRITICAL(&completion_lock);
 
-	// Signalize task successfully creation
-	xEventGroupSetBits(xEventGroupTasks, BIT_TASK_I2C_WRITE);
-	ESP_LOGI(TAG, "I2C Write Initialized");
+	if(notify) {
+		xTaskNotify(done->task, done->bit, eSetBits);
+	}
+}
 
-	for(;;)
-	{
-		/* The first parameter is the queue from which data is to be received..
+//***************************************************************************************************************
 
-		The second parameter is the buffer into which the received data will be
-		placed.  In this case the buffer is simply the address of a variable that
-		has the required size to hold the received data.
+void i2c_app_completion_init(i2c_completion_t * done, uint32_t bit) {
+	done->task = xTaskGetCurrentTaskHandle();
+	done->bit = bit;
+	done->pending = 0;
+	done->status = ESP_OK;
+}
 
-		the last parameter is the block time ? the maximum amount of time that the
-		task should remain in the Blocked state to wait for data to be available should
-		the queue already be empty. */
-		xStatus = xQueueReceive( xQueueI2CWriteBuffer, (void *)&lReceivedValue, portMAX_DELAY );
-		if( xStatus == pdPASS )
-		{
-			/* Write on I2C */
-			i2c_write_bytes(lReceivedValue.device_address, lReceivedValue.register_address, lReceivedValue.size ,lReceivedValue.data);
+esp_err_t i2c_app_submit_cb(I2C_Status * msg, i2c_transfer_cb_t cb, void * ctx, TickType_t timeout) {
+	if(!msg) return ESP_ERR_INVALID_ARG;
 
-			vTaskDelay( GUARD_CYCLE / portTICK_RATE_MS );
+	if(xSemaphoreTake(xSemaphoreI2CSlots, timeout) != pdTRUE) {
+		return ESP_ERR_TIMEOUT;
+	}
 
-			/* 'Give' the semaphore to unblock the task. */
-			xSemaphoreGive( xBinarySemaphoreI2CAppEndOfWrite );
+	i2c_transfer_t transfer = {
+		.op = msg->op,
+		.device_address = msg->device_address,
+		.register_address = msg->register_address,
+		.size = msg->size,
+		.data = msg->data,
+		.cb = cb,
+		.ctx = ctx,
+	};
+	esp_err_t err = i2c_engine_submit(&engine, &transfer);
+	if(err != ESP_OK) {
+		xSemaphoreGive(xSemaphoreI2CSlots);
+	}
+	return err;
+}
+
+esp_err_t i2c_app_submit(I2C_Status * msg, i2c_completion_t * done, TickType_t timeout) {
+	if(!msg) return ESP_ERR_INVALID_ARG;
+
+	if(done) {
+		portENTER_CRITICAL(&completion_lock);
+		done->pending++;
+		portEXIT_CRITICAL(&completion_lock);
+	}
+
+	esp_err_t err = i2c_app_submit_cb(msg, done ? i2c_app_complete : NULL, done, timeout);
+	if(err != ESP_OK && done) {
+		portENTER_CRITICAL(&completion_lock);
+		done->pending--;
+		portEXIT_CRITICAL(&completion_lock);
+	}
+	return err;
+}
+
+esp_err_t i2c_app_wait(i2c_completion_t * done, TickType_t timeout) {
+	if(!done) return ESP_ERR_INVALID_ARG;
+
+	TimeOut_t xTimeOut;
+	vTaskSetTimeOutState(&xTimeOut);
+
+	// The bit may be left over from an earlier completion, so the pending count is what decides
+	while(1) {
+		portENTER_CRITICAL(&completion_lock);
+		uint32_t pending = done->pending;
+		portEXIT_CRITICAL(&completion_lock);
+		if(pending == 0) {
+			return done->status;
 		}
-		else
-		{
-			/* We did not receive anything from the queue even after waiting for blocking time defined.*/
+
+		if(xTaskCheckForTimeOut(&xTimeOut, &timeout) == pdTRUE) {
+			return ESP_ERR_TIMEOUT;
 		}
+		xTaskNotifyWait(0, done->bit, NULL, timeout);
 	}
+}
 
-	vTaskDelete(NULL);
+static esp_err_t i2c_app_transfer(i2c_op_e op, uint8_t device_address, uint8_t register_address, uint8_t size, uint8_t * data) {
+	i2c_completion_t done;
+	i2c_app_completion_init(&done, I2C_APP_NOTIFY_BIT);
+
+	I2C_Status i2c_msg = {
+		.op = op,
+		.device_address = device_address,
+		.register_address = register_address,
+		.size = size,
+		.data = data,
+	};
+
+	esp_err_t err = i2c_app_submit(&i2c_msg, &done, portMAX_DELAY);
+	if(err != ESP_OK) {
+		return err;
+	}
+	return i2c_app_wait(&done, portMAX_DELAY);
 }
 
+esp_err_t i2c_app_read(uint8_t device_address, uint8_t register_address, uint8_t size, uint8_t * data) {
+	return i2c_app_transfer(I2C_OP_READ, device_address, register_address, size, data);
+}
+
+esp_err_t i2c_app_write(uint8_t device_address, uint8_t register_address, uint8_t size, uint8_t * data) {
+	return i2c_app_transfer(I2C_OP_WRITE, device_address, register_address, size, data);
+}
+
+void i2c_app_get_engine_stats(i2c_engine_stats_t * stats) {
+	i2c_engine_get_stats(&engine, stats);
+}
+
+//***************************************************************************************************************
+
 /**
-  * @brief  Read from I2C.
+  * @brief  Execute read and write requests on I2C bus.
   * @param  None
   * @retval None
   */
-void vI2CRead( void *pvParameters )
+void vI2CTask( void *pvParameters )
 {
-	/* Declare the variable that will hold the values received from the queue. */
-	I2C_Status lReceivedValue;
-	portBASE_TYPE xStatus;
+	engine_task = xTaskGetCurrentTaskHandle();
+	ESP_ERROR_CHECK(i2c_engine_init(&engine, &i2c_app_backend));
 
-	/* The queue is created to hold a maximum of 1 structure entry. */
-	xQueueI2CReadBuffer = xQueueCreate(I2C_APP_QUEUE_LENGTH, I2C_APP_READ_ITEM_SIZE);
-
-	/* Create a binary semaphore without using any dynamic memory
-	allocation.  The semaphore's data structures will be saved into
-	the xSemaphoreReadBuffer variable. */
-	xBinarySemaphoreI2CAppEndOfRead = xSemaphoreCreateBinary();
-
-	/* The pxSemaphoreBuffer was not NULL, so it is expected that the
-	handle will not be NULL. */
-	configASSERT( xBinarySemaphoreI2CAppEndOfRead );
-
-	/* Rest of the task code goes here. */
-
-	/* Check the semaphore was created successfully. */
-	if( xBinarySemaphoreI2CAppEndOfRead != NULL )
-	{
-		/* As per most tasks, this task is implemented within an infinite loop.
-			Take the semaphore once to start with so the semaphore is empty before the
-			infinite loop is entered.  The semaphore was created before the scheduler
-			was started so before this task ran for the first time.*/
-		xSemaphoreTake( xBinarySemaphoreI2CAppEndOfRead, 0 );
-	}
+	/* The ring keeps reads and writes in submission order */
+	xSemaphoreI2CSlots = xSemaphoreCreateCounting(I2C_ENGINE_RING_SIZE, I2C_ENGINE_RING_SIZE);
+	configASSERT( xSemaphoreI2CSlots );
 
 	// Signalize task successfully creation
-	xEventGroupSetBits(xEventGroupTasks, BIT_TASK_I2C_READ);
-	ESP_LOGI(TAG, "I2C Read Initialized");
+	xEventGroupSetBits(xEventGroupTasks, BIT_TASK_I2C);
+	ESP_LOGI(TAG, "I2C Initialized");
 
 	for(;;)
 	{
-		/* The first parameter is the queue from which data is to be received..
-
-		The second parameter is the buffer into which the received data will be
-		placed.  In this case the buffer is simply the address of a variable that
-		has the required size to hold the received data.
-
-		the last parameter is the block time ? the maximum amount of time that the
-		task should remain in the Blocked state to wait for data to be available should
-		the queue already be empty. */
-		xStatus = xQueueReceive( xQueueI2CReadBuffer, (void *)&lReceivedValue, portMAX_DELAY );
-		if( xStatus == pdPASS )
-		{
-			/* Read from I2C */
-			i2c_read_bytes(lReceivedValue.device_address, lReceivedValue.register_address, lReceivedValue.size , lReceivedValue.data);
-
-			vTaskDelay( GUARD_CYCLE / portTICK_RATE_MS );
-
-			/* 'Give' the semaphore to unblock the task. */
-			xSemaphoreGive( xBinarySemaphoreI2CAppEndOfRead );
-		}
-		else
-		{
-			/* We did not receive anything from the queue even after waiting for blocking time defined.*/
-		}
+		/* Sleep until a transfer is submitted, then run everything pending.
+		   Each finished transfer gives its slot back through the backend. */
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		while(i2c_engine_service(&engine));
 	}
 
 	vTaskDelete(NULL);
 }
-
-
@@ -11,16 +11,17 @@
  * @brief I2C Read/Write functions for ESP32 ESP-IDF.
  */
 
+#include <string.h>
 #include <esp_log.h>
 #include <esp_err.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <freertos/semphr.h>
 #include "i2c_driver.h"
 
 #define I2C_MASTER_NUM 					I2C_NUM_1   /*!< I2C port number for master dev */
 #define I2C_MASTER_SCL_IO    			19    		/*!< gpio number for I2C master clock */
 #define I2C_MASTER_SDA_IO    			18    		/*!< gpio number for I2C master data  */
-#define I2C_MASTER_FREQ_HZ    			100000     	/*!< I2C master clock frequency */
 #define I2C_MASTER_TX_BUF_DISABLE   	0   		/*!< I2C master do not need buffer */
 #define I2C_MASTER_RX_BUF_DISABLE   	0   		/*!< I2C master do not need buffer */
 #define WRITE_BIT  						I2C_MASTER_WRITE /*!< I2C master write */
@@ -30,17 +31,84 @@
 #define ACK_VAL    						0x0         /*!< I2C ack value */
 #define NACK_VAL   						0x1         /*!< I2C nack value */
 
+static const uint32_t profile_clk_hz[I2C_BUS_PROFILE_MAX] = {
+	[I2C_BUS_PROFILE_STANDARD] = 100000,
+	[I2C_BUS_PROFILE_FAST] = 400000,
+	[I2C_BUS_PROFILE_FAST_PLUS] = 1000000,
+};
+
+static const char * profile_names[I2C_BUS_PROFILE_MAX] = {
+	[I2C_BUS_PROFILE_STANDARD] = "standard",
+	[I2C_BUS_PROFILE_FAST] = "fast",
+	[I2C_BUS_PROFILE_FAST_PLUS] = "fast-plus",
+};
+
+/* Command link storage for register reads/writes: a write is one transaction, a read with
+   repeated start is two. Shared between callers, guarded by cmd_mutex. */
+#define I2C_CMD_BUFFER_SIZE				I2C_LINK_RECOMMENDED_SIZE(2)
+
 static const char *TAG = "i2c_driver";
 
+static uint8_t cmd_buffer[I2C_CMD_BUFFER_SIZE];
+static StaticSemaphore_t cmd_mutex_buffer;
+static SemaphoreHandle_t cmd_mutex = NULL;
+
+/* Bus profile and registered devices, guarded by cmd_mutex */
+static i2c_bus_profile_e bus_profile = I2C_BUS_PROFILE_DEFAULT;
+static uint32_t bus_clk_hz = 0;
+static i2c_bus_device_t bus_devices[I2C_BUS_MAX_DEVICES];
+static uint8_t bus_device_count = 0;
+
+//***************************************************************************************************************
+
+static void i2c_bus_fill_config(i2c_config_t * conf, uint32_t clk_hz) {
+	memset(conf, 0, sizeof(i2c_config_t));
+	conf->mode = I2C_MODE_MASTER;
+	conf->sda_io_num = I2C_MASTER_SDA_IO;
+	conf->sda_pullup_en = GPIO_PULLUP_ENABLE;
+	conf->scl_io_num = I2C_MASTER_SCL_IO;
+	conf->scl_pullup_en = GPIO_PULLUP_ENABLE;
+	conf->master.clk_speed = clk_hz;
+}
+
+/* Profile clock capped by the slowest registered device */
+static uint32_t i2c_bus_target_clock(void) {
+	uint32_t clk_hz = profile_clk_hz[bus_profile];
+	for (uint8_t i = 0; i < bus_device_count; i++) {
+		if (bus_devices[i].max_clk_hz < clk_hz)
+			clk_hz = bus_devices[i].max_clk_hz;
+	}
+	return clk_hz;
+}
+
+/* Must be called with cmd_mutex held, so no transaction is on the bus */
+static esp_err_t i2c_bus_apply_clock(void) {
+	uint32_t clk_hz = i2c_bus_target_clock();
+	if (clk_hz == bus_clk_hz)
+		return ESP_OK;
+
+	i2c_config_t conf;
+	i2c_bus_fill_config(&conf, clk_hz);
+	esp_err_t err = i2c_param_config(I2C_MASTER_NUM, &conf);
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "Failed to set clock to %u Hz: %s", (unsigned) clk_hz, esp_err_to_name(err));
+		return err;
+	}
+
+	ESP_LOGI(TAG, "Bus clock %u Hz (%s)", (unsigned) clk_hz, profile_names[bus_profile]);
+	bus_clk_hz = clk_hz;
+	return ESP_OK;
+}
+
+//***************************************************************************************************************
+
 void i2c_init() {
+	cmd_mutex = xSemaphoreCreateMutexStatic(&cmd_mutex_buffer);
+
 	int i2c_master_port = I2C_MASTER_NUM;
 	i2c_config_t conf;
-	conf.mode = I2C_MODE_MASTER;
-	conf.sda_io_num = I2C_MASTER_SDA_IO;
-	conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
-	conf.scl_io_num = I2C_MASTER_SCL_IO;
-	conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
-	conf.master.clk_speed = I2C_MASTER_FREQ_HZ;
+	bus_clk_hz = i2c_bus_target_clock();
+	i2c_bus_fill_config(&conf, bus_clk_hz);
 	i2c_param_config(i2c_master_port, &conf);
 	i2c_driver_install(i2c_master_port, conf.mode,
 						I2C_MASTER_RX_BUF_DISABLE,
@@ -48,18 +116,88 @@ void i2c_init() {
 
 }
 
-void select_register(uint8_t device_address, uint8_t register_address)
+esp_err_t i2c_bus_register_device(uint8_t device_address, uint32_t max_clk_hz)
 {
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	i2c_master_start(cmd);
-	i2c_master_write_byte(cmd, (device_address << 1) | I2C_MASTER_WRITE, 1);
-	i2c_master_write_byte(cmd, register_address, 1);
-	i2c_master_stop(cmd);
-	i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, 1000 / portTICK_PERIOD_MS);
-	i2c_cmd_link_delete(cmd);
+	if (max_clk_hz == 0)
+		return ESP_ERR_INVALID_ARG;
+
+	esp_err_t err = ESP_OK;
+	xSemaphoreTake(cmd_mutex, portMAX_DELAY);
+
+	uint8_t i;
+	for (i = 0; i < bus_device_count; i++) {
+		if (bus_devices[i].device_address == device_address)
+			break;
+	}
+
+	if (i == bus_device_count) {
+		if (bus_device_count >= I2C_BUS_MAX_DEVICES) {
+			err = ESP_ERR_NO_MEM;
+		} else {
+			bus_device_count++;
+		}
+	}
+
+	if (err == ESP_OK) {
+		bus_devices[i].device_address = device_address;
+		bus_devices[i].max_clk_hz = max_clk_hz;
+		err = i2c_bus_apply_clock();
+	}
+	xSemaphoreGive(cmd_mutex);
+
+	return err;
 }
 
-int8_t i2c_read_bytes
+esp_err_t i2c_bus_set_profile(i2c_bus_profile_e profile)
+{
+	if (profile >= I2C_BUS_PROFILE_MAX)
+		return ESP_ERR_INVALID_ARG;
+
+	xSemaphoreTake(cmd_mutex, portMAX_DELAY);
+	i2c_bus_profile_e previous = bus_profile;
+	bus_profile = profile;
+	esp_err_t err = i2c_bus_apply_clock();
+	if (err != ESP_OK)
+		bus_profile = previous;
+	xSemaphoreGive(cmd_mutex);
+
+	return err;
+}
+
+i2c_bus_profile_e i2c_bus_get_profile()
+{
+	return bus_profile;
+}
+
+uint32_t i2c_bus_get_clock()
+{
+	return bus_clk_hz;
+}
+
+const char * i2c_bus_profile_to_string(i2c_bus_profile_e profile)
+{
+	return profile < I2C_BUS_PROFILE_MAX ? profile_names[profile] : "unknown";
+}
+
+uint8_t i2c_bus_get_devices(i2c_bus_device_t * devices, uint8_t max_devices)
+{
+	if (devices == NULL)
+		return 0;
+
+	xSemaphoreTake(cmd_mutex, portMAX_DELAY);
+	uint8_t len = bus_device_count < max_devices ? bus_device_count : max_devices;
+	memcpy(devices, bus_devices, len * sizeof(i2c_bus_device_t));
+	xSemaphoreGive(cmd_mutex);
+
+	return len;
+}
+
+esp_err_t select_register(uint8_t device_address, uint8_t register_address)
+{
+	return i2c_write_register(device_address, register_address, 0, NULL);
+}
+
+esp_err_t i2c_read_register
 (
 	uint8_t device_address,
 	uint8_t register_address,
@@ -67,23 +205,51 @@ int8_t i2c_read_bytes
 	uint8_t* data
 )
 {
+	if (size == 0 || data == NULL)
+		return ESP_ERR_INVALID_ARG;
+
 	esp_err_t err = ESP_OK;
-	select_register(device_address, register_address);
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	ESP_ERROR_CHECK(i2c_master_start(cmd));
-	ESP_ERROR_CHECK(i2c_master_write_byte(cmd, (device_address << 1) | I2C_MASTER_READ, 1));
+	xSemaphoreTake(cmd_mutex, portMAX_DELAY);
+
+	// START, address, register, RESTART, address, data, STOP: a single bus transaction
+	i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(cmd_buffer, sizeof(cmd_buffer));
+	if (cmd == NULL) {
+		xSemaphoreGive(cmd_mutex);
+		return ESP_ERR_NO_MEM;
+	}
+	i2c_master_start(cmd);
+	i2c_master_write_byte(cmd, (device_address << 1) | I2C_MASTER_WRITE, 1);
+	i2c_master_write_byte(cmd, register_address, 1);
+	i2c_master_start(cmd);
+	i2c_master_write_byte(cmd, (device_address << 1) | I2C_MASTER_READ, 1);
 
 	if (size > 1)
-		ESP_ERROR_CHECK(i2c_master_read(cmd, data, size - 1, 0));
+		i2c_master_read(cmd, data, size - 1, ACK_VAL);
 
-	ESP_ERROR_CHECK(i2c_master_read_byte(cmd, data + size - 1, 1));
+	i2c_master_read_byte(cmd, data + size - 1, NACK_VAL);
 
-	ESP_ERROR_CHECK(i2c_master_stop(cmd));
+	i2c_master_stop(cmd);
 	err = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, 1000 / portTICK_PERIOD_MS);
+	i2c_cmd_link_delete_static(cmd);
+	xSemaphoreGive(cmd_mutex);
+
 	if(err != ESP_OK) {
 		ESP_LOGE(TAG, "ERROR: %s", esp_err_to_name(err));
 	}
-	i2c_cmd_link_delete(cmd);
+
+	return err;
+}
+
+int8_t i2c_read_bytes
+(
+	uint8_t device_address,
+	uint8_t register_address,
+	uint8_t size,
+	uint8_t* data
+)
+{
+	if (i2c_read_register(device_address, register_address, size, data) != ESP_OK)
+		return 0;
 
 	return (size);
 }
@@ -137,7 +303,7 @@ int8_t i2c_read_bit
 	return (count);
 }
 
-bool i2c_write_bytes
+esp_err_t i2c_write_register
 (
 	uint8_t device_address,
 	uint8_t register_address,
@@ -145,17 +311,43 @@ bool i2c_write_bytes
 	uint8_t* data
 )
 {
-	i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-	ESP_ERROR_CHECK(i2c_master_start(cmd));
-	ESP_ERROR_CHECK(i2c_master_write_byte(cmd, (device_address << 1) | I2C_MASTER_WRITE, 1));
-	ESP_ERROR_CHECK(i2c_master_write_byte(cmd, register_address, 1));
-	ESP_ERROR_CHECK(i2c_master_write(cmd, data, size - 1, 0));
-	ESP_ERROR_CHECK(i2c_master_write_byte(cmd, data [size - 1], 1));
-	ESP_ERROR_CHECK(i2c_master_stop(cmd));
-	ESP_ERROR_CHECK(i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, 1000 / portTICK_PERIOD_MS));
-	i2c_cmd_link_delete(cmd);
+	if (size > 0 && data == NULL)
+		return ESP_ERR_INVALID_ARG;
+
+	esp_err_t err = ESP_OK;
+	xSemaphoreTake(cmd_mutex, portMAX_DELAY);
+
+	i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(cmd_buffer, sizeof(cmd_buffer));
+	if (cmd == NULL) {
+		xSemaphoreGive(cmd_mutex);
+		return ESP_ERR_NO_MEM;
+	}
+	i2c_master_start(cmd);
+	i2c_master_write_byte(cmd, (device_address << 1) | I2C_MASTER_WRITE, 1);
+	i2c_master_write_byte(cmd, register_address, 1);
+	if (size > 0)
+		i2c_master_write(cmd, data, size, 1);
+	i2c_master_stop(cmd);
+	err = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, 1000 / portTICK_PERIOD_MS);
+	i2c_cmd_link_delete_static(cmd);
+	xSemaphoreGive(cmd_mutex);
+
+	if(err != ESP_OK) {
+		ESP_LOGE(TAG, "ERROR: %s", esp_err_to_name(err));
+	}
 
-	return 0;
+	return err;
+}
+
+bool i2c_write_bytes
+(
+	uint8_t device_address,
+	uint8_t register_address,
+	uint8_t size,
+	uint8_t* data
+)
+{
+	return (i2c_write_register(device_address, register_address, size, data) == ESP_OK);
 }
 
 bool i2c_detect
@@ -167,7 +359,9 @@ bool i2c_detect
 	ESP_ERROR_CHECK(i2c_master_start(cmd));
 	ESP_ERROR_CHECK(i2c_master_write_byte(cmd, (device_address << 1) | WRITE_BIT, ACK_CHECK_EN));
 	ESP_ERROR_CHECK(i2c_master_stop(cmd));
+	xSemaphoreTake(cmd_mutex, portMAX_DELAY);
 	esp_err_t ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, 50 / portTICK_RATE_MS);
+	xSemaphoreGive(cmd_mutex);
 	i2c_cmd_link_delete(cmd);
 
 	return (bool) ret;
@@ -186,7 +380,9 @@ bool i2c_write_byte
 	i2c_master_write_byte(cmd, register_address, 1);
 	i2c_master_write_byte(cmd, data, 1);
 	i2c_master_stop(cmd);
+	xSemaphoreTake(cmd_mutex, portMAX_DELAY);
 	i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, 1000 / portTICK_PERIOD_MS);
+	xSemaphoreGive(cmd_mutex);
 	i2c_cmd_link_delete(cmd);
 
 	return (true);
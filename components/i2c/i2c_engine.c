@@ -0,0 +1,103 @@
+/**
+ * @file i2c_engine.c
+ *
+ * @brief Asynchronous I2C transfer engine.
+ */
+
+#include "i2c_engine.h"
+#include <string.h>
+
+//***************************************************************************************************************
+
+esp_err_t i2c_engine_init(i2c_engine_t * engine, const i2c_engine_backend_t * backend) {
+    if(!engine || !backend || !backend->transfer || !backend->now_us || !backend->lock || !backend->unlock) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(engine, 0, sizeof(i2c_engine_t));
+    engine->backend = backend;
+    return ESP_OK;
+}
+
+esp_err_t i2c_engine_submit(i2c_engine_t * engine, const i2c_transfer_t * transfer) {
+    if(!engine || !transfer) return ESP_ERR_INVALID_ARG;
+
+    int64_t now = engine->backend->now_us();
+    esp_err_t err = ESP_OK;
+
+    engine->backend->lock();
+    if(engine->count >= I2C_ENGINE_RING_SIZE) {
+        engine->stats.rejected++;
+        err = ESP_ERR_NO_MEM;
+    } else {
+        i2c_transfer_t * slot = &engine->ring[(engine->head + engine->count) % I2C_ENGINE_RING_SIZE];
+        *slot = *transfer;
+        slot->queued_us = now;
+        engine->count++;
+        engine->stats.submitted++;
+        if(engine->count > engine->stats.max_pending) {
+            engine->stats.max_pending = engine->count;
+        }
+    }
+    engine->backend->unlock();
+
+    if(err == ESP_OK && engine->backend->kick) {
+        engine->backend->kick();
+    }
+    return err;
+}
+
+bool i2c_engine_service(i2c_engine_t * engine) {
+    if(!engine) return false;
+
+    // Copy out the head so the slot can't be reused while the transfer runs
+    i2c_transfer_t transfer;
+    engine->backend->lock();
+    if(engine->count == 0) {
+        engine->backend->unlock();
+        return false;
+    }
+    transfer = engine->ring[engine->head];
+    engine->backend->unlock();
+
+    esp_err_t err = engine->backend->transfer(&transfer);
+    uint32_t latency = engine->backend->now_us() - transfer.queued_us;
+
+    // Slot is released before the callback so it can queue follow-up work
+    engine->backend->lock();
+    engine->head = (engine->head + 1) % I2C_ENGINE_RING_SIZE;
+    engine->count--;
+    engine->stats.completed++;
+    if(err != ESP_OK) {
+        engine->stats.errors++;
+    }
+    if(latency > engine->stats.max_latency_us) {
+        engine->stats.max_latency_us = latency;
+    }
+    engine->backend->unlock();
+
+    if(engine->backend->release) {
+        engine->backend->release();
+    }
+    if(transfer.cb) {
+        transfer.cb(transfer.ctx, err);
+    }
+    return true;
+}
+
+uint16_t i2c_engine_pending(i2c_engine_t * engine) {
+    if(!engine) return 0;
+
+    engine->backend->lock();
+    uint16_t count = engine->count;
+    engine->backend->unlock();
+    return count;
+}
+
+void i2c_engine_get_stats(i2c_engine_t * engine, i2c_engine_stats_t * stats) {
+    if(!engine || !stats) return;
+
+    engine->backend->lock();
+    *stats = engine->stats;
+    engine->backend->unlock();
+}
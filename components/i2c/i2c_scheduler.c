@@ -0,0 +1,159 @@
+/**
+ * @file i2c_scheduler.c
+ *
+ * @brief I2C bus transaction scheduler.
+ */
+
+#include "i2c_scheduler.h"
+#include <string.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_rom_sys.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "I2C_Sched";
+
+typedef struct {
+    uint8_t device_address;
+    uint8_t register_address;
+    uint32_t settle_us;
+} i2c_sched_constraint_t;
+
+typedef struct {
+    uint8_t device_address;
+    int64_t ready_at_us;        // Device can't be accessed before this time
+} i2c_sched_device_t;
+
+static i2c_sched_constraint_t constraints[I2C_SCHED_MAX_CONSTRAINTS];
+static uint8_t constraints_len = 0;
+
+static i2c_sched_device_t devices[I2C_SCHED_MAX_DEVICES];
+static uint8_t devices_len = 0;
+
+static i2c_sched_stats_t stats;
+static int64_t stats_start_us = 0;
+
+static portMUX_TYPE sched_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//***************************************************************************************************************
+
+static i2c_sched_device_t * get_device(uint8_t device_address) {
+    for(uint8_t i = 0; i < devices_len; i++) {
+        if(devices[i].device_address == device_address) {
+            return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+//***************************************************************************************************************
+
+esp_err_t i2c_sched_add_constraint(uint8_t device_address, uint8_t register_address, uint32_t settle_us) {
+    esp_err_t err = ESP_OK;
+
+    portENTER_CRITICAL(&sched_lock);
+    if(constraints_len >= I2C_SCHED_MAX_CONSTRAINTS || (get_device(device_address) == NULL && devices_len >= I2C_SCHED_MAX_DEVICES)) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        constraints[constraints_len].device_address = device_address;
+        constraints[constraints_len].register_address = register_address;
+        constraints[constraints_len].settle_us = settle_us;
+        constraints_len++;
+
+        if(get_device(device_address) == NULL) {
+            devices[devices_len].device_address = device_address;
+            devices[devices_len].ready_at_us = 0;
+            devices_len++;
+        }
+    }
+    portEXIT_CRITICAL(&sched_lock);
+
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "No room for constraint 0x%02x:0x%02x", device_address, register_address);
+    }
+    return err;
+}
+
+int64_t i2c_sched_begin(uint8_t device_address) {
+    int64_t now = esp_timer_get_time();
+    int64_t ready_at_us = 0;
+
+    portENTER_CRITICAL(&sched_lock);
+    i2c_sched_device_t * device = get_device(device_address);
+    if(device) {
+        ready_at_us = device->ready_at_us;
+    }
+    portEXIT_CRITICAL(&sched_lock);
+
+    if(ready_at_us <= now) {
+        return now;
+    }
+
+    // Device still settling: sleep for whole ticks, spin for the remainder
+    int64_t wait_us = ready_at_us - now;
+    if(wait_us >= (portTICK_PERIOD_MS * 1000)) {
+        vTaskDelay(wait_us / (portTICK_PERIOD_MS * 1000));
+    }
+    now = esp_timer_get_time();
+    if(ready_at_us > now) {
+        esp_rom_delay_us(ready_at_us - now);
+    }
+
+    int64_t start = esp_timer_get_time();
+    portENTER_CRITICAL(&sched_lock);
+    stats.settle_wait_us += wait_us;
+    portEXIT_CRITICAL(&sched_lock);
+
+    return start;
+}
+
+void i2c_sched_end(uint8_t device_address, uint8_t register_address, bool write, int64_t start, esp_err_t err) {
+    int64_t now = esp_timer_get_time();
+    uint32_t elapsed = now - start;
+
+    portENTER_CRITICAL(&sched_lock);
+    stats.transactions++;
+    if(err != ESP_OK) {
+        stats.errors++;
+    }
+    stats.busy_us += elapsed;
+    if(elapsed > stats.max_transaction_us) {
+        stats.max_transaction_us = elapsed;
+    }
+
+    if(write) {
+        for(uint8_t i = 0; i < constraints_len; i++) {
+            if(constraints[i].device_address == device_address && constraints[i].register_address == register_address) {
+                i2c_sched_device_t * device = get_device(device_address);
+                if(device) {
+                    device->ready_at_us = now + constraints[i].settle_us;
+                }
+                break;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&sched_lock);
+}
+
+void i2c_sched_get_stats(i2c_sched_stats_t * out) {
+    if(!out) return;
+
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&sched_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&sched_lock);
+
+    out->window_us = now - stats_start_us;
+    out->utilization = out->window_us ? (100.0f * out->busy_us) / out->window_us : 0;
+}
+
+void i2c_sched_reset_stats(void) {
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&sched_lock);
+    memset(&stats, 0, sizeof(i2c_sched_stats_t));
+    stats_start_us = now;
+    portEXIT_CRITICAL(&sched_lock);
+}
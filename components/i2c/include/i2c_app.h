@@ -15,28 +15,78 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include <esp_err.h>
+#include "i2c_engine.h"
 
-/* Declare a variable of type xQueueHandle.  This is used to store the queue
-	that is accessed by any task wants to write to I2C. */
-extern QueueHandle_t xQueueI2CWriteBuffer;
-extern QueueHandle_t xQueueI2CReadBuffer;
+/* Task notification bit used by the blocking helpers to wait for completion */
+#define I2C_APP_NOTIFY_BIT              (1UL << 31)
 
-//// Those semaphores are used only for apps who would like to block waiting for end of
-//// transmission or reception if not required to use it's ok
-extern SemaphoreHandle_t xBinarySemaphoreI2CAppEndOfWrite;
-extern SemaphoreHandle_t xBinarySemaphoreI2CAppEndOfRead;
+/* Completion handle owned by the requester. Several requests may share one
+   handle, the requester is notified once all of them are done. */
+typedef struct {
+    TaskHandle_t task;      // Task notified on completion
+    uint32_t bit;           // Notification bit set on completion
+    uint32_t pending;       // Requests submitted and not yet completed
+    esp_err_t status;       // First error reported, ESP_OK otherwise
+} i2c_completion_t;
 
 /* Structure to manipulate buffer sent or received over I2C */
 typedef struct I2C_Structure
 {
+    i2c_op_e op;
     uint8_t device_address;
     uint8_t register_address;
     uint8_t size;
     uint8_t* data;
 } I2C_Status;
 
-void vI2CWrite( void *pvParameters );
-void vI2CRead( void *pvParameters );
+void vI2CTask( void *pvParameters );
+
+/**
+ * @brief Initialize a completion handle for the calling task.
+ *
+ * @param done Completion handle.
+ * @param bit Task notification bit set when all requests are done.
+ */
+void i2c_app_completion_init(i2c_completion_t * done, uint32_t bit);
+
+/**
+ * @brief Queue a request on the I2C bus without waiting for it.
+ *
+ * @param msg Request. Data buffer must stay valid until completion.
+ * @param done Completion handle, may be NULL for fire and forget.
+ * @param timeout Time to wait for a free transfer slot.
+ *
+ * @return ESP_ERR_TIMEOUT if no transfer slot got free in time.
+ */
+esp_err_t i2c_app_submit(I2C_Status * msg, i2c_completion_t * done, TickType_t timeout);
+
+/**
+ * @brief Queue a request on the I2C bus with a completion callback.
+ *
+ * The callback runs in the I2C task and must not block.
+ *
+ * @param msg Request. Data buffer must stay valid until completion.
+ * @param cb Completion callback, may be NULL.
+ * @param ctx Passed to the callback.
+ * @param timeout Time to wait for a free transfer slot.
+ *
+ * @return ESP_ERR_TIMEOUT if no slot got free in time.
+ */
+esp_err_t i2c_app_submit_cb(I2C_Status * msg, i2c_transfer_cb_t cb, void * ctx, TickType_t timeout);
+
+/**
+ * @brief Wait until every request attached to the handle is done.
+ *
+ * @return Status of the requests or ESP_ERR_TIMEOUT.
+ */
+esp_err_t i2c_app_wait(i2c_completion_t * done, TickType_t timeout);
+
+/* Blocking helpers: submit one request and wait for its completion */
+esp_err_t i2c_app_read(uint8_t device_address, uint8_t register_address, uint8_t size, uint8_t * data);
+esp_err_t i2c_app_write(uint8_t device_address, uint8_t register_address, uint8_t size, uint8_t * data);
+
+void i2c_app_get_engine_stats(i2c_engine_stats_t * stats);
 
 
 #endif //_I2C_APP_
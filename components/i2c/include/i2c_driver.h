@@ -16,24 +16,111 @@
 
 #include <driver/i2c.h>
 
+#define I2C_BUS_MAX_DEVICES             8
+
+/* Bus clock profiles. The active clock is the profile clock capped by the
+   slowest registered device. Fast-mode Plus needs stronger pull-ups than
+   the internal ones. */
+typedef enum {
+    I2C_BUS_PROFILE_STANDARD = 0,   // 100 kHz
+    I2C_BUS_PROFILE_FAST,           // 400 kHz
+    I2C_BUS_PROFILE_FAST_PLUS,      // 1 MHz
+    I2C_BUS_PROFILE_MAX,
+} i2c_bus_profile_e;
+
+#ifndef I2C_BUS_PROFILE_DEFAULT
+#define I2C_BUS_PROFILE_DEFAULT         I2C_BUS_PROFILE_FAST
+#endif
+
+typedef struct {
+    uint8_t device_address;
+    uint32_t max_clk_hz;
+} i2c_bus_device_t;
+
 void i2c_init();
+
+/**
+ * @brief Declare the maximum clock a device on the bus supports.
+ *
+ * The bus clock is lowered right away if the device is slower than the
+ * active one.
+ *
+ * @param device_address I2C slave device address.
+ * @param max_clk_hz Maximum SCL frequency.
+ *
+ * @return ESP_ERR_NO_MEM if the device table is full.
+ */
+esp_err_t i2c_bus_register_device(uint8_t device_address, uint32_t max_clk_hz);
+
+/**
+ * @brief Select the bus profile and reconfigure the bus clock.
+ *
+ * Waits for the transaction in progress to finish.
+ */
+esp_err_t i2c_bus_set_profile(i2c_bus_profile_e profile);
+i2c_bus_profile_e i2c_bus_get_profile();
+uint32_t i2c_bus_get_clock();
+const char * i2c_bus_profile_to_string(i2c_bus_profile_e profile);
+uint8_t i2c_bus_get_devices(i2c_bus_device_t * devices, uint8_t max_devices);
+
 /**
  * @brief Select the register in the device where data will be read from.
  *
  * @param device_address I2C slave device address.
  * @param register_address Address of the first register to read from.
+ *
+ * @return Status of the bus transaction.
  */
-void select_register(uint8_t device_address, uint8_t register_address);
+esp_err_t select_register(uint8_t device_address, uint8_t register_address);
 
 /**
  * @brief Read multiple bytes from 8-bit registers.
  *
+ * Register select and read are issued as a single transaction with a
+ * repeated start, from a preallocated command link.
+ *
  * @param device_address I2C slave device address.
  * @param register_address Address of the first register to read from.
  * @param size Number of registers to read.
  * @param data Buffer to store the read data in.
  *
- * @return Status of read operation.
+ * @return Status of the bus transaction.
+ */
+esp_err_t i2c_read_register
+(
+    uint8_t device_address,
+    uint8_t register_address,
+    uint8_t size,
+    uint8_t* data
+);
+
+/**
+ * @brief Write multiple bytes to 8-bit registers.
+ *
+ * @param device_address I2C slave device address.
+ * @param register_address Address of the first register to write to.
+ * @param size Number of bytes to write, 0 only selects the register.
+ * @param data Array of bytes to write.
+ *
+ * @return Status of the bus transaction.
+ */
+esp_err_t i2c_write_register
+(
+    uint8_t device_address,
+    uint8_t register_address,
+    uint8_t size,
+    uint8_t* data
+);
+
+/**
+ * @brief Read multiple bytes from 8-bit registers.
+ *
+ * @param device_address I2C slave device address.
+ * @param register_address Address of the first register to read from.
+ * @param size Number of registers to read.
+ * @param data Buffer to store the read data in.
+ *
+ * @return Number of bytes read, 0 on error.
  */
 int8_t i2c_read_bytes
 (
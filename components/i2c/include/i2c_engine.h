@@ -0,0 +1,92 @@
+/**
+ * @file i2c_engine.h
+ *
+ * @brief Asynchronous I2C transfer engine.
+ *
+ * Transfers are queued in a fixed ring of descriptors and executed in
+ * submission order by whoever services the engine. Each descriptor carries
+ * a completion callback, so requesters can queue work and keep running.
+ *
+ * The engine core has no knowledge of the bus or the RTOS: executing a
+ * transfer, reading the time, locking and waking the servicing context are
+ * provided by a backend.
+ */
+
+#ifndef _I2C_ENGINE_H_
+#define _I2C_ENGINE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#define I2C_ENGINE_RING_SIZE            16
+
+typedef enum {
+    I2C_OP_READ = 0,
+    I2C_OP_WRITE,
+} i2c_op_e;
+
+/* Called from the servicing context once the transfer is done */
+typedef void (*i2c_transfer_cb_t)(void * ctx, esp_err_t err);
+
+/* Transfer descriptor */
+typedef struct {
+    i2c_op_e op;
+    uint8_t device_address;
+    uint8_t register_address;
+    uint8_t size;
+    uint8_t * data;                 // Must stay valid until completion
+    i2c_transfer_cb_t cb;           // May be NULL
+    void * ctx;
+    int64_t queued_us;              // Set by the engine on submit
+} i2c_transfer_t;
+
+typedef struct {
+    esp_err_t (*transfer)(const i2c_transfer_t * transfer);     // Run a transfer on the bus
+    int64_t (*now_us)(void);
+    void (*lock)(void);             // Protects the ring, may be called from an ISR
+    void (*unlock)(void);
+    void (*kick)(void);             // Wake the servicing context, may be NULL
+    void (*release)(void);          // A ring slot was freed, called before the callback, may be NULL
+} i2c_engine_backend_t;
+
+typedef struct {
+    uint32_t submitted;
+    uint32_t completed;
+    uint32_t rejected;              // Submits refused because the ring was full
+    uint32_t errors;
+    uint16_t max_pending;           // Ring high water mark
+    uint32_t max_latency_us;        // Longest submit to completion time
+} i2c_engine_stats_t;
+
+typedef struct {
+    i2c_transfer_t ring[I2C_ENGINE_RING_SIZE];
+    uint16_t head;                  // Next transfer to run
+    uint16_t count;
+    const i2c_engine_backend_t * backend;
+    i2c_engine_stats_t stats;
+} i2c_engine_t;
+
+esp_err_t i2c_engine_init(i2c_engine_t * engine, const i2c_engine_backend_t * backend);
+
+/**
+ * @brief Copy a transfer into the ring and wake the servicing context.
+ *
+ * @return ESP_ERR_NO_MEM if the ring is full.
+ */
+esp_err_t i2c_engine_submit(i2c_engine_t * engine, const i2c_transfer_t * transfer);
+
+/**
+ * @brief Run the oldest pending transfer and call its callback.
+ *
+ * The ring slot is freed and reported to the backend before the callback
+ * runs, so the callback can submit the next transfer.
+ *
+ * @return True if a transfer was run.
+ */
+bool i2c_engine_service(i2c_engine_t * engine);
+
+uint16_t i2c_engine_pending(i2c_engine_t * engine);
+void i2c_engine_get_stats(i2c_engine_t * engine, i2c_engine_stats_t * stats);
+
+#endif //_I2C_ENGINE_H_
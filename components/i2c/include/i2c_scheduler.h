@@ -0,0 +1,67 @@
+/**
+ * @file i2c_scheduler.h
+ *
+ * @brief I2C bus transaction scheduler.
+ *
+ * Transactions run back-to-back on the bus. A device is only held off when
+ * its datasheet requires a settle time after writing to a given register
+ * (e.g. soft reset, wake from sleep). Those requirements are registered as
+ * constraints by the device drivers.
+ */
+
+#ifndef _I2C_SCHEDULER_H_
+#define _I2C_SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#define I2C_SCHED_MAX_CONSTRAINTS       8
+#define I2C_SCHED_MAX_DEVICES           8
+
+/* Bus usage statistics */
+typedef struct {
+    uint32_t transactions;          // Transactions executed since last reset
+    uint32_t errors;                // Transactions that failed
+    uint64_t busy_us;               // Time spent executing transactions
+    uint64_t settle_wait_us;        // Time spent waiting for device settle constraints
+    uint64_t window_us;             // Time elapsed since last reset
+    uint32_t max_transaction_us;    // Longest single transaction
+    float utilization;              // busy_us / window_us in percent
+} i2c_sched_stats_t;
+
+/**
+ * @brief Register a settle time required after writing to a device register.
+ *
+ * @param device_address I2C slave device address.
+ * @param register_address Register that triggers the settle time when written.
+ * @param settle_us Time the device must be left alone after the write.
+ *
+ * @return ESP_ERR_NO_MEM if the constraint table is full.
+ */
+esp_err_t i2c_sched_add_constraint(uint8_t device_address, uint8_t register_address, uint32_t settle_us);
+
+/**
+ * @brief Wait until the device is ready and mark the start of a transaction.
+ *
+ * @param device_address I2C slave device address.
+ *
+ * @return Transaction start time, to be passed to i2c_sched_end().
+ */
+int64_t i2c_sched_begin(uint8_t device_address);
+
+/**
+ * @brief Mark the end of a transaction started with i2c_sched_begin().
+ *
+ * @param device_address I2C slave device address.
+ * @param register_address First register accessed by the transaction.
+ * @param write True if the transaction wrote to the device.
+ * @param start Value returned by i2c_sched_begin().
+ * @param err Result of the transaction.
+ */
+void i2c_sched_end(uint8_t device_address, uint8_t register_address, bool write, int64_t start, esp_err_t err);
+
+void i2c_sched_get_stats(i2c_sched_stats_t * stats);
+void i2c_sched_reset_stats(void);
+
+#endif //_I2C_SCHEDULER_H_
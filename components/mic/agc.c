@@ -0,0 +1,106 @@
+#include "agc.h"
+#include <math.h>
+#include <string.h>
+
+//******************************************************************************************************************
+
+static float db_to_linear(float db) {
+    return powf(10.0f, db / 20.0f);
+}
+
+static float linear_to_db(float value) {
+    if(value < 1e-10f) value = 1e-10f;
+    return 20.0f * log10f(value);
+}
+
+static float agc_measure(const agc_t * agc, const int32_t * samples, size_t len) {
+    if(agc->config.detector == AGC_DETECTOR_RMS) {
+        float sum = 0;
+        for(size_t i = 0; i < len; i++) {
+            float x = (float)samples[i];
+            sum += x * x;
+        }
+        return sqrtf(sum / len) / AGC_INPUT_FULL_SCALE;
+    }
+
+    uint32_t peak = 0;
+    for(size_t i = 0; i < len; i++) {
+        // Negate in unsigned so INT32_MIN does not overflow
+        uint32_t x = samples[i] < 0 ? 0u - (uint32_t)samples[i] : (uint32_t)samples[i];
+        if(x > peak) peak = x;
+    }
+    return (float)peak / AGC_INPUT_FULL_SCALE;
+}
+
+//******************************************************************************************************************
+
+void agc_get_default_config(agc_config_t * config) {
+    if(!config) return;
+
+    config->detector = AGC_DETECTOR;
+    config->target_dbfs = AGC_TARGET_DBFS;
+    config->max_gain_db = AGC_MAX_GAIN_DB;
+    config->min_gain_db = AGC_MIN_GAIN_DB;
+    config->attack_ms = AGC_ATTACK_MS;
+    config->release_ms = AGC_RELEASE_MS;
+    config->gate_dbfs = AGC_GATE_DBFS;
+}
+
+esp_err_t agc_init(agc_t * agc, const agc_config_t * config, float sample_rate) {
+    if(!agc || !config || sample_rate <= 0 || config->min_gain_db > config->max_gain_db ||
+        config->attack_ms <= 0 || config->release_ms <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(agc, 0, sizeof(agc_t));
+    agc->config = *config;
+    agc->sample_rate = sample_rate;
+    agc->target = db_to_linear(config->target_dbfs);
+    agc->max_gain = db_to_linear(config->max_gain_db);
+    agc->min_gain = db_to_linear(config->min_gain_db);
+    agc->gate = db_to_linear(config->gate_dbfs);
+
+    agc->gain = 1.0f;
+    if(agc->gain > agc->max_gain) agc->gain = agc->max_gain;
+    if(agc->gain < agc->min_gain) agc->gain = agc->min_gain;
+    return ESP_OK;
+}
+
+void agc_process(agc_t * agc, int32_t * samples, size_t len) {
+    if(!agc || !samples || len == 0) return;
+
+    float start_gain = agc->gain;
+    agc->level = agc_measure(agc, samples, len);
+    agc->gated = agc->level < agc->gate;
+
+    if(!agc->gated) {
+        float wanted = agc->target / agc->level;
+        if(wanted > agc->max_gain) wanted = agc->max_gain;
+        if(wanted < agc->min_gain) wanted = agc->min_gain;
+
+        // One pole smoothing, evaluated once per block
+        float time_ms = wanted < agc->gain ? agc->config.attack_ms : agc->config.release_ms;
+        float coef = expf(-1000.0f * len / (agc->sample_rate * time_ms));
+        agc->gain = wanted + (agc->gain - wanted) * coef;
+    }
+
+    // Ramp from the previous gain, unity gain lands on the output full scale
+    const float scale = AGC_OUTPUT_FULL_SCALE / AGC_INPUT_FULL_SCALE;
+    float gain = start_gain * scale;
+    float step = (agc->gain - start_gain) * scale / len;
+    for(size_t i = 0; i < len; i++) {
+        gain += step;
+        float y = (float)samples[i] * gain;
+        if(y > AGC_OUTPUT_FULL_SCALE) y = AGC_OUTPUT_FULL_SCALE;
+        if(y < -AGC_OUTPUT_FULL_SCALE) y = -AGC_OUTPUT_FULL_SCALE;
+        samples[i] = (int32_t)y;
+    }
+}
+
+float agc_get_gain_db(const agc_t * agc) {
+    return agc ? linear_to_db(agc->gain) : 0;
+}
+
+float agc_get_level_dbfs(const agc_t * agc) {
+    return agc ? linear_to_db(agc->level) : 0;
+}
@@ -0,0 +1,70 @@
+#include "audio_pool.h"
+#include "esp_log.h"
+#include "freertos/queue.h"
+
+//******************************************************************************************************************
+
+static const char *TAG = "AUDIO_POOL";
+
+static audio_block_t blocks[AUDIO_POOL_BLOCKS];
+
+// Free blocks, by pointer
+static QueueHandle_t xQueueAudioFree = NULL;
+
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//******************************************************************************************************************
+
+esp_err_t audio_pool_init() {
+    xQueueAudioFree = xQueueCreate(AUDIO_POOL_BLOCKS, sizeof(audio_block_t *));
+    if(xQueueAudioFree == NULL) {
+        ESP_LOGE(TAG, "ERROR Creating free block queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    for(uint8_t i = 0; i < AUDIO_POOL_BLOCKS; i++) {
+        audio_block_t * block = &blocks[i];
+        block->len = 0;
+        block->refs = 0;
+        xQueueSend(xQueueAudioFree, (void *)&block, 0);
+    }
+    return ESP_OK;
+}
+
+audio_block_t * audio_pool_get(TickType_t timeout) {
+    audio_block_t * block = NULL;
+    if(xQueueReceive(xQueueAudioFree, (void *)&block, timeout) != pdPASS) {
+        return NULL;
+    }
+
+    block->len = 0;
+    block->refs = 1;
+    return block;
+}
+
+void audio_pool_retain(audio_block_t * block) {
+    portENTER_CRITICAL(&pool_lock);
+    block->refs++;
+    portEXIT_CRITICAL(&pool_lock);
+}
+
+void audio_pool_release(audio_block_t * block) {
+    if(!block) return;
+
+    bool free_block = false;
+    portENTER_CRITICAL(&pool_lock);
+    if(block->refs > 0) {
+        block->refs--;
+        free_block = (block->refs == 0);
+    }
+    portEXIT_CRITICAL(&pool_lock);
+
+    // Last owner hands the block back
+    if(free_block) {
+        xQueueSend(xQueueAudioFree, (void *)&block, 0);
+    }
+}
+
+uint32_t audio_pool_free_count() {
+    return uxQueueMessagesWaiting(xQueueAudioFree);
+}
@@ -0,0 +1,134 @@
+#include "bands.h"
+#include "stft.h"
+#include "esp_log.h"
+#include <string.h>
+#include <math.h>
+
+//******************************************************************************************************************
+
+static const char *TAG = "BANDS";
+
+// Nominal ISO centers, exact centers are 1000 * 2^(k/3) Hz
+#define THIRD_OCTAVE_FIRST_K    (-16)
+static const char * third_octave_names[] = {"25", "31.5", "40", "50", "63", "80", "100", "125", "160", "200",
+                                            "250", "315", "400", "500", "630", "800", "1k", "1.25k", "1.6k", "2k",
+                                            "2.5k", "3.15k", "4k", "5k", "6.3k", "8k", "10k", "12.5k", "16k"};
+
+// Exact centers are 1000 * 2^k Hz
+#define OCTAVE_FIRST_K          (-5)
+static const char * octave_names[] = {"31.5", "63", "125", "250", "500", "1k", "2k", "4k", "8k", "16k"};
+
+// Band of every spectrum bin, -1 if outside all bands
+static int8_t bin_to_band[STFT_MAX_WINDOW / 2];
+static const char * band_names[BANDS_MAX];
+static uint8_t band_count = 0;
+
+static size_t bins = 0;
+static float bin_hz = 0;
+static size_t window_len = 0;
+
+static float last_magnitude[BANDS_MAX];
+
+//******************************************************************************************************************
+
+esp_err_t bands_init(bands_mode_e mode, float sample_rate, size_t window) {
+    if(window < 4 || window > STFT_MAX_WINDOW || sample_rate <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const char ** names;
+    int first_k;
+    int steps;          // Bands per octave
+    size_t names_len;
+    if(mode == BANDS_THIRD_OCTAVE) {
+        names = third_octave_names;
+        names_len = sizeof(third_octave_names) / sizeof(third_octave_names[0]);
+        first_k = THIRD_OCTAVE_FIRST_K;
+        steps = 3;
+    } else {
+        names = octave_names;
+        names_len = sizeof(octave_names) / sizeof(octave_names[0]);
+        first_k = OCTAVE_FIRST_K;
+        steps = 1;
+    }
+
+    window_len = window;
+    bins = window / 2;
+    bin_hz = sample_rate / window;
+    band_count = 0;
+    memset(bin_to_band, -1, sizeof(bin_to_band));
+    memset(last_magnitude, 0, sizeof(last_magnitude));
+
+    // Bands are contiguous, walk bins and bands together. DC is left out.
+    size_t bin = 1;
+    for(size_t n = 0; n < names_len && band_count < BANDS_MAX; n++) {
+        float center = 1000.0f * powf(2.0f, (float)(first_k + (int)n) / steps);
+        float low = center * powf(2.0f, -0.5f / steps);
+        float high = center * powf(2.0f, 0.5f / steps);
+
+        while(bin < bins && bin * bin_hz < low) {
+            bin++;
+        }
+        if(bin >= bins) {
+            break;
+        }
+        // Too narrow for the bin spacing
+        if(bin * bin_hz >= high) {
+            continue;
+        }
+
+        while(bin < bins && bin * bin_hz < high) {
+            bin_to_band[bin] = band_count;
+            bin++;
+        }
+        band_names[band_count] = names[n];
+        band_count++;
+    }
+
+    ESP_LOGI(TAG, "%u %s bands, %.2f Hz per bin", band_count, mode == BANDS_THIRD_OCTAVE ? "third-octave" : "octave", bin_hz);
+    return ESP_OK;
+}
+
+void bands_process(const float * power, bands_result_t * result) {
+    float total = 0;
+    float weighted = 0;
+
+    memset(result->band, 0, sizeof(result->band));
+    result->band_count = band_count;
+
+    for(size_t i = 1; i < bins; i++) {
+        float p = power[i];
+        total += p;
+        weighted += p * i;
+        int8_t band = bin_to_band[i];
+        if(band >= 0) {
+            result->band[band] += p;
+        }
+    }
+
+    // Parseval, with power = |X|^2 / N and half the spectrum: mean(x^2) = 2 * sum(power) / N
+    result->rms = sqrtf(2 * total / window_len);
+    result->centroid = total > 0 ? (weighted / total) * bin_hz : 0;
+
+    // Half-wave rectified change of band magnitudes
+    float rise = 0;
+    float level = 0;
+    for(uint8_t b = 0; b < band_count; b++) {
+        float magnitude = sqrtf(result->band[b]);
+        if(magnitude > last_magnitude[b]) {
+            rise += magnitude - last_magnitude[b];
+        }
+        level += magnitude;
+        last_magnitude[b] = magnitude;
+    }
+    result->flux = level > 0 ? rise / level : 0;
+}
+
+uint8_t bands_get_count() {
+    return band_count;
+}
+
+const char * bands_get_name(uint8_t band) {
+    if(band >= band_count) return "";
+    return band_names[band];
+}
@@ -0,0 +1,148 @@
+#include "fft_real.h"
+#include "esp_dsp.h"
+#include <math.h>
+
+//******************************************************************************************************************
+
+// W^k = exp(-j*2*pi*k/N) for k in 0..N/4, stored as cos, sin pairs
+static float twiddle[(FFT_REAL_MAX_SIZE / 4 + 1) * 2];
+static int twiddle_n = 0;
+
+// Same table in Q15
+static int16_t twiddle_q15[(FFT_REAL_MAX_SIZE / 4 + 1) * 2];
+static int twiddle_q15_n = 0;
+
+//******************************************************************************************************************
+
+esp_err_t fft_real_init_fc32(int n) {
+    if(n < 4 || n > FFT_REAL_MAX_SIZE || (n & (n - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for(int k = 0; k <= n / 4; k++) {
+        float angle = 2 * M_PI * k / n;
+        twiddle[k * 2 + 0] = cosf(angle);
+        twiddle[k * 2 + 1] = sinf(angle);
+    }
+    twiddle_n = n;
+
+    return ESP_OK;
+}
+
+esp_err_t fft_real_fc32(float * data, int n) {
+    if(data == NULL || n != twiddle_n) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const int half = n / 2;
+
+    // z[m] = x[2m] + j*x[2m+1]
+    esp_err_t err = dsps_fft2r_fc32(data, half);
+    if(err != ESP_OK) {
+        return err;
+    }
+    dsps_bit_rev_fc32(data, half);
+
+    // DC and Nyquist are both real: X[0] = Re Z[0] + Im Z[0], X[N/2] = Re Z[0] - Im Z[0]
+    float z0_re = data[0];
+    float z0_im = data[1];
+    data[0] = z0_re + z0_im;
+    data[1] = z0_re - z0_im;
+
+    // Split bins k and N/2-k together:
+    //   E = (Z[k] + conj(Z[N/2-k])) / 2       spectrum of the even samples
+    //   O = -j (Z[k] - conj(Z[N/2-k])) / 2    spectrum of the odd samples
+    //   X[k] = E + W^k O,  X[N/2-k] = conj(E - W^k O)
+    for(int k = 1; k <= half / 2; k++) {
+        int m = half - k;
+        float a = data[k * 2 + 0];
+        float b = data[k * 2 + 1];
+        float c = data[m * 2 + 0];
+        float d = data[m * 2 + 1];
+
+        float e_re = 0.5f * (a + c);
+        float e_im = 0.5f * (b - d);
+        float o_re = 0.5f * (b + d);
+        float o_im = 0.5f * (c - a);
+
+        float w_re = twiddle[k * 2 + 0];
+        float w_im = -twiddle[k * 2 + 1];
+        float t_re = w_re * o_re - w_im * o_im;
+        float t_im = w_re * o_im + w_im * o_re;
+
+        data[k * 2 + 0] = e_re + t_re;
+        data[k * 2 + 1] = e_im + t_im;
+        if(m != k) {
+            data[m * 2 + 0] = e_re - t_re;
+            data[m * 2 + 1] = t_im - e_im;
+        }
+    }
+
+    return ESP_OK;
+}
+
+//******************************************************************************************************************
+
+esp_err_t fft_real_init_sc16(int n) {
+    if(n < 4 || n > FFT_REAL_MAX_SIZE || (n & (n - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for(int k = 0; k <= n / 4; k++) {
+        float angle = 2 * M_PI * k / n;
+        twiddle_q15[k * 2 + 0] = (int16_t)lroundf(cosf(angle) * INT16_MAX);
+        twiddle_q15[k * 2 + 1] = (int16_t)lroundf(sinf(angle) * INT16_MAX);
+    }
+    twiddle_q15_n = n;
+
+    return ESP_OK;
+}
+
+esp_err_t fft_real_sc16(int16_t * data, int n) {
+    if(data == NULL || n != twiddle_q15_n) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const int half = n / 2;
+
+    // z[m] = x[2m] + j*x[2m+1], comes out as Z[k] / (N/2)
+    esp_err_t err = dsps_fft2r_sc16(data, half);
+    if(err != ESP_OK) {
+        return err;
+    }
+    dsps_bit_rev_sc16_ansi(data, half);
+
+    int32_t z0_re = data[0];
+    int32_t z0_im = data[1];
+    data[0] = (z0_re + z0_im) >> 1;
+    data[1] = (z0_re - z0_im) >> 1;
+
+    // Same split as the float version, on 2E and 2O so nothing is lost before the final shift
+    for(int k = 1; k <= half / 2; k++) {
+        int m = half - k;
+        int32_t a = data[k * 2 + 0];
+        int32_t b = data[k * 2 + 1];
+        int32_t c = data[m * 2 + 0];
+        int32_t d = data[m * 2 + 1];
+
+        int32_t e_re = a + c;
+        int32_t e_im = b - d;
+        int32_t o_re = b + d;
+        int32_t o_im = c - a;
+
+        int32_t w_re = twiddle_q15[k * 2 + 0];
+        int32_t w_im = -twiddle_q15[k * 2 + 1];
+        // |O| can reach 2^16.5, products need 64 bits
+        int32_t t_re = (int32_t)(((int64_t)w_re * o_re - (int64_t)w_im * o_im) >> 15);
+        int32_t t_im = (int32_t)(((int64_t)w_re * o_im + (int64_t)w_im * o_re) >> 15);
+
+        data[k * 2 + 0] = (e_re + t_re) >> 2;
+        data[k * 2 + 1] = (e_im + t_im) >> 2;
+        if(m != k) {
+            data[m * 2 + 0] = (e_re - t_re) >> 2;
+            data[m * 2 + 1] = (t_im - e_im) >> 2;
+        }
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,106 @@
+#ifndef _AGC_H_
+#define _AGC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+/**
+ * Block based automatic gain control.
+ *
+ * The level of every block is measured with a peak or RMS detector and the
+ * gain is steered toward the one that puts that level at the target. Gain
+ * reductions follow the attack time, increases the release time, and the
+ * gain is ramped across the block so steps are not audible in the stream.
+ * Blocks below the noise gate keep the current gain, so silence is not
+ * pumped up to the target.
+ *
+ * Input is 32 bit I2S samples. At 0 dB of gain the output matches the
+ * previous fixed >>5 scaling, full scale being AGC_OUTPUT_FULL_SCALE.
+ */
+
+#define AGC_INPUT_FULL_SCALE    2147483648.0f
+#define AGC_OUTPUT_FULL_SCALE   67108864.0f         // 2^26
+
+typedef enum {
+    AGC_DETECTOR_PEAK = 0,
+    AGC_DETECTOR_RMS,
+} agc_detector_e;
+
+#ifndef AGC_DETECTOR
+#define AGC_DETECTOR            AGC_DETECTOR_PEAK
+#endif
+
+#ifndef AGC_TARGET_DBFS
+#define AGC_TARGET_DBFS         (-12.0f)
+#endif
+
+#ifndef AGC_MAX_GAIN_DB
+#define AGC_MAX_GAIN_DB         (30.0f)
+#endif
+
+#ifndef AGC_MIN_GAIN_DB
+#define AGC_MIN_GAIN_DB         (-12.0f)
+#endif
+
+#ifndef AGC_ATTACK_MS
+#define AGC_ATTACK_MS           (5.0f)
+#endif
+
+#ifndef AGC_RELEASE_MS
+#define AGC_RELEASE_MS          (500.0f)
+#endif
+
+#ifndef AGC_GATE_DBFS
+#define AGC_GATE_DBFS           (-70.0f)
+#endif
+
+typedef struct {
+    agc_detector_e detector;
+    float target_dbfs;          // Detector level the gain aims for
+    float max_gain_db;
+    float min_gain_db;
+    float attack_ms;            // Time constant of gain reductions
+    float release_ms;           // Time constant of gain increases
+    float gate_dbfs;            // Blocks below this level hold the gain
+} agc_config_t;
+
+typedef struct {
+    agc_config_t config;
+    float sample_rate;
+    float target;               // Linear, relative to full scale
+    float max_gain;
+    float min_gain;
+    float gate;
+    float gain;                 // Linear gain applied at the end of the last block
+    float level;                // Detector level of the last block, relative to full scale
+    bool gated;                 // Last block was below the gate
+} agc_t;
+
+// Default configuration from the AGC_* defines
+void agc_get_default_config(agc_config_t * config);
+
+/**
+ * @brief Set up the AGC, gain starts at 0 dB.
+ *
+ * @param agc AGC state.
+ * @param config Configuration, copied.
+ * @param sample_rate Sample rate in Hz, used for the time constants.
+ */
+esp_err_t agc_init(agc_t * agc, const agc_config_t * config, float sample_rate);
+
+/**
+ * @brief Measure a block, update the gain and apply it in place.
+ *
+ * @param agc AGC state.
+ * @param samples Raw I2S samples in, scaled samples out.
+ * @param len Number of samples.
+ */
+void agc_process(agc_t * agc, int32_t * samples, size_t len);
+
+float agc_get_gain_db(const agc_t * agc);
+// Detector level of the last block in dBFS
+float agc_get_level_dbfs(const agc_t * agc);
+
+#endif //_AGC_H_
@@ -0,0 +1,40 @@
+#ifndef _AUDIO_POOL_H_
+#define _AUDIO_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include "freertos/FreeRTOS.h"
+#include "mic_driver.h"
+
+/**
+ * Fixed pool of audio blocks shared by the mic, FFT and stream stages.
+ *
+ * A block is reference counted: the producer gets it with one reference,
+ * takes one more for every consumer it hands it to and drops its own.
+ * The block goes back to the pool when the last consumer releases it.
+ */
+
+#define AUDIO_POOL_BLOCKS           6
+#define AUDIO_BLOCK_SAMPLES         I2S_AUDIO_BUFFER_SIZE
+
+typedef struct {
+    int32_t samples[AUDIO_BLOCK_SAMPLES];
+    size_t len;                 // Valid samples
+    uint32_t refs;
+} audio_block_t;
+
+esp_err_t audio_pool_init();
+
+/**
+ * @brief Take a free block, owned by the caller with a single reference.
+ *
+ * @return NULL if no block got free in time.
+ */
+audio_block_t * audio_pool_get(TickType_t timeout);
+void audio_pool_retain(audio_block_t * block);
+void audio_pool_release(audio_block_t * block);
+
+uint32_t audio_pool_free_count();
+
+#endif //_AUDIO_POOL_H_
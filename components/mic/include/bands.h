@@ -0,0 +1,58 @@
+#ifndef _BANDS_H_
+#define _BANDS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+/**
+ * Band energy engine.
+ *
+ * Spectrum bins are grouped into ISO octave or third-octave bands through a
+ * bin to band index table built once for the frame geometry. Bands holding
+ * no bin at the current resolution are left out. Along with the band
+ * energies every frame also gets the RMS level, the spectral centroid and
+ * the spectral flux.
+ */
+
+#define BANDS_MAX               32
+
+typedef enum {
+    BANDS_OCTAVE = 0,
+    BANDS_THIRD_OCTAVE,
+} bands_mode_e;
+
+#ifndef BANDS_MODE
+#define BANDS_MODE              BANDS_OCTAVE
+#endif
+
+typedef struct {
+    float band[BANDS_MAX];      // Linear power per band
+    uint8_t band_count;
+    float rms;                  // RMS of the windowed frame
+    float centroid;             // Spectral centroid in Hz
+    float flux;                 // Positive change of band magnitudes, relative to the frame level
+} bands_result_t;
+
+/**
+ * @brief Build the bin to band table.
+ *
+ * @param mode Octave or third-octave bands.
+ * @param sample_rate Sample rate in Hz.
+ * @param window FFT length, the spectrum has window/2 bins.
+ */
+esp_err_t bands_init(bands_mode_e mode, float sample_rate, size_t window);
+
+/**
+ * @brief Compute band energies and frame features.
+ *
+ * @param power Linear power per bin, |X[k]|^2 / window, window/2 bins.
+ * @param result Frame result.
+ */
+void bands_process(const float * power, bands_result_t * result);
+
+uint8_t bands_get_count();
+// Nominal band center, e.g. "31.5" or "1k"
+const char * bands_get_name(uint8_t band);
+
+#endif //_BANDS_H_
@@ -0,0 +1,29 @@
+#ifndef _FAST_LOG_H_
+#define _FAST_LOG_H_
+
+#include <stdint.h>
+
+/**
+ * Approximate 10*log10(x) for positive normal floats.
+ *
+ * log2(x) = e + log2(m), with the exponent e read from the float bits and
+ * log2(m), m in [1, 2), from a cubic fitted on Chebyshev nodes. The
+ * polynomial error is below 9e-4 in log2, so the result is within 0.003 dB
+ * of 10*log10f(x). No special handling of zero, negative or subnormal input.
+ */
+static inline float fast_db10(float x) {
+    union {
+        float f;
+        uint32_t u;
+    } v = { .f = x };
+
+    int32_t e = (int32_t)((v.u >> 23) & 0xFF) - 127;
+    v.u = (v.u & 0x007FFFFF) | 0x3F800000;
+    float t = v.f - 1.0f;
+
+    float log2_x = e + t * (1.4231016f + t * (-0.584525f + t * 0.1620769f));
+    // 10 * log10(2)
+    return 3.0103f * log2_x;
+}
+
+#endif //_FAST_LOG_H_
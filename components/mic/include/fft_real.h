@@ -0,0 +1,62 @@
+#ifndef _FFT_REAL_H_
+#define _FFT_REAL_H_
+
+#include <stdint.h>
+#include <esp_err.h>
+
+/**
+ * Real input FFT.
+ *
+ * N real samples are packed as N/2 complex values (even samples in the real
+ * part, odd samples in the imaginary part), transformed with an N/2 point
+ * complex FFT and split into the spectrum of the real signal. That is half
+ * the butterflies of running the complex FFT with zeroed imaginary parts.
+ */
+
+#define FFT_REAL_MAX_SIZE       2048
+
+// Build time selection of the integer (Q15) spectrum path
+#ifndef AUDIO_FFT_FIXED_POINT
+#define AUDIO_FFT_FIXED_POINT   0
+#endif
+
+/**
+ * @brief Build the split twiddle table for N point transforms.
+ *
+ * The esp-dsp fc32 FFT must be initialized for at least N/2 points.
+ *
+ * @param n Number of real samples, power of two up to FFT_REAL_MAX_SIZE.
+ */
+esp_err_t fft_real_init_fc32(int n);
+
+/**
+ * @brief In place real FFT.
+ *
+ * Output layout, bins 0..N/2:
+ *   data[0] = Re X[0] (DC), data[1] = Re X[N/2] (Nyquist),
+ *   data[2k], data[2k+1] = Re X[k], Im X[k] for k in 1..N/2-1.
+ *
+ * @param data N real samples in, N/2 complex bins out.
+ * @param n Number of real samples, the value given to fft_real_init_fc32().
+ */
+esp_err_t fft_real_fc32(float * data, int n);
+
+/**
+ * @brief Build the Q15 split twiddle table for N point transforms.
+ *
+ * The esp-dsp sc16 FFT must be initialized for at least N/2 points.
+ */
+esp_err_t fft_real_init_sc16(int n);
+
+/**
+ * @brief In place Q15 real FFT.
+ *
+ * Same layout as fft_real_fc32(). The sc16 FFT scales every stage by 1/2
+ * and the split halves once more, so the output is X[k] / N.
+ *
+ * @param data N real Q15 samples in, N/2 complex Q15 bins out.
+ * @param n Number of real samples, the value given to fft_real_init_sc16().
+ */
+esp_err_t fft_real_sc16(int16_t * data, int n);
+
+#endif //_FFT_REAL_H_
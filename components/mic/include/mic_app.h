@@ -4,9 +4,32 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "mic_driver.h"
+
+// vMic checks for a new audio configuration at least this often
+#ifndef MIC_CONFIG_POLL_MS
+#define MIC_CONFIG_POLL_MS      100
+#endif
 
 extern SemaphoreHandle_t xMicDataStreamEnableMutex;
 
 void vMic( void *pvParameters );
+// Audio blocks dropped because a consumer was behind
+uint32_t mic_app_get_dropped();
+// Current AGC gain
+float mic_app_get_gain_db();
+
+/**
+ * @brief Request a new audio configuration.
+ *
+ * vMic reinstalls the I2S driver within MIC_CONFIG_POLL_MS and the FFT task
+ * resizes its frame, window and band tables on the next block. If the
+ * driver refuses the configuration the previous one is kept.
+ *
+ * @return ESP_ERR_INVALID_ARG if the configuration is out of range.
+ */
+esp_err_t mic_app_set_config(const audio_config_t * config);
+// Configuration currently running
+void mic_app_get_config(audio_config_t * config);
 
 #endif //_MIC_APP_H_
\ No newline at end of file
@@ -15,13 +15,45 @@
 
 #define I2S_READ_BUFFER_SIZE    (1024)
 #define I2S_AUDIO_BUFFER_SIZE    (I2S_READ_BUFFER_SIZE/4)
-#define I2S_SAMPLE_RATE         8000
-
-esp_err_t mic_init();
 
-esp_err_t mic_read_buffer(uint8_t * sample, size_t * bytes_read);
+// Boot configuration
+#define I2S_SAMPLE_RATE         8000
+#define I2S_DMA_BUF_LEN         1024
+#define I2S_DMA_BUF_COUNT       4
+
+// Limits accepted by mic_config_validate()
+#define I2S_SAMPLE_RATE_MIN     8000
+#define I2S_SAMPLE_RATE_MAX     48000
+#define I2S_DMA_BUF_LEN_MIN     8
+#define I2S_DMA_BUF_LEN_MAX     1024
+#define I2S_DMA_BUF_COUNT_MIN   2
+#define I2S_DMA_BUF_COUNT_MAX   32
+
+/* Audio capture and analysis configuration */
+typedef struct {
+    uint32_t sample_rate;       // Hz
+    uint16_t dma_buf_len;       // Samples per DMA block, one RX event each
+    uint8_t dma_buf_count;      // DMA blocks, latency is dma_buf_len * dma_buf_count samples
+    uint16_t fft_window;        // FFT length, power of two
+    uint16_t fft_hop;           // Samples between spectra
+} audio_config_t;
+
+esp_err_t mic_config_validate(const audio_config_t * config);
+
+/**
+ * @brief Install the I2S driver, xQueueI2S is created by the driver.
+ */
+esp_err_t mic_init(const audio_config_t * config);
+
+// Uninstall the I2S driver, xQueueI2S is no longer valid
+esp_err_t mic_deinit();
+
+/**
+ * @brief Read up to size bytes, blocking until they are received.
+ */
+esp_err_t mic_read_buffer(uint8_t * sample, size_t size, size_t * bytes_read);
 
 // i2s reader queue
 extern QueueHandle_t xQueueI2S;
 
-#endif //_MIC_DRIVER_H_
\ No newline at end of file
+#endif //_MIC_DRIVER_H_
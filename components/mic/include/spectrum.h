@@ -0,0 +1,60 @@
+#ifndef _SPECTRUM_H_
+#define _SPECTRUM_H_
+
+#include <stdint.h>
+#include <esp_err.h>
+#include "fft_real.h"
+#include "stft.h"
+
+/**
+ * Windowed power spectrum of an STFT frame.
+ *
+ * Frames are Hann windowed, transformed with the real FFT and reduced to
+ * linear power per bin, |X[k]|^2 / N, for bins 0..N/2-1. Bin 0 holds DC
+ * only, the Nyquist bin is dropped.
+ *
+ * AUDIO_FFT_FIXED_POINT picks the path that is built: the float one, or an
+ * integer one with a Q31 window and a Q15 FFT whose output is rescaled to
+ * the units of the float path. Only the functions of that path exist. The
+ * esp-dsp FFT of the chosen path must be initialized for at least N/2
+ * points.
+ */
+
+#define SPECTRUM_MAX_WINDOW     STFT_MAX_WINDOW
+
+// AGC output full scale is 2^26, the Q15 path keeps the top 16 bits
+#define SPECTRUM_Q15_SHIFT      11
+
+/**
+ * @brief Build the Q31 window and the Q15 FFT tables.
+ *
+ * @param window Frame length, power of two up to SPECTRUM_MAX_WINDOW.
+ */
+esp_err_t spectrum_init_q15(int window);
+
+/**
+ * @brief Power spectrum through the integer path.
+ *
+ * @param frame window samples, AGC output scale.
+ * @param window Value given to spectrum_init_q15().
+ * @return window/2 bins, valid until the next call.
+ */
+const float * spectrum_power_q15(const int32_t * frame, int window);
+
+/**
+ * @brief Build the float window and the FFT tables.
+ *
+ * @param window Frame length, power of two up to SPECTRUM_MAX_WINDOW.
+ */
+esp_err_t spectrum_init_f32(int window);
+
+/**
+ * @brief Power spectrum through the float path.
+ *
+ * @param frame window samples, AGC output scale.
+ * @param window Value given to spectrum_init_f32().
+ * @return window/2 bins, valid until the next call.
+ */
+const float * spectrum_power_f32(const int32_t * frame, int window);
+
+#endif //_SPECTRUM_H_
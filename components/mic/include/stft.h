@@ -0,0 +1,55 @@
+#ifndef _STFT_H_
+#define _STFT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+/**
+ * Short-time Fourier transform framing.
+ *
+ * Mic samples go into a ring buffer that holds the last window of samples.
+ * Every hop samples a new frame is ready. The ring is mirrored (each sample
+ * is stored twice, window samples apart) so the current window is always
+ * contiguous in memory and can be handed out as a pointer.
+ */
+
+#define STFT_MAX_WINDOW         1024
+
+#ifndef STFT_WINDOW_SIZE
+#define STFT_WINDOW_SIZE        512
+#endif
+
+#ifndef STFT_HOP_SIZE
+#define STFT_HOP_SIZE           64
+#endif
+
+/**
+ * @brief Set the frame geometry and clear the ring.
+ *
+ * @param window Frame length, power of two up to STFT_MAX_WINDOW.
+ * @param hop Samples between frames, 1 to window.
+ */
+esp_err_t stft_init(size_t window, size_t hop);
+
+/**
+ * @brief Add samples to the ring, stopping at the next frame boundary.
+ *
+ * @return Number of samples consumed. Call again with the remainder once
+ *         the ready frame has been processed.
+ */
+size_t stft_push(const int32_t * samples, size_t len);
+
+/**
+ * @brief Check for a new frame, clearing the ready flag.
+ *
+ * @return Oldest sample first, window samples long, or NULL if no frame is
+ *         ready. Valid until the next stft_push().
+ */
+const int32_t * stft_get_frame();
+
+size_t stft_get_window();
+size_t stft_get_hop();
+
+#endif //_STFT_H_
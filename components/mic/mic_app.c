@@ -1,118 +1,227 @@
 #include "mic_app.h"
 #include "mic_driver.h"
+#include "audio_pool.h"
+#include "agc.h"
+#include "spectrum.h"
+#include "stft.h"
+#include "bands.h"
+#include "fast_log.h"
 #include "uart_app.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "string.h"
 #include "esp_dsp.h"
 #include <math.h>
 #include "common.h"
+#include "app_mailbox.h"
 
 //******************************************************************************************************************
 
 TaskHandle_t xTaskFFTHandle;
 
-// Queue to send sound data to FFT
+// Queue to send audio blocks to FFT
 static QueueHandle_t xQueueAudioData;
 
+// Blocks dropped because no block was free or a consumer queue was full
+static uint32_t audio_dropped = 0;
+
+// Active configuration, the generation changes every time vMic applies a new one
+static audio_config_t audio_config = {
+    .sample_rate = I2S_SAMPLE_RATE,
+    .dma_buf_len = I2S_DMA_BUF_LEN,
+    .dma_buf_count = I2S_DMA_BUF_COUNT,
+    .fft_window = STFT_WINDOW_SIZE,
+    .fft_hop = STFT_HOP_SIZE,
+};
+static uint32_t audio_config_gen = 0;
+// Requested by mic_app_set_config(), applied by vMic
+static audio_config_t audio_config_pending;
+static bool audio_config_requested = false;
+static portMUX_TYPE audio_config_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//******************************************************************************************************************
+
+esp_err_t mic_app_set_config(const audio_config_t * config) {
+    esp_err_t err = mic_config_validate(config);
+    if(err != ESP_OK) {
+        return err;
+    }
+
+    portENTER_CRITICAL(&audio_config_lock);
+    audio_config_pending = *config;
+    audio_config_requested = true;
+    portEXIT_CRITICAL(&audio_config_lock);
+    return ESP_OK;
+}
+
+void mic_app_get_config(audio_config_t * config) {
+    if(!config) return;
+
+    portENTER_CRITICAL(&audio_config_lock);
+    *config = audio_config;
+    portEXIT_CRITICAL(&audio_config_lock);
+}
+
+// Copy the active configuration if its generation differs from gen
+static bool audio_config_changed(uint32_t * gen, audio_config_t * config) {
+    bool changed = false;
+
+    portENTER_CRITICAL(&audio_config_lock);
+    if(*gen != audio_config_gen) {
+        *gen = audio_config_gen;
+        *config = audio_config;
+        changed = true;
+    }
+    portEXIT_CRITICAL(&audio_config_lock);
+    return changed;
+}
+
 //******************************************************************************************************************
 static const char *TAG_FFT = "FFT_TASK";
 
+// Sample rate the spectrum tables were built for
+static float fft_sample_rate = I2S_SAMPLE_RATE;
+
+// Band values go to the app every few frames, the rest only feed the stream
+#define FFT_APP_PUBLISH_DIVIDER     4
 
-typedef struct audio_data_s{
-    int32_t * data;
-    size_t len;
-} audio_data_t;
+static bands_result_t bands;
+
+static float power_to_db(float power) {
+    // Keep silent bands finite
+    if(power < 1e-10f) {
+        power = 1e-10f;
+    }
+    return fast_db10(power);
+}
+
+static void fft_publish(data_id_e id, float value) {
+    // A frame comes every hop, the controller picks up the newest one
+    app_mailbox_publish(id, value);
+}
+
+#if AUDIO_FFT_FIXED_POINT
+#define fft_init_window         spectrum_init_q15
+#define fft_power_spectrum      spectrum_power_q15
+#else
+#define fft_init_window         spectrum_init_f32
+#define fft_power_spectrum      spectrum_power_f32
+#endif
+
+static void fft_process_frame(const int32_t * frame) {
+    static uint8_t frame_count = 0;
+    const int window = stft_get_window();
+    // Linear power per bin, only published values are converted to dB
+    const float * y1_cf = fft_power_spectrum(frame, window);
+
+    bands_process(y1_cf, &bands);
+
+    // Calculate main freq, the peak is the same in linear scale
+    float max = 0;
+    int max_index = 0;
+    for (int i = 1 ; i < window/2 ; i++) { //ignore dc
+        if(max < y1_cf[i]) {
+            max = y1_cf[i];
+            max_index = i;
+        }
+    }
+    float main_freq = (fft_sample_rate / (float)window) * max_index;
+    // ESP_LOGI(TAG_FFT, "MAIN_FREQ: %2.2f - %2.2f", main_freq, power_to_db(max));
+
+    // Wait main application is ready to receive data
+    if(++frame_count >= FFT_APP_PUBLISH_DIVIDER) {
+        frame_count = 0;
+        if(xEventGroupGetBits(xEventGroupApp) & BIT_APP_SEND_DATA) {
+            // Bands carry the levels, the FFT control follows the pitch
+            fft_publish(DATA_ID_FFT, main_freq);
+            for(uint8_t b = 0; b < DATA_ID_BAND_COUNT && b < bands.band_count; b++) {
+                fft_publish(DATA_ID_BAND_0 + b, power_to_db(bands.band[b]));
+            }
+            fft_publish(DATA_ID_RMS, 2 * power_to_db(bands.rms));
+            fft_publish(DATA_ID_CENTROID, bands.centroid);
+            fft_publish(DATA_ID_FLUX, bands.flux);
+        }
+    }
+
+    // Send to FFT Stream
+    if(xEventGroupGetBits(xEventGroupDataStreamMode) & BIT_UART_STREAM(UART_STREAM_FFT)) {
+        static uart_fft_data_t stream_data;
+        stream_data.len = 0;
+        stream_data.timestamp = (uint32_t)esp_timer_get_time();
+        for(uint8_t b = 0; b < bands.band_count && b < UART_FFT_MAX_BANDS; b++) {
+            stream_data.freq[b].name = bands_get_name(b);
+            stream_data.freq[b].value = power_to_db(bands.band[b]);
+            stream_data.len++;
+        }
+
+        uart_stream_send(UART_STREAM_FFT, &stream_data);
+    }
+
+    // ESP_LOGW(TAG_FFT, "Signal x1 in linear scale");
+    // dsps_view(y1_cf, window/2, 64, 10,  0, 1e12, '|');
+}
+
+// Size the frame, window and band tables for a configuration
+static esp_err_t fft_configure(const audio_config_t * config) {
+    esp_err_t err = stft_init(config->fft_window, config->fft_hop);
+    if (err  != ESP_OK) {
+        ESP_LOGE(TAG_FFT, "Invalid STFT geometry. Error = %i", err);
+        return err;
+    }
+    err = fft_init_window(config->fft_window);
+    if (err  != ESP_OK) {
+        ESP_LOGE(TAG_FFT, "Not possible to initialize real FFT. Error = %i", err);
+        return err;
+    }
+    err = bands_init(BANDS_MODE, config->sample_rate, config->fft_window);
+    if (err  != ESP_OK) {
+        ESP_LOGE(TAG_FFT, "Not possible to initialize bands. Error = %i", err);
+        return err;
+    }
+    fft_sample_rate = config->sample_rate;
+    return ESP_OK;
+}
 
 void vTaskFFT(void *pvParameters) {
     esp_err_t err = ESP_OK;
-    float wind[I2S_AUDIO_BUFFER_SIZE];
-    float y_cf[I2S_AUDIO_BUFFER_SIZE*2];
-    // Pointers to result arrays
-    float* y1_cf = &y_cf[0];
-    float* y2_cf = &y_cf[I2S_AUDIO_BUFFER_SIZE];
 
+    // Sized for the largest window a configuration can ask for
+#if AUDIO_FFT_FIXED_POINT
+    err = dsps_fft2r_init_sc16(NULL, CONFIG_DSP_MAX_FFT_SIZE);
+#else
     err = dsps_fft2r_init_fc32(NULL, CONFIG_DSP_MAX_FFT_SIZE);
+#endif
     if (err  != ESP_OK) {
         ESP_LOGE(TAG_FFT, "Not possible to initialize FFT. Error = %i", err);
         return;
     }
-    // Generate Hann window
-    dsps_wind_hann_f32(wind, I2S_AUDIO_BUFFER_SIZE);
+    audio_config_t config;
+    uint32_t config_gen = 0;
+    mic_app_get_config(&config);
+    if (fft_configure(&config) != ESP_OK) {
+        return;
+    }
 
-    audio_data_t audio;
+    audio_block_t * audio = NULL;
     while(1) {
         if (xQueueReceive(xQueueAudioData, (void*)&audio, portMAX_DELAY) == pdPASS){
-            for (int i=0 ; i<I2S_AUDIO_BUFFER_SIZE ; i++)
-            {
-                y_cf[i*2 + 0] = (float)audio.data[i] * wind[i];
-                y_cf[i*2 + 1] = 0;
-            }
-            dsps_fft2r_fc32(y_cf, I2S_AUDIO_BUFFER_SIZE);
-
-            // Bit Reverse
-            dsps_bit_rev_fc32(y_cf, I2S_AUDIO_BUFFER_SIZE);
-
-            // Convert one complex vector to two complex vectors
-            dsps_cplx2reC_fc32(y_cf, I2S_AUDIO_BUFFER_SIZE);
-
-            // y1_cf - is your result in log scale
-            // y2_cf - magnitude of your signal in linear scale
-
-            for (int i = 0 ; i < I2S_AUDIO_BUFFER_SIZE/2 ; i++) {
-                y1_cf[i] = 10 * log10f((y1_cf[i * 2 + 0] * y1_cf[i * 2 + 0] + y1_cf[i * 2 + 1] * y1_cf[i * 2 + 1])/I2S_AUDIO_BUFFER_SIZE);
-                // y2_cf[i] = ((y1_cf[i * 2 + 0] * y1_cf[i * 2 + 0] + y1_cf[i * 2 + 1] * y1_cf[i * 2 + 1])/I2S_AUDIO_BUFFER_SIZE);
-
-                // ESP_LOGW(TAG_FFT, "Signal %d in log scale: %.2f", i, y1_cf[i]);
-                // ESP_LOGW(TAG_FFT, "Signal %d in absolute scale: %.2f", i, y2_cf[i]);
+            if(audio_config_changed(&config_gen, &config)) {
+                // Tables can't fail for a validated configuration
+                ESP_ERROR_CHECK(fft_configure(&config));
             }
 
-            // Calculate main freq
-            float max = 0;
-            int max_index = 0;
-            for (int i = 1 ; i < I2S_AUDIO_BUFFER_SIZE/2 ; i++) { //ignore dc
-                if(max < y1_cf[i]) {
-                    max = y1_cf[i];
-                    max_index = i;
-                }
-            }
-            float main_freq = ((float)I2S_SAMPLE_RATE / (float)I2S_AUDIO_BUFFER_SIZE) * max_index;
-            // ESP_LOGI(TAG_FFT, "MAIN_FREQ: %2.2f - %2.2f | 31.5Hz: %2.2f | 63Hz: %2.2f | 94,5Hz: %2.2f | 126Hz: %2.2f | 257,5Hz: %2.2f ", main_freq, max, y1_cf[1], y1_cf[2], y1_cf[3], y1_cf[4], y1_cf[5]  );
-
-            // Send to App
-            app_data_t fft_data = {
-                .id = DATA_ID_FFT,
-                .data = y1_cf[1],
-            };
-
-            // Wait main application is ready to receive data
-            if(xEventGroupGetBits(xEventGroupApp) & BIT_APP_SEND_DATA) {
-                // send to app queue
-                if (xQueueSend( xQueueAppData, (void *)&fft_data, portMAX_DELAY ) == pdFAIL) {
-                    ESP_LOGE(TAG_FFT, "ERROR sendig FFT data to APP queue");
-                }
-            }
+            // One spectrum every hop samples, over the last window samples
+            size_t offset = 0;
+            while(offset < audio->len) {
+                offset += stft_push(&audio->samples[offset], audio->len - offset);
 
-            // Send to FFT Stream
-            if(xEventGroupGetBits(xEventGroupDataStreamMode) & BIT_UART_STREAM_MODE_FFT) {
-                freq_t freq_info[5] = {{.name="31.5", .value=y1_cf[1]},
-                                        {.name="63", .value=y1_cf[2]},
-                                        {.name="94,5", .value=y1_cf[3]},
-                                        {.name="126", .value=y1_cf[4]},
-                                        {.name="257,5", .value=y1_cf[5]}};
-                uart_fft_data_t stream_data = {
-                    .freq = freq_info,
-                    .len = 5
-                };
-
-                if (xQueueSend( xQueueUartStreamFFTBuffer, (void *)&stream_data, portMAX_DELAY ) == pdFAIL) {
-                    ESP_LOGE(TAG_FFT, "ERROR sendig FFT data to queue");
+                const int32_t * frame = stft_get_frame();
+                if(frame) {
+                    fft_process_frame(frame);
                 }
             }
-
-            // ESP_LOGW(TAG_FFT, "Signal x1 in log scale");
-            // dsps_view(y1_cf, I2S_AUDIO_BUFFER_SIZE/2, 64, 30,  -60, 120, '|');
-            // ESP_LOGW(TAG_FFT, "Signal x1 in absolute scale");
-            // dsps_view(y2_cf, I2S_AUDIO_BUFFER_SIZE/2,64, 10,  -60, 80, '|');
+            // Samples are in the STFT ring, block can be reused
+            audio_pool_release(audio);
         }
     }
 }
@@ -121,14 +230,79 @@ void vTaskFFT(void *pvParameters) {
 
 static const char *TAG = "MIC_TASK";
 
+static agc_t agc;
+
+// Called by the stream once it is done with a block
+static void mic_stream_release(void * ctx) {
+    audio_pool_release((audio_block_t *)ctx);
+}
+
+uint32_t mic_app_get_dropped() {
+    return audio_dropped;
+}
+
+float mic_app_get_gain_db() {
+    return agc_get_gain_db(&agc);
+}
+
+// Reinstall the I2S driver if a new configuration was requested
+static void mic_apply_config() {
+    audio_config_t config;
+    bool requested;
+
+    portENTER_CRITICAL(&audio_config_lock);
+    requested = audio_config_requested;
+    audio_config_requested = false;
+    config = audio_config_pending;
+    portEXIT_CRITICAL(&audio_config_lock);
+
+    if(!requested) return;
+
+    ESP_ERROR_CHECK(mic_deinit());
+    esp_err_t err = mic_init(&config);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "ERROR Applying audio config: %s", esp_err_to_name(err));
+        // Back to the configuration that was running
+        mic_app_get_config(&config);
+        ESP_ERROR_CHECK(mic_init(&config));
+        return;
+    }
+
+    agc_config_t agc_config = agc.config;
+    ESP_ERROR_CHECK(agc_init(&agc, &agc_config, config.sample_rate));
+
+    // The FFT task rebuilds its tables on the next block
+    portENTER_CRITICAL(&audio_config_lock);
+    audio_config = config;
+    audio_config_gen++;
+    portEXIT_CRITICAL(&audio_config_lock);
+
+    ESP_LOGI(TAG, "Audio config: %u Hz, %u x %u samples DMA, FFT %u / %u", (unsigned)config.sample_rate,
+            (unsigned)config.dma_buf_count, (unsigned)config.dma_buf_len, (unsigned)config.fft_window, (unsigned)config.fft_hop);
+}
+
 void vMic( void *pvParameters ) {
-    if(mic_init() != ESP_OK) {
+    audio_config_t config;
+    mic_app_get_config(&config);
+    if(mic_init(&config) != ESP_OK) {
         ESP_LOGE(TAG, "ERROR Initializing Mic Driver");
         return;
     }
 
+    if(audio_pool_init() != ESP_OK) {
+        ESP_LOGE(TAG, "ERROR Initializing Audio Pool");
+        return;
+    }
+
+    agc_config_t agc_config;
+    agc_get_default_config(&agc_config);
+    if(agc_init(&agc, &agc_config, config.sample_rate) != ESP_OK) {
+        ESP_LOGE(TAG, "ERROR Initializing AGC");
+        return;
+    }
+
     // Create FFT task
-    xQueueAudioData = xQueueCreate(2, sizeof(audio_data_t));
+    xQueueAudioData = xQueueCreate(AUDIO_POOL_BLOCKS, sizeof(audio_block_t *));
 
     xTaskCreatePinnedToCore(vTaskFFT,
                             "vTaskFFT",
@@ -139,21 +313,18 @@ void vMic( void *pvParameters ) {
                             APP_CPU_NUM
                             );
 
-
-    // FFT Stream Var
-    audio_data_t audio_data = {
-        .data = NULL
-    };
+    // Used to keep the I2S DMA drained when every block is in use
+    static uint8_t discard_buffer[AUDIO_BLOCK_SAMPLES * sizeof(int32_t)];
 
     // UART Stream Var
-    uint8_t sample_buffer[I2S_READ_BUFFER_SIZE] = {0};
     uart_mic_data_t stream_data = {
         .data = NULL,
         .len = 0,
-        .id = UART_DATA_ID_MIC
+        .id = UART_DATA_ID_MIC,
+        .release = mic_stream_release,
     };
     i2s_event_t evt;
-    size_t bytes_read;
+    size_t bytes_read = 0;
 
     // Wait for dependent tasks
     xEventGroupWaitBits(xEventGroupTasks,
@@ -167,40 +338,61 @@ void vMic( void *pvParameters ) {
     ESP_LOGI(TAG, "Mic Initialized");
 
     while(1) {
-        // Wait for I2S event
-        if (xQueueReceive(xQueueI2S, &evt, portMAX_DELAY) == pdPASS)
+        // Wait for I2S event, waking up now and then to pick up a new configuration
+        if (xQueueReceive(xQueueI2S, &evt, pdMS_TO_TICKS(MIC_CONFIG_POLL_MS)) == pdPASS)
         {
             if (evt.type == I2S_EVENT_RX_DONE) {
-                do {
-                    ESP_ERROR_CHECK(mic_read_buffer(sample_buffer, &bytes_read));
-                    // Proccess data
-                    int32_t *samples_32 = (int32_t *)sample_buffer;
-
-                    for (int i = 0; i < bytes_read/4; i++) {
-                        // you may need to vary the >> 11 to fit your volume - ideally we'd have some kind of AGC here
-                        samples_32[i] = samples_32[i]>>5;
+                // One DMA block is ready, read it in pool block sized chunks
+                size_t remaining = config.dma_buf_len * sizeof(int32_t);
+                while(remaining > 0) {
+                    size_t size = remaining < sizeof(discard_buffer) ? remaining : sizeof(discard_buffer);
+
+                    audio_block_t * block = audio_pool_get(0);
+                    if(block == NULL) {
+                        // Consumers are behind, drop this buffer
+                        ESP_ERROR_CHECK(mic_read_buffer(discard_buffer, size, &bytes_read));
+                        remaining -= bytes_read;
+                        audio_dropped++;
+                        continue;
                     }
 
-                    // Send to FFT
-                    audio_data.data = samples_32;
-                    stream_data.len = bytes_read/4;
+                    // I2S data is read straight into the pool block, from here on only the pointer moves
+                    ESP_ERROR_CHECK(mic_read_buffer((uint8_t *)block->samples, size, &bytes_read));
+                    uint32_t block_time = (uint32_t)esp_timer_get_time();
+                    remaining -= bytes_read;
+                    block->len = bytes_read/4;
+
+                    // Proccess data, the AGC scales the raw samples to the stream and FFT range
+                    agc_process(&agc, block->samples, block->len);
 
-                    if (xQueueSend( xQueueAudioData, (void *)&audio_data, portMAX_DELAY ) == pdFAIL) {
-                        ESP_LOGE(TAG, "ERROR sending audio data to FFT");
+                    // Send to FFT, one reference per consumer
+                    audio_pool_retain(block);
+                    if (xQueueSend( xQueueAudioData, (void *)&block, 0 ) == pdFAIL) {
+                        audio_pool_release(block);
+                        audio_dropped++;
                     }
 
                     // Send to Data Stream if enabled
-                    if(xEventGroupGetBits(xEventGroupDataStreamMode) & BIT_UART_STREAM_MODE_MIC) {
-                        stream_data.data = samples_32;
-                        stream_data.len = bytes_read/4;
-                        if (xQueueSend( xQueueUartStreamMicBuffer, (void *)&stream_data, portMAX_DELAY ) == pdFAIL) {
-                            ESP_LOGE(TAG, "ERROR sendig mic data to queue");
+                    if(xEventGroupGetBits(xEventGroupDataStreamMode) & BIT_UART_STREAM(UART_STREAM_MIC)) {
+                        audio_pool_retain(block);
+                        stream_data.data = block->samples;
+                        stream_data.len = block->len;
+                        stream_data.ctx = block;
+                        stream_data.timestamp = block_time;
+                        // The stream owns this reference now, it releases it if the block is dropped
+                        if (uart_stream_send(UART_STREAM_MIC, &stream_data) != ESP_OK) {
+                            audio_dropped++;
                         }
                     }
-                }while(bytes_read > 0);
+
+                    // Drop the producer reference
+                    audio_pool_release(block);
+                }
             }
         }
 
+        mic_apply_config();
+        mic_app_get_config(&config);
     }
 
 }
@@ -1,18 +1,46 @@
 #include "mic_driver.h"
+#include "stft.h"
 
 QueueHandle_t xQueueI2S;
 
-esp_err_t mic_init() {
+esp_err_t mic_config_validate(const audio_config_t * config) {
+    if(config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(config->sample_rate < I2S_SAMPLE_RATE_MIN || config->sample_rate > I2S_SAMPLE_RATE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(config->dma_buf_len < I2S_DMA_BUF_LEN_MIN || config->dma_buf_len > I2S_DMA_BUF_LEN_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(config->dma_buf_count < I2S_DMA_BUF_COUNT_MIN || config->dma_buf_count > I2S_DMA_BUF_COUNT_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Same rules as stft_init()
+    if(config->fft_window < 4 || config->fft_window > STFT_MAX_WINDOW || (config->fft_window & (config->fft_window - 1))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(config->fft_hop == 0 || config->fft_hop > config->fft_window) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t mic_init(const audio_config_t * config) {
+    esp_err_t err = mic_config_validate(config);
+    if(err != ESP_OK) {
+        return err;
+    }
 
     const i2s_config_t i2s_config = {
         .mode = I2S_MODE_MASTER | I2S_MODE_RX,
-        .sample_rate = I2S_SAMPLE_RATE,
+        .sample_rate = config->sample_rate,
         .bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT,
         .channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT,
         .communication_format = I2S_COMM_FORMAT_I2S | I2S_COMM_FORMAT_I2S_MSB,
         .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1, // default interrupt priority
-        .dma_buf_count = 4,
-        .dma_buf_len = I2S_READ_BUFFER_SIZE,
+        .dma_buf_count = config->dma_buf_count,
+        .dma_buf_len = config->dma_buf_len,
         .use_apll = false,
         .tx_desc_auto_clear = false,
         .fixed_mclk = 0
@@ -25,14 +53,26 @@ esp_err_t mic_init() {
         .data_in_num = I2S_SD
     };
 
-    ESP_ERROR_CHECK(i2s_driver_install(I2S_PORT, &i2s_config, 4, &xQueueI2S));
-    ESP_ERROR_CHECK(i2s_set_pin(I2S_PORT, &pin_config));
-    return ESP_OK;
+    // One event per DMA block, the queue can hold them all
+    err = i2s_driver_install(I2S_PORT, &i2s_config, config->dma_buf_count, &xQueueI2S);
+    if(err != ESP_OK) {
+        return err;
+    }
+    err = i2s_set_pin(I2S_PORT, &pin_config);
+    if(err != ESP_OK) {
+        i2s_driver_uninstall(I2S_PORT);
+    }
+    return err;
+}
+
+esp_err_t mic_deinit() {
+    xQueueI2S = NULL;
+    return i2s_driver_uninstall(I2S_PORT);
 }
 
-esp_err_t mic_read_buffer(uint8_t * sample, size_t * bytes_read) {
+esp_err_t mic_read_buffer(uint8_t * sample, size_t size, size_t * bytes_read) {
     if(sample == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
-    return i2s_read(I2S_PORT, (void*)sample, I2S_READ_BUFFER_SIZE, bytes_read, portMAX_DELAY);
+    return i2s_read(I2S_PORT, (void*)sample, size, bytes_read, portMAX_DELAY);
 }
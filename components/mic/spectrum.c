@@ -0,0 +1,76 @@
+#include "spectrum.h"
+#include "esp_dsp.h"
+#include <math.h>
+
+//******************************************************************************************************************
+
+#if AUDIO_FFT_FIXED_POINT
+static int32_t wind_q31[SPECTRUM_MAX_WINDOW];
+// Real Q15 samples in, N/2 complex Q15 bins out
+static int16_t y_sc[SPECTRUM_MAX_WINDOW];
+static float y_power[SPECTRUM_MAX_WINDOW / 2];
+
+esp_err_t spectrum_init_q15(int window) {
+    if(window < 4 || window > SPECTRUM_MAX_WINDOW) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Hann window, same definition as dsps_wind_hann_f32()
+    for(int i = 0; i < window; i++) {
+        double w = 0.5 - 0.5 * cos(2 * M_PI * i / (window - 1));
+        wind_q31[i] = (int32_t)(w * INT32_MAX);
+    }
+    return fft_real_init_sc16(window);
+}
+
+const float * spectrum_power_q15(const int32_t * frame, int window) {
+    for(int i = 0; i < window; i++) {
+        int32_t sample = (int32_t)(((int64_t)frame[i] * wind_q31[i]) >> (31 + SPECTRUM_Q15_SHIFT));
+        if(sample > INT16_MAX) sample = INT16_MAX;
+        if(sample < INT16_MIN) sample = INT16_MIN;
+        y_sc[i] = (int16_t)sample;
+    }
+
+    fft_real_sc16(y_sc, window);
+    // Bin 0 holds DC and Nyquist, keep DC only
+    y_sc[1] = 0;
+
+    // Bins come out as X / N in Q15 units: |X|^2 / N = |Xq|^2 * N * 2^(2 * shift)
+    const float scale = (float)window * (float)(1 << (2 * SPECTRUM_Q15_SHIFT));
+    for(int i = 0; i < window / 2; i++) {
+        int32_t re = y_sc[i * 2 + 0];
+        int32_t im = y_sc[i * 2 + 1];
+        y_power[i] = (float)((uint32_t)(re * re) + (uint32_t)(im * im)) * scale;
+    }
+    return y_power;
+}
+
+#else
+static float wind[SPECTRUM_MAX_WINDOW];
+// Real samples in, N/2 complex bins out, then the power in place
+static float y_cf[SPECTRUM_MAX_WINDOW];
+
+esp_err_t spectrum_init_f32(int window) {
+    if(window < 4 || window > SPECTRUM_MAX_WINDOW) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    dsps_wind_hann_f32(wind, window);
+    return fft_real_init_fc32(window);
+}
+
+const float * spectrum_power_f32(const int32_t * frame, int window) {
+    for(int i = 0; i < window; i++) {
+        y_cf[i] = (float)frame[i] * wind[i];
+    }
+
+    fft_real_fc32(y_cf, window);
+    // Bin 0 holds DC and Nyquist, keep DC only
+    y_cf[1] = 0;
+
+    for(int i = 0; i < window / 2; i++) {
+        y_cf[i] = (y_cf[i * 2 + 0] * y_cf[i * 2 + 0] + y_cf[i * 2 + 1] * y_cf[i * 2 + 1]) / window;
+    }
+    return y_cf;
+}
+#endif
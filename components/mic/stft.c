@@ -0,0 +1,84 @@
+#include "stft.h"
+#include <string.h>
+
+//******************************************************************************************************************
+
+// Mirrored ring: ring[i] == ring[i + window]
+static int32_t ring[STFT_MAX_WINDOW * 2];
+
+static size_t window_len = STFT_WINDOW_SIZE;
+static size_t hop_len = STFT_HOP_SIZE;
+static size_t write_pos = 0;        // Next write position, also the oldest sample
+static size_t filled = 0;           // Samples in the ring, up to window_len
+static size_t since_frame = 0;      // Samples pushed since the last frame
+static bool frame_ready = false;
+
+//******************************************************************************************************************
+
+esp_err_t stft_init(size_t window, size_t hop) {
+    if(window == 0 || window > STFT_MAX_WINDOW || (window & (window - 1)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(hop == 0 || hop > window) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    window_len = window;
+    hop_len = hop;
+    write_pos = 0;
+    filled = 0;
+    since_frame = 0;
+    frame_ready = false;
+    memset(ring, 0, sizeof(ring));
+
+    return ESP_OK;
+}
+
+size_t stft_push(const int32_t * samples, size_t len) {
+    if(samples == NULL) return 0;
+
+    size_t count = hop_len - since_frame;
+    if(count > len) {
+        count = len;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        ring[write_pos] = samples[i];
+        ring[write_pos + window_len] = samples[i];
+        write_pos++;
+        if(write_pos == window_len) {
+            write_pos = 0;
+        }
+    }
+
+    filled += count;
+    if(filled > window_len) {
+        filled = window_len;
+    }
+    since_frame += count;
+
+    if(since_frame == hop_len) {
+        since_frame = 0;
+        // First frame only once a whole window has been captured
+        frame_ready = (filled == window_len);
+    }
+
+    return count;
+}
+
+const int32_t * stft_get_frame() {
+    if(!frame_ready) {
+        return NULL;
+    }
+    frame_ready = false;
+
+    return &ring[write_pos];
+}
+
+size_t stft_get_window() {
+    return window_len;
+}
+
+size_t stft_get_hop() {
+    return hop_len;
+}
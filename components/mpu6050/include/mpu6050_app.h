@@ -5,8 +5,21 @@
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 
+#define MPU6050_ACQ_MODE_POLL       0   // Read data registers every MPU_6050_TASK_PERIOD_MS
+#define MPU6050_ACQ_MODE_FIFO       1   // Fixed ODR into the on-chip FIFO, drained in batches
+
+#ifndef MPU6050_ACQ_MODE
+#define MPU6050_ACQ_MODE            MPU6050_ACQ_MODE_FIFO
+#endif
+
 #define MPU_6050_TASK_PERIOD_MS     200
 
+// FIFO mode: 14 byte frames at 500 Hz fit a 100 kHz bus
+#define MPU6050_ODR_HZ              500
+#define MPU6050_FIFO_BATCH          10
+// Drain anyway if the data ready interrupt doesn't show up
+#define MPU6050_FIFO_TIMEOUT_MS     (2 * 1000 * MPU6050_FIFO_BATCH / MPU6050_ODR_HZ)
+
 extern SemaphoreHandle_t xMPU6050DataMutex;
 
 typedef struct {
@@ -4,12 +4,17 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <esp_err.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/gpio.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define MPU6050_SLAVE_ADDR          0x68
+#define MPU6050_MAX_CLK_HZ          400000  // I2C fast mode
 
 #define MPU6050_ACCEL_XOUT_H        0x3B
 #define MPU6050_ACCEL_XOUT_L        0x3C
@@ -30,6 +35,34 @@ extern "C" {
 #define MPU6050_GYRO_CONFIG         0x1B
 #define MPU6050_SMPLRT_DIV          0x19
 #define MPU6050_CONFIG              0x1A
+#define MPU6050_FIFO_EN             0x23
+#define MPU6050_INT_PIN_CFG         0x37
+#define MPU6050_INT_ENABLE          0x38
+#define MPU6050_INT_STATUS          0x3A
+#define MPU6050_USER_CTRL           0x6A
+#define MPU6050_FIFO_COUNTH         0x72
+#define MPU6050_FIFO_COUNTL         0x73
+#define MPU6050_FIFO_R_W            0x74
+
+// FIFO_EN: temperature, gyro X/Y/Z and accel, stored in register order
+#define FIFO_EN_TEMP_GYRO_ACCEL     0xF8
+// INT_ENABLE
+#define INT_DATA_RDY_EN             0x01
+// USER_CTRL
+#define USER_CTRL_FIFO_EN           0x40
+#define USER_CTRL_FIFO_RESET        0x04
+// CONFIG: DLPF 188 Hz, gyro output rate 1 kHz
+#define DLPF_CFG_188HZ              0x01
+#define MPU6050_GYRO_RATE_HZ        1000
+// SMPLRT_DIV is 8 bits, the divider goes up to 256
+#define MPU6050_ODR_MIN_HZ          ((MPU6050_GYRO_RATE_HZ + 255) / 256)
+
+#define MPU6050_FIFO_SIZE           1024
+
+// Data ready interrupt pin
+#ifndef MPU6050_INT_PIN
+#define MPU6050_INT_PIN             GPIO_NUM_23
+#endif
 
 #define _2G_SCALE               0x00
 #define _4G_SCALE               0x08
@@ -63,11 +96,35 @@ typedef struct {
     double z;
 } mpu6050_gyr_data_t;
 
+// ACCEL_XOUT_H..GYRO_ZOUT_L, read in a single burst
+#define MPU6050_FRAME_SIZE          14
 
-
-
+typedef struct {
+    mpu6050_accel_data_t accel;
+    mpu6050_gyr_data_t gyr;
+    double temperature;
+} mpu6050_frame_t;
 
 esp_err_t mpu6050_init();
+esp_err_t mpu6050_read_frame(mpu6050_frame_t * frame);
+void mpu6050_decode_frame(const uint8_t * raw, mpu6050_frame_t * frame);
+/**
+ * @brief Set a fixed output data rate and stream samples into the on-chip FIFO.
+ *
+ * The data ready interrupt is routed to MPU6050_INT_PIN. Every batch_size
+ * samples the given binary semaphore is given. A semaphore rather than a
+ * task notification, so the signal survives the I2C completion waits of
+ * the draining task.
+ *
+ * @param odr_hz Output data rate, 4 Hz to 1 kHz.
+ * @param batch_size Samples per signal.
+ * @param ready Binary semaphore given once a batch is waiting.
+ */
+esp_err_t mpu6050_fifo_init(uint16_t odr_hz, uint8_t batch_size, SemaphoreHandle_t ready);
+esp_err_t mpu6050_fifo_reset();
+esp_err_t mpu6050_fifo_count(uint16_t * count);
+// len is limited to 255 bytes by a single I2C request
+esp_err_t mpu6050_fifo_read(uint8_t len, uint8_t * data);
 esp_err_t mpu6050_read_accel(mpu6050_accel_data_t * data);
 esp_err_t mpu6050_read_gyr(mpu6050_gyr_data_t * data);
 esp_err_t mpu6050_read_temp(double * data);
@@ -3,7 +3,9 @@
 #include "mpu6050_driver.h"
 #include "uart_app.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "common.h"
+#include "app_mailbox.h"
 #include <string.h>
 
 //****************************************************************************************************************
@@ -26,83 +28,26 @@ static double gyr_error_z = 0;
 //****************************************************************************************************************
 
 static void mpu6050_data_stream() {
-    uart_data_t uart_data_accel_x = {
-        .id = UART_DATA_ID_ACCEL_X,
-        .data = mpu6050_data.accel_x
+    uart_values_t uart_data_imu = {
+        .value = {
+            mpu6050_data.accel_x,
+            mpu6050_data.accel_y,
+            mpu6050_data.accel_z,
+            mpu6050_data.gyr_x,
+            mpu6050_data.gyr_y,
+            mpu6050_data.gyr_z,
+        },
+        .len = 6,
+        .timestamp = (uint32_t)esp_timer_get_time(),
     };
-    if (xQueueSend( xQueueUartWriteBuffer, (void *)&uart_data_accel_x, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "ERROR sendig data to queue");
-        return;
-    }
-
-    uart_data_t uart_data_accel_y = {
-        .id = UART_DATA_ID_ACCEL_Y,
-        .data = mpu6050_data.accel_y
-    };
-    if (xQueueSend( xQueueUartWriteBuffer, (void *)&uart_data_accel_y, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "ERROR sendig data to queue");
-        return;
-    }
-    uart_data_t uart_data_accel_z = {
-        .id = UART_DATA_ID_ACCEL_Z,
-        .data = mpu6050_data.accel_z
-    };
-    if (xQueueSend( xQueueUartWriteBuffer, (void *)&uart_data_accel_z, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "ERROR sendig data to queue");
-        return;
-    }
-    uart_data_t uart_data_gyr_x = {
-        .id = UART_DATA_ID_GYR_X,
-        .data = mpu6050_data.gyr_x
-    };
-    if (xQueueSend( xQueueUartWriteBuffer, (void *)&uart_data_gyr_x, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "ERROR sendig data to queue");
-        return;
-    }
-    uart_data_t uart_data_gyr_y = {
-        .id = UART_DATA_ID_GYR_Y,
-        .data = mpu6050_data.gyr_y
-    };
-    if (xQueueSend( xQueueUartWriteBuffer, (void *)&uart_data_gyr_y, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "ERROR sendig data to queue");
-        return;
-    }
-    uart_data_t uart_data_gyr_z = {
-        .id = UART_DATA_ID_GYR_Z,
-        .data = mpu6050_data.gyr_z
-    };
-    if (xQueueSend( xQueueUartWriteBuffer, (void *)&uart_data_gyr_z, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "ERROR sendig data to queue");
-        return;
-    }
-
+    uart_stream_send(UART_STREAM_IMU, &uart_data_imu);
 }
 
 esp_err_t mpu6050_send_data(mpu6050_angle_data_t real_angle) {
-    app_data_t data_roll = {
-        .id = DATA_ID_ROLL,
-        .data = real_angle.roll
-    };
-    if (xQueueSend( xQueueAppData, (void *)&data_roll, 0 ) == pdFAIL) {
-        ESP_LOGE(TAG, "ERROR sendig data to queue");
-        return ESP_ERR_TIMEOUT;
-    }
-    app_data_t data_pitch = {
-        .id = DATA_ID_PITCH,
-        .data = real_angle.pitch
-    };
-    if (xQueueSend( xQueueAppData, (void *)&data_pitch, 0 ) == pdFAIL) {
-        ESP_LOGE(TAG, "ERROR sendig data to queue");
-        return ESP_ERR_TIMEOUT;
-    }
-    app_data_t data_yaw = {
-        .id = DATA_ID_YAW,
-        .data = real_angle.yaw
-    };
-    if (xQueueSend( xQueueAppData, (void *)&data_yaw, 0 ) == pdFAIL) {
-        ESP_LOGE(TAG, "ERROR sendig data to queue");
-        return ESP_ERR_TIMEOUT;
-    }
+    // Only the newest angles matter, anything the controller has not sent yet is replaced
+    app_mailbox_publish(DATA_ID_ROLL, real_angle.roll);
+    app_mailbox_publish(DATA_ID_PITCH, real_angle.pitch);
+    app_mailbox_publish(DATA_ID_YAW, real_angle.yaw);
     return ESP_OK;
 }
 
@@ -112,16 +57,12 @@ static void mpu6050_calculate_angle_accel(mpu6050_accel_data_t * accel_data, mpu
     angle_data->pitch = (atan(-1 * accel_data->x / sqrt(pow(accel_data->y, 2) + pow(accel_data->z, 2))) * 180 / M_PI) - accel_error_y;
 }
 
-// Calculate Roll and Pitch from the gyroscope data
-static void mpu6050_calculate_angle_gyr(mpu6050_gyr_data_t * gyr_data, mpu6050_angle_data_t * angle_data) {
-    // Correct values
-    angle_data->roll -= gyr_error_x;
-    angle_data->pitch -= gyr_error_y;
-    angle_data->yaw -= gyr_error_z;
-
-    angle_data->roll = angle_data->roll + (gyr_data->x * MPU_6050_TASK_PERIOD_MS/1000);
-    angle_data->pitch = angle_data->pitch + (gyr_data->y * MPU_6050_TASK_PERIOD_MS/1000);
-    angle_data->yaw = angle_data->yaw + (gyr_data->z * MPU_6050_TASK_PERIOD_MS/1000);
+// Calculate Roll and Pitch from the gyroscope data, dt in seconds
+static void mpu6050_calculate_angle_gyr(mpu6050_gyr_data_t * gyr_data, mpu6050_angle_data_t * angle_data, double dt) {
+    // Correct rate offsets and integrate over the sample interval
+    angle_data->roll = angle_data->roll + ((gyr_data->x - gyr_error_x) * dt);
+    angle_data->pitch = angle_data->pitch + ((gyr_data->y - gyr_error_y) * dt);
+    angle_data->yaw = angle_data->yaw + ((gyr_data->z - gyr_error_z) * dt);
 }
 
 // Complementary filter - combine acceleromter and gyro angle values
@@ -133,6 +74,22 @@ static void mpu6050_calculate_angle(mpu6050_angle_data_t * gyr_angle, mpu6050_an
 
 }
 
+// Publish last sample and angles for the CLI
+static void mpu6050_update(mpu6050_frame_t * frame, mpu6050_angle_data_t * real_angle) {
+    if(xSemaphoreTake(xMPU6050DataMutex, portMAX_DELAY) == pdTRUE) {
+        mpu6050_data.accel_x = frame->accel.x;
+        mpu6050_data.accel_y = frame->accel.y;
+        mpu6050_data.accel_z = frame->accel.z;
+        mpu6050_data.gyr_x = frame->gyr.x;
+        mpu6050_data.gyr_y = frame->gyr.y;
+        mpu6050_data.gyr_z = frame->gyr.z;
+        mpu6050_data.temperature = frame->temperature;
+
+        mpu6050_angle_data = *real_angle;
+        xSemaphoreGive(xMPU6050DataMutex);
+    }
+}
+
 void vMPU6050Task( void *pvParameters ) {
     esp_err_t err = ESP_OK;
 
@@ -144,7 +101,7 @@ void vMPU6050Task( void *pvParameters ) {
 
     // Wait for I2C tasks
     xEventGroupWaitBits(xEventGroupTasks,
-                        BIT_TASK_I2C_READ | BIT_TASK_I2C_WRITE | BIT_TASK_DATA_STREAM,
+                        BIT_TASK_I2C | BIT_TASK_DATA_STREAM,
                         pdFALSE,
                         pdTRUE,
                         portMAX_DELAY);
@@ -160,45 +117,102 @@ void vMPU6050Task( void *pvParameters ) {
 	xEventGroupSetBits(xEventGroupTasks, BIT_TASK_MPU6050);
     ESP_LOGI(TAG, "MPU6050 Initialized");
 
-    mpu6050_gyr_data_t gyr_data = {0};
-    mpu6050_accel_data_t accel_data = {0};
     mpu6050_angle_data_t gyr_angle = {0};
     mpu6050_angle_data_t accel_angle = {0};
     mpu6050_angle_data_t real_angle = {0};
-    double temp_data;
+
+#if MPU6050_ACQ_MODE == MPU6050_ACQ_MODE_FIFO
+    // Whole frames only, a single request is limited to 255 bytes
+    static uint8_t fifo_buffer[(255 / MPU6050_FRAME_SIZE) * MPU6050_FRAME_SIZE];
+    const double dt = 1.0 / MPU6050_ODR_HZ;
+    mpu6050_frame_t frame = {0};
+    uint16_t fifo_count = 0;
+    // The I2C completion waits use the task notification, batches are signalled apart
+    static StaticSemaphore_t fifo_ready_buffer;
+    SemaphoreHandle_t fifo_ready = xSemaphoreCreateBinaryStatic(&fifo_ready_buffer);
+
+    ESP_ERROR_CHECK(mpu6050_fifo_init(MPU6050_ODR_HZ, MPU6050_FIFO_BATCH, fifo_ready));
+
     while(1) {
-        ESP_ERROR_CHECK(mpu6050_read_accel(&accel_data));
-        ESP_ERROR_CHECK(mpu6050_read_gyr(&gyr_data));
-        ESP_ERROR_CHECK(mpu6050_read_temp(&temp_data));
-        if(xSemaphoreTake(xMPU6050DataMutex, portMAX_DELAY) == pdTRUE) {
-            mpu6050_data.accel_x = accel_data.x;
-            mpu6050_data.accel_y = accel_data.y;
-            mpu6050_data.accel_z = accel_data.z;
-            mpu6050_data.gyr_x = gyr_data.x;
-            mpu6050_data.gyr_y = gyr_data.y;
-            mpu6050_data.gyr_z = gyr_data.z;
-            mpu6050_data.temperature = temp_data;
-
-            // Calculate angles
-            mpu6050_calculate_angle_accel(&accel_data, &accel_angle);
-            mpu6050_calculate_angle_gyr(&gyr_data, &gyr_angle);
-            mpu6050_calculate_angle(&gyr_angle, &accel_angle, &real_angle);
-
-            mpu6050_angle_data = real_angle;
-            xSemaphoreGive(xMPU6050DataMutex);
+        // A batch signalled during the previous drain is taken right away,
+        // every drain empties the FIFO so no sample is lost
+        xSemaphoreTake(fifo_ready, pdMS_TO_TICKS(MPU6050_FIFO_TIMEOUT_MS));
+
+        if(mpu6050_fifo_count(&fifo_count) != ESP_OK) {
+            continue;
+        }
+        // Frame alignment is lost once the FIFO overflows
+        if(fifo_count > MPU6050_FIFO_SIZE - MPU6050_FRAME_SIZE) {
+            ESP_LOGE(TAG, "FIFO overflow, %u bytes", fifo_count);
+            mpu6050_fifo_reset();
+            continue;
+        }
+
+        uint16_t frames = fifo_count / MPU6050_FRAME_SIZE;
+        if(frames == 0) {
+            continue;
+        }
+
+        while(frames) {
+            uint16_t chunk = frames;
+            if(chunk > sizeof(fifo_buffer) / MPU6050_FRAME_SIZE) {
+                chunk = sizeof(fifo_buffer) / MPU6050_FRAME_SIZE;
+            }
+            if(mpu6050_fifo_read(chunk * MPU6050_FRAME_SIZE, fifo_buffer) != ESP_OK) {
+                mpu6050_fifo_reset();
+                break;
+            }
+            frames -= chunk;
+
+            // Samples are evenly spaced by the sensor clock
+            for(uint16_t i = 0; i < chunk; i++) {
+                mpu6050_decode_frame(&fifo_buffer[i * MPU6050_FRAME_SIZE], &frame);
+                mpu6050_calculate_angle_accel(&frame.accel, &accel_angle);
+                mpu6050_calculate_angle_gyr(&frame.gyr, &gyr_angle, dt);
+                mpu6050_calculate_angle(&gyr_angle, &accel_angle, &real_angle);
+            }
+        }
+
+        // Publish the latest sample once per batch
+        mpu6050_update(&frame, &real_angle);
+
+        // Wait main application is ready to receive data
+        if(xEventGroupGetBits(xEventGroupApp) & BIT_APP_SEND_DATA) {
+            mpu6050_send_data(real_angle);
         }
 
+        if(xEventGroupGetBits(xEventGroupDataStreamMode) & BIT_UART_STREAM(UART_STREAM_IMU)) {
+            mpu6050_data_stream();
+        }
+    }
+#else
+    mpu6050_frame_t frame = {0};
+    int64_t last_sample = esp_timer_get_time();
+    while(1) {
+        ESP_ERROR_CHECK(mpu6050_read_frame(&frame));
+        int64_t now = esp_timer_get_time();
+        double dt = (now - last_sample) / 1000000.0;
+        last_sample = now;
+
+        // Calculate angles
+        mpu6050_calculate_angle_accel(&frame.accel, &accel_angle);
+        mpu6050_calculate_angle_gyr(&frame.gyr, &gyr_angle, dt);
+        mpu6050_calculate_angle(&gyr_angle, &accel_angle, &real_angle);
+
+        mpu6050_update(&frame, &real_angle);
+
         // Wait main application is ready to receive data
         if(xEventGroupGetBits(xEventGroupApp) & BIT_APP_SEND_DATA) {
             mpu6050_send_data(real_angle);
         }
 
-        if(xEventGroupGetBits(xEventGroupDataStreamMode) & BIT_UART_STREAM_MODE_ALL) {
+        if(xEventGroupGetBits(xEventGroupDataStreamMode) & BIT_UART_STREAM(UART_STREAM_IMU)) {
             mpu6050_data_stream();
         }
 
         vTaskDelay(pdMS_TO_TICKS(MPU_6050_TASK_PERIOD_MS));
     }
+#endif
 }
 
 esp_err_t mpu6050_app_read_data(mpu6050_data_t * data, mpu6050_angle_data_t * angle_data) {
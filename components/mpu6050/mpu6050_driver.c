@@ -1,52 +1,31 @@
 #include "mpu6050_driver.h"
 #include "i2c_app.h"
+#include "i2c_scheduler.h"
+#include "i2c_driver.h"
 #include <esp_log.h>
 
 //***************************************************************************************************************
 
 static const char *TAG = "MPU6050_Driver";
 
-static esp_err_t mpu6050_read(uint8_t reg, size_t len, uint8_t * data_buf) {
-
-    I2C_Status i2c_msg = {
-        .data = data_buf,
-        .device_address = MPU6050_SLAVE_ADDR,
-        .register_address = reg,
-        .size = len
-    };
+static SemaphoreHandle_t fifo_ready = NULL;
+static uint8_t fifo_batch_size = 1;
+static uint8_t fifo_samples = 0;
 
-    if(xQueueSend( xQueueI2CReadBuffer, (void *)&i2c_msg, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "Error writing to I2C Buffer");
-        return ESP_ERR_TIMEOUT;
+static esp_err_t mpu6050_read(uint8_t reg, size_t len, uint8_t * data_buf) {
+    esp_err_t err = i2c_app_read(MPU6050_SLAVE_ADDR, reg, len, data_buf);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error reading from I2C: %s", esp_err_to_name(err));
     }
-
-    if (xSemaphoreTake( xBinarySemaphoreI2CAppEndOfRead, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "Error waiting i2c end of write");
-        return ESP_ERR_TIMEOUT;
-	}
-
-    return ESP_OK;
+    return err;
 }
 
 static esp_err_t mpu6050_write(uint8_t reg, size_t len, uint8_t * data_buf) {
-    // Write data to i2c
-    I2C_Status i2c_msg = {
-        .data = data_buf,
-        .device_address = MPU6050_SLAVE_ADDR,
-        .register_address = reg,
-        .size = len
-    };
-
-    if(xQueueSend( xQueueI2CWriteBuffer, (void *)&i2c_msg, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "Error writing to I2C Buffer");
-        return ESP_ERR_TIMEOUT;
+    esp_err_t err = i2c_app_write(MPU6050_SLAVE_ADDR, reg, len, data_buf);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error writing to I2C: %s", esp_err_to_name(err));
     }
-
-    if (xSemaphoreTake( xBinarySemaphoreI2CAppEndOfWrite, portMAX_DELAY ) == pdFAIL) {
-        ESP_LOGE(TAG, "Error waiting i2c end of write");
-        return ESP_ERR_TIMEOUT;
-	}
-    return ESP_OK;
+    return err;
 }
 
 //***********************************************************************************************
@@ -55,6 +34,11 @@ esp_err_t mpu6050_init() {
     esp_err_t err = ESP_OK;
     uint8_t data[2] = {0};
 
+    i2c_bus_register_device(MPU6050_SLAVE_ADDR, MPU6050_MAX_CLK_HZ);
+
+    // Gyroscope start-up time after leaving sleep is 30 ms (datasheet 6.1)
+    i2c_sched_add_constraint(MPU6050_SLAVE_ADDR, MPU6050_PWR_MGMT_1, 30000);
+
     // Change status from sleep to running
     err = mpu6050_write(MPU6050_PWR_MGMT_1, 1, data);
     if(err != ESP_OK) {
@@ -63,7 +47,7 @@ esp_err_t mpu6050_init() {
     }
     // Configure accelerometer
     data[0] =_2G_SCALE;
-    mpu6050_write(MPU6050_ACCEL_CONFIG, 1, data);
+    err = mpu6050_write(MPU6050_ACCEL_CONFIG, 1, data);
     if(err != ESP_OK) {
         ESP_LOGE(TAG, "Error configuring accel");
         return err;
@@ -79,6 +63,187 @@ esp_err_t mpu6050_init() {
     return ESP_OK;
 }
 
+void mpu6050_decode_frame(const uint8_t * raw, mpu6050_frame_t * frame) {
+    int16_t accel_read_x = ((uint16_t)(raw[0] << 8) | ((uint16_t)raw[1]));
+    int16_t accel_read_y = ((uint16_t)(raw[2] << 8) | ((uint16_t)raw[3]));
+    int16_t accel_read_z = ((uint16_t)(raw[4] << 8) | ((uint16_t)raw[5]));
+    int16_t temp_read = ((uint16_t)(raw[6] << 8) | ((uint16_t)raw[7]));
+    int16_t gyr_read_x = ((uint16_t)(raw[8] << 8) | ((uint16_t)raw[9]));
+    int16_t gyr_read_y = ((uint16_t)(raw[10] << 8) | ((uint16_t)raw[11]));
+    int16_t gyr_read_z = ((uint16_t)(raw[12] << 8) | ((uint16_t)raw[13]));
+
+    frame->accel.x = -accel_read_x /LSB_Sensitivity_2G;
+    frame->accel.y = -accel_read_y /LSB_Sensitivity_2G;
+    frame->accel.z = -accel_read_z /LSB_Sensitivity_2G;
+
+    frame->temperature = ((double)temp_read/340) + 36.53;
+
+    frame->gyr.x = -gyr_read_x /LSB_Sensitivity_250;
+    frame->gyr.y = -gyr_read_y /LSB_Sensitivity_250;
+    frame->gyr.z = -gyr_read_z /LSB_Sensitivity_250;
+}
+
+esp_err_t mpu6050_read_frame(mpu6050_frame_t * frame) {
+    if(!frame) return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = ESP_OK;
+
+    // Accel, temperature and gyro registers are contiguous: one transfer, one sampling instant
+    uint8_t data_read[MPU6050_FRAME_SIZE] = {0};
+    err = mpu6050_read(MPU6050_ACCEL_XOUT_H, MPU6050_FRAME_SIZE, data_read);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error Reading frame");
+        return err;
+    }
+
+    mpu6050_decode_frame(data_read, frame);
+
+    return ESP_OK;
+}
+
+//***********************************************************************************************
+
+static void IRAM_ATTR mpu6050_data_ready_isr(void * arg) {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    // Only wake the task once a whole batch is waiting in the FIFO
+    if(++fifo_samples >= fifo_batch_size) {
+        fifo_samples = 0;
+        xSemaphoreGiveFromISR(fifo_ready, &xHigherPriorityTaskWoken);
+    }
+
+    if(xHigherPriorityTaskWoken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+esp_err_t mpu6050_fifo_init(uint16_t odr_hz, uint8_t batch_size, SemaphoreHandle_t ready) {
+    if(odr_hz < MPU6050_ODR_MIN_HZ || odr_hz > MPU6050_GYRO_RATE_HZ || batch_size == 0 || !ready) return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = ESP_OK;
+    uint8_t data[1] = {0};
+
+    fifo_ready = ready;
+    fifo_batch_size = batch_size;
+    fifo_samples = 0;
+
+    // Sample rate = Gyro output rate / (1 + SMPLRT_DIV)
+    data[0] = DLPF_CFG_188HZ;
+    err = mpu6050_write(MPU6050_CONFIG, 1, data);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error configuring DLPF");
+        return err;
+    }
+    data[0] = (MPU6050_GYRO_RATE_HZ / odr_hz) - 1;
+    err = mpu6050_write(MPU6050_SMPLRT_DIV, 1, data);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error configuring sample rate");
+        return err;
+    }
+
+    // Interrupt pin active high, push-pull, 50 us pulse
+    data[0] = 0;
+    err = mpu6050_write(MPU6050_INT_PIN_CFG, 1, data);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error configuring interrupt pin");
+        return err;
+    }
+
+    data[0] = FIFO_EN_TEMP_GYRO_ACCEL;
+    err = mpu6050_write(MPU6050_FIFO_EN, 1, data);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error selecting FIFO data");
+        return err;
+    }
+
+    err = mpu6050_fifo_reset();
+    if(err != ESP_OK) {
+        return err;
+    }
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << MPU6050_INT_PIN),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_ENABLE,
+        .intr_type = GPIO_INTR_POSEDGE,
+    };
+    err = gpio_config(&io_conf);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error configuring GPIO %d", MPU6050_INT_PIN);
+        return err;
+    }
+    // Service may already be installed by another component
+    err = gpio_install_isr_service(0);
+    if(err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Error installing GPIO ISR service");
+        return err;
+    }
+    err = gpio_isr_handler_add(MPU6050_INT_PIN, mpu6050_data_ready_isr, NULL);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error adding GPIO ISR handler");
+        return err;
+    }
+
+    data[0] = INT_DATA_RDY_EN;
+    err = mpu6050_write(MPU6050_INT_ENABLE, 1, data);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error enabling interrupt");
+        return err;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t mpu6050_fifo_reset() {
+    esp_err_t err = ESP_OK;
+    uint8_t data[1] = {0};
+
+    // FIFO must be disabled while it is reset
+    data[0] = USER_CTRL_FIFO_RESET;
+    err = mpu6050_write(MPU6050_USER_CTRL, 1, data);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error resetting FIFO");
+        return err;
+    }
+    data[0] = USER_CTRL_FIFO_EN;
+    err = mpu6050_write(MPU6050_USER_CTRL, 1, data);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error enabling FIFO");
+        return err;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t mpu6050_fifo_count(uint16_t * count) {
+    if(!count) return ESP_ERR_INVALID_ARG;
+
+    uint8_t data_read[2] = {0};
+    esp_err_t err = mpu6050_read(MPU6050_FIFO_COUNTH, 2, data_read);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error Reading FIFO count");
+        return err;
+    }
+
+    *count = ((uint16_t)data_read[0] << 8) | data_read[1];
+    return ESP_OK;
+}
+
+esp_err_t mpu6050_fifo_read(uint8_t len, uint8_t * data) {
+    if(!data) return ESP_ERR_INVALID_ARG;
+
+    // FIFO_R_W doesn't auto-increment, the whole burst pops from the FIFO
+    esp_err_t err = mpu6050_read(MPU6050_FIFO_R_W, len, data);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Error Reading FIFO");
+        return err;
+    }
+    return ESP_OK;
+}
+
+//***********************************************************************************************
+
 esp_err_t mpu6050_read_accel(mpu6050_accel_data_t * data) {
     if(!data) return ESP_ERR_INVALID_ARG;
 
@@ -88,7 +253,7 @@ esp_err_t mpu6050_read_accel(mpu6050_accel_data_t * data) {
     int16_t accel_read_z = 0;
 
     uint8_t data_read[6] = {0};
-    mpu6050_read(MPU6050_ACCEL_XOUT_H, 6, data_read);
+    err = mpu6050_read(MPU6050_ACCEL_XOUT_H, 6, data_read);
     if(err != ESP_OK) {
         ESP_LOGE(TAG, "Error Reading Accel data");
         return err;
@@ -114,7 +279,7 @@ esp_err_t mpu6050_read_gyr(mpu6050_gyr_data_t * data) {
     int16_t gyr_read_z = 0;
 
     uint8_t data_read[6] = {0};
-    mpu6050_read(MPU6050_GYRO_XOUT_H, 6, data_read);
+    err = mpu6050_read(MPU6050_GYRO_XOUT_H, 6, data_read);
     if(err != ESP_OK) {
         ESP_LOGE(TAG, "Error Reading Gyr data");
         return err;
@@ -136,7 +301,7 @@ esp_err_t mpu6050_read_temp(double * data) {
     esp_err_t err = ESP_OK;
 
     uint8_t data_read[6] = {0};
-    mpu6050_read(MPU6050_TEMP_OUT_H, 2, data_read);
+    err = mpu6050_read(MPU6050_TEMP_OUT_H, 2, data_read);
     if(err != ESP_OK) {
         ESP_LOGE(TAG, "Error Reading Temp data");
         return err;
@@ -1,17 +1,36 @@
 #ifndef _UART_APP_H_
 #define _UART_APP_H_
 
+#include <stdbool.h>
+#include <esp_err.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "freertos/event_groups.h"
+#include "uart_frame.h"
 
-extern QueueHandle_t xQueueUartWriteBuffer;
-extern QueueHandle_t xQueueUartStreamMicBuffer;
-extern QueueHandle_t xQueueUartStreamFFTBuffer;
-extern SemaphoreHandle_t xUartModeMutex;
+/**
+ * Any combination of streams can be subscribed at once, each with its own
+ * decimation. Producers check their stream bit and hand items to
+ * uart_stream_send(), which never blocks: every stream has a lock free ring
+ * with a single producer, and a full ring drops an item instead of holding
+ * up the sensor loop. vDataStream multiplexes every ring into the link with
+ * deficit round robin, so a busy stream can't starve the others.
+ */
 
+// One bit per uart_stream_id_e, set while the stream is subscribed
 extern EventGroupHandle_t xEventGroupDataStreamMode;
+#define BIT_UART_STREAM(stream)     (1 << (stream))
+
+// TX ring is sized to hold this much of the offered stream load
+#ifndef UART_TX_BUFFER_MS
+#define UART_TX_BUFFER_MS           50
+#endif
+
+// Bytes credited to a stream every round of the multiplexer
+#ifndef UART_STREAM_QUANTUM
+#define UART_STREAM_QUANTUM         256
+#endif
 
 typedef enum {
     UART_DATA_ID_ACCEL_X = 0,
@@ -32,21 +51,24 @@ typedef enum {
     UART_MODE_DISABLE,
 }uart_mode_e;
 
-// Bits for event group
-#define BIT_UART_STREAM_MODE_ALL (1<<0)
-#define BIT_UART_STREAM_MODE_MIC (1<<1)
-#define BIT_UART_STREAM_MODE_FFT (1<<2)
-typedef struct UART_data_s
+#define UART_VALUES_MAX     8
+
+// Sample of a value stream (IMU, heart rate)
+typedef struct UART_values_s
 {
-    uart_data_id_e id;     // Data ID
-    double data;           // Data value
-}uart_data_t;
+    float value[UART_VALUES_MAX];
+    uint8_t len;
+    uint32_t timestamp;    // esp_timer time of the sample, in us
+}uart_values_t;
 
 typedef struct UART_mic_data_s
 {
     uart_data_id_e id;     // Data ID
-    int32_t * data;        // Data value
+    int32_t * data;        // Data value, owned by the producer
     size_t len;            // Data lenght
+    void (*release)(void * ctx);    // Called once data is no longer used
+    void * ctx;
+    uint32_t timestamp;
 }uart_mic_data_t;
 
 typedef struct freq_s{
@@ -54,13 +76,68 @@ typedef struct freq_s{
     float value;
 }freq_t;
 
+#define UART_FFT_MAX_BANDS  32
+
 typedef struct UART_mic_fft_s
 {
-    freq_t * freq;              // Freq info
-    size_t len;                 // Data lenght
+    freq_t freq[UART_FFT_MAX_BANDS];    // Freq info
+    size_t len;                         // Data lenght
+    uint32_t timestamp;
 }uart_fft_data_t;
 
+/* Per stream state, for reporting */
+typedef struct {
+    bool subscribed;
+    uint16_t decimation;        // 1 sends every item
+    uint32_t frames;            // Frames sent
+    uint32_t skipped;           // Items left out by decimation
+    uint32_t dropped;           // Frames dropped because the link was behind
+    uint32_t overflows;         // Items lost because the stream ring was full
+    uint64_t bytes;             // Bytes sent, framing included
+    uint32_t rate;              // Bytes per second offered to the link, last second
+}uart_stream_info_t;
+
 void vDataStream( void *pvParameters );
+
+/**
+ * @brief Start sending a stream.
+ *
+ * @param stream Stream to send, UART_STREAM_FFT_NAMES follows UART_STREAM_FFT.
+ * @param decimation Send one item out of decimation, at least 1.
+ */
+esp_err_t uart_stream_subscribe(uart_stream_id_e stream, uint16_t decimation);
+esp_err_t uart_stream_unsubscribe(uart_stream_id_e stream);
+bool uart_stream_is_subscribed(uart_stream_id_e stream);
+esp_err_t uart_stream_get_info(uart_stream_id_e stream, uart_stream_info_t * info);
+const char * uart_stream_to_string(uart_stream_id_e stream);
+
+/**
+ * @brief Queue an item on a stream, never blocks.
+ *
+ * Only the task producing the stream may call this. The stream takes over
+ * the item, a mic block is released even when it is dropped.
+ *
+ * @param stream IMU and HEART_RATE take uart_values_t, MIC uart_mic_data_t, FFT uart_fft_data_t.
+ * @param item Item to copy in.
+ * @return ESP_ERR_NO_MEM if the ring was full and the item dropped.
+ */
+esp_err_t uart_stream_send(uart_stream_id_e stream, const void * item);
+
+// Send a value sample from any task but the stream producer, e.g. the console
+esp_err_t uart_stream_write_values(uart_stream_id_e stream, const uart_values_t * values, TickType_t timeout);
+// Bytes per second offered by the subscribed streams
+uint32_t uart_stream_get_bandwidth();
+
+/**
+ * @brief Reconfigure the link, the TX ring is sized from the bandwidth of
+ *        the subscribed streams.
+ *
+ * @param baud_rate Line rate, up to UART_BAUDRATE_MAX.
+ * @param flow_ctrl Use RTS/CTS, refused with ESP_ERR_NOT_SUPPORTED for now, see uart_link_configure().
+ */
+esp_err_t uart_stream_configure_link(uint32_t baud_rate, bool flow_ctrl);
+
+// Subscribe to the streams of a legacy mode only, decimation 1
 void uart_set_stream_mode(uart_mode_e new_mode);
 
 
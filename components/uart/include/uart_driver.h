@@ -1,18 +1,93 @@
 #ifndef _UART_DRIVER_H_
 #define _UART_DRIVER_H_
 
+#include <stdbool.h>
 #include <driver/uart.h>
 #include "driver/gpio.h"
+#include "uart_frame.h"
 
 #define TX_PIN (GPIO_NUM_17)
 #define RX_PIN (GPIO_NUM_16)
 #define UART_BAUDRATE   115200
 
+// Flow control lines, only driven when flow control is on
+#ifndef RTS_PIN
+#define RTS_PIN (GPIO_NUM_21)
+#endif
+#ifndef CTS_PIN
+#define CTS_PIN (GPIO_NUM_22)
+#endif
+
 static const int RX_BUF_SIZE = 128;
 static const int TX_BUF_SIZE = 128;
 
+// Streaming link preset
+#define UART_STREAM_BAUDRATE        2000000
+#define UART_BAUDRATE_MAX           3000000
+
+// TX ring limits, the ring always holds one full frame
+#define UART_TX_BUFFER_MIN          (UART_FRAME_OVERHEAD + UART_FRAME_MAX_PAYLOAD)
+#define UART_TX_BUFFER_MAX          16384
+
+/* Link configuration */
+typedef struct {
+    uint32_t baud_rate;
+    bool flow_ctrl;                 // RTS/CTS, not supported yet
+    size_t tx_buffer_size;          // TX ring in bytes
+} uart_link_config_t;
+
+/* Link counters */
+typedef struct {
+    uint32_t frames;                // Frames admitted to the TX ring
+    uint32_t dropped_frames;        // Frames refused because the link was behind
+    uint64_t dropped_bytes;
+    uint32_t max_backlog;           // Highest estimated TX backlog, in bytes
+} uart_link_stats_t;
+
+/* One piece of a scattered write */
+typedef struct {
+    const void * data;
+    size_t len;
+} uart_iovec_t;
+
 esp_err_t uart_init();
 
-int uart_write(char * data, uint8_t len);
+/**
+ * @brief Reinstall the driver with a new link configuration.
+ *
+ * Pending TX data is flushed first. On failure the previous configuration
+ * is restored.
+ *
+ * Flow control is refused with ESP_ERR_NOT_SUPPORTED: the host could then
+ * hold the line for any time, the backlog estimate of uart_write_frame()
+ * would be wrong and frames would block instead of being dropped.
+ */
+esp_err_t uart_link_configure(const uart_link_config_t * config);
+void uart_link_get_config(uart_link_config_t * config);
+void uart_link_get_stats(uart_link_stats_t * stats);
+void uart_link_reset_stats();
+
+int uart_write(char * data, size_t len);
+
+/**
+ * @brief Write several buffers back to back, as one record.
+ *
+ * Pieces go straight into the TX ring in order. Writes from other tasks
+ * can't land between them. Blocks while the TX ring is full.
+ *
+ * @return Total bytes written, 0 on error.
+ */
+int uart_writev(const uart_iovec_t * iov, size_t count);
+
+/**
+ * @brief Send a binary frame, header, payload and CRC go straight into the TX ring.
+ *
+ * Never blocks on a slow link: the TX backlog is tracked as a leaky bucket
+ * draining at the line rate, a frame that would overflow the TX ring is
+ * dropped and counted instead. An idle link always takes the frame.
+ *
+ * @return Bytes written, 0 if the frame was dropped or on error.
+ */
+int uart_write_frame(const uart_frame_header_t * header, const void * payload);
 
-#endif // _UART_DRIVER_H_
\ No newline at end of file
+#endif // _UART_DRIVER_H_
@@ -0,0 +1,109 @@
+#ifndef _UART_FRAME_H_
+#define _UART_FRAME_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Binary framing for the UART data stream.
+ *
+ * Every frame is laid out as, multi byte fields little endian:
+ *
+ *   0xA5 0x5A | stream | type | seq (2) | timestamp (4) | len (2) | payload (len) | crc (2)
+ *
+ * The CRC is CRC-16/CCITT-FALSE over everything between the sync word and
+ * the CRC. The payload is an array of the element type given by type.
+ *
+ * This file has no ESP-IDF dependency so the decoder can be built into host
+ * tools as is.
+ */
+
+#define UART_FRAME_SYNC_0           0xA5
+#define UART_FRAME_SYNC_1           0x5A
+#define UART_FRAME_HEADER_SIZE      12
+#define UART_FRAME_CRC_SIZE         2
+#define UART_FRAME_MAX_PAYLOAD      1024
+#define UART_FRAME_OVERHEAD         (UART_FRAME_HEADER_SIZE + UART_FRAME_CRC_SIZE)
+
+typedef enum {
+    UART_STREAM_IMU = 0,            // Accel x, y, z then gyro x, y, z
+    UART_STREAM_HEART_RATE,
+    UART_STREAM_MIC,                // Raw mic samples
+    UART_STREAM_FFT,                // Band values
+    UART_STREAM_FFT_NAMES,          // Comma separated band names, sent when the band layout changes
+    UART_STREAM_MAX
+} uart_stream_id_e;
+
+typedef enum {
+    UART_FRAME_TYPE_U8 = 0,         // Also used for text
+    UART_FRAME_TYPE_I16,
+    UART_FRAME_TYPE_I32,
+    UART_FRAME_TYPE_F32,
+    UART_FRAME_TYPE_MAX
+} uart_frame_type_e;
+
+typedef struct {
+    uint8_t stream;
+    uint8_t type;
+    uint16_t seq;
+    uint32_t timestamp;             // Microseconds, wraps
+    uint16_t len;                   // Payload bytes
+} uart_frame_header_t;
+
+uint16_t uart_frame_crc16(uint16_t crc, const uint8_t * data, size_t len);
+
+/**
+ * @brief Write the sync word and header.
+ *
+ * @param out At least UART_FRAME_HEADER_SIZE bytes.
+ * @param header Header fields.
+ *
+ * @return CRC of the header, to be continued over the payload with
+ *         uart_frame_crc16() and written with uart_frame_encode_crc().
+ */
+uint16_t uart_frame_encode_header(uint8_t * out, const uart_frame_header_t * header);
+void uart_frame_encode_crc(uint8_t * out, uint16_t crc);
+
+/**
+ * @brief Encode a complete frame into a buffer.
+ *
+ * @return Frame size, 0 if it doesn't fit in size bytes.
+ */
+size_t uart_frame_encode(uint8_t * out, size_t size, const uart_frame_header_t * header, const void * payload);
+
+//***************************************************************************************************************
+
+typedef enum {
+    UART_FRAME_NONE = 0,            // Need more bytes
+    UART_FRAME_READY,               // A frame was decoded
+    UART_FRAME_CRC_ERROR,           // Frame dropped, decoder resynchronizing
+    UART_FRAME_LEN_ERROR,           // Length above UART_FRAME_MAX_PAYLOAD, decoder resynchronizing
+} uart_frame_status_e;
+
+/* Byte by byte decoder state */
+typedef struct {
+    uint8_t buffer[UART_FRAME_HEADER_SIZE + UART_FRAME_MAX_PAYLOAD + UART_FRAME_CRC_SIZE];
+    size_t len;                     // Bytes buffered
+    size_t consumed;                // Size of the frame handed out, dropped on the next push
+    uart_frame_header_t header;     // Valid after UART_FRAME_READY
+    const uint8_t * payload;        // Valid after UART_FRAME_READY, until the next push
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t len_errors;
+} uart_frame_decoder_t;
+
+void uart_frame_decoder_init(uart_frame_decoder_t * decoder);
+
+/**
+ * @brief Feed one received byte.
+ *
+ * After a CRC or length error the decoder resynchronizes on the bytes it
+ * already holds, so frames behind a corrupted one are not lost. At most one
+ * frame is returned per byte.
+ *
+ * @return UART_FRAME_READY when a valid frame was decoded, the header and
+ *         payload are then in the decoder.
+ */
+uart_frame_status_e uart_frame_decoder_push(uart_frame_decoder_t * decoder, uint8_t byte);
+
+#endif //_UART_FRAME_H_
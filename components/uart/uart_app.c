@@ -1,72 +1,517 @@
 #include "uart_app.h"
 #include "uart_driver.h"
 #include "esp_log.h"
+#include <esp_timer.h>
 #include <string.h>
 #include "common.h"
+#include "spsc_ring.h"
 
 static const char *TAG = "UART_App";
 
-QueueHandle_t xQueueUartWriteBuffer;
-QueueHandle_t xQueueUartStreamMicBuffer;
-QueueHandle_t xQueueUartStreamFFTBuffer;
+// Ring lengths, powers of two
+#define UART_STREAM_IMU_RING_LEN            16
+#define UART_STREAM_HEART_RATE_RING_LEN     4
+#define UART_STREAM_MIC_RING_LEN            16
+#define UART_STREAM_FFT_RING_LEN            4
+
+#define UART_STREAM_WRITE_QUEUE_LEN         2
+
 EventGroupHandle_t xEventGroupDataStreamMode;
 
-SemaphoreHandle_t xUartModeMutex;
+static TaskHandle_t data_stream_task = NULL;
+// Console writes, kept apart so every ring has a single producer
+static QueueHandle_t xQueueUartStreamWrite;
 
 typedef struct {
-    double data[UART_DATA_ID_MAX];
-}data_stream_t;
+    uart_stream_id_e stream;
+    uart_values_t values;
+} uart_stream_write_t;
+
+typedef struct {
+    void * items;               // Ring storage, NULL for streams sent on behalf of another one
+    size_t item_size;
+    uint32_t ring_len;
+    spsc_ring_policy_e policy;
+    spsc_ring_t ring;
+    uint16_t decimation;
+    uint16_t count;             // Items since the last one sent
+    int32_t deficit;            // Bytes the stream may still send this round
+    uint16_t seq;
+    uint32_t frames;
+    uint32_t skipped;
+    uint32_t dropped;           // Frames the link refused
+    uint64_t bytes;
+    uint32_t window_bytes;      // Bytes offered in the current rate window
+    uint32_t rate;              // Bytes per second offered in the last window
+} uart_stream_t;
+
+/* Anything a stream ring can hold */
+typedef union {
+    uart_values_t values;
+    uart_mic_data_t mic;
+    uart_fft_data_t fft;
+} uart_stream_item_t;
+
+static uart_values_t imu_items[UART_STREAM_IMU_RING_LEN];
+static uart_values_t heart_rate_items[UART_STREAM_HEART_RATE_RING_LEN];
+static uart_mic_data_t mic_items[UART_STREAM_MIC_RING_LEN];
+static uart_fft_data_t fft_items[UART_STREAM_FFT_RING_LEN];
+
+/**
+ * Readings and spectra are only worth their latest value, so a full ring
+ * evicts the oldest one. Audio keeps what is queued and refuses the new
+ * block instead, so a gap in the stream is one contiguous cut.
+ */
+static uart_stream_t streams[UART_STREAM_MAX] = {
+    [UART_STREAM_IMU] = { .items = imu_items, .item_size = sizeof(uart_values_t),
+                          .ring_len = UART_STREAM_IMU_RING_LEN, .policy = SPSC_RING_DROP_OLDEST, .decimation = 1 },
+    [UART_STREAM_HEART_RATE] = { .items = heart_rate_items, .item_size = sizeof(uart_values_t),
+                                 .ring_len = UART_STREAM_HEART_RATE_RING_LEN, .policy = SPSC_RING_DROP_OLDEST, .decimation = 1 },
+    [UART_STREAM_MIC] = { .items = mic_items, .item_size = sizeof(uart_mic_data_t),
+                          .ring_len = UART_STREAM_MIC_RING_LEN, .policy = SPSC_RING_DROP_NEWEST, .decimation = 1 },
+    [UART_STREAM_FFT] = { .items = fft_items, .item_size = sizeof(uart_fft_data_t),
+                          .ring_len = UART_STREAM_FFT_RING_LEN, .policy = SPSC_RING_DROP_OLDEST, .decimation = 1 },
+    [UART_STREAM_FFT_NAMES] = { .items = NULL, .decimation = 1 },
+};
+static const char * stream_names[UART_STREAM_MAX] = {"imu", "hr", "mic", "fft", "fft-names"};
+
+static portMUX_TYPE stream_lock = portMUX_INITIALIZER_UNLOCKED;
 
-static uart_mode_e mode = UART_MODE_DATA_STREAM;
+// Band names are sent again after every FFT subscribe
+static bool fft_names_stale = true;
+
+// Offered rates are measured over this window
+#define UART_STREAM_RATE_WINDOW_US      1000000
+static int64_t rate_window_start = 0;
+
+// Rate windows left before the TX ring is sized again, 0 when no resize is due
+static uint8_t link_resize_windows = 0;
 
 // ******************************************************************************************************
 
+static void uart_mic_data_release(uart_mic_data_t * mic_data) {
+    if(mic_data->release) {
+        mic_data->release(mic_data->ctx);
+    }
+}
+
+// Give back whatever an item owns once it leaves the stream
+static void uart_stream_item_release(uart_stream_id_e stream, uart_stream_item_t * item) {
+    if(stream == UART_STREAM_MIC) {
+        uart_mic_data_release(&item->mic);
+    }
+}
+
+static void uart_send_frame(uart_stream_id_e stream, uart_frame_type_e type, const void * payload, size_t len, uint32_t timestamp) {
+    uart_frame_header_t header = {
+        .stream = stream,
+        .type = type,
+        .seq = streams[stream].seq++,
+        .timestamp = timestamp,
+        .len = len,
+    };
+    int written = uart_write_frame(&header, payload);
+
+    portENTER_CRITICAL(&stream_lock);
+    streams[stream].window_bytes += UART_FRAME_OVERHEAD + len;
+    if(written) {
+        streams[stream].frames++;
+        streams[stream].bytes += written;
+    } else {
+        streams[stream].dropped++;
+    }
+    portEXIT_CRITICAL(&stream_lock);
+}
+
+// Close the rate window once it is over, true if it was closed
+static bool uart_stream_update_rates() {
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - rate_window_start;
+    if(elapsed < UART_STREAM_RATE_WINDOW_US) return false;
+
+    portENTER_CRITICAL(&stream_lock);
+    for(uart_stream_id_e stream = 0; stream < UART_STREAM_MAX; stream++) {
+        streams[stream].rate = (uint64_t)streams[stream].window_bytes * 1000000 / elapsed;
+        streams[stream].window_bytes = 0;
+    }
+    portEXIT_CRITICAL(&stream_lock);
+    rate_window_start = now;
+    return true;
+}
+
+// Enough TX ring to ride out UART_TX_BUFFER_MS of the offered load
+static size_t uart_stream_tx_buffer_size(uint32_t bandwidth) {
+    size_t tx_buffer_size = (uint64_t)bandwidth * UART_TX_BUFFER_MS / 1000;
+    if(tx_buffer_size < UART_TX_BUFFER_MIN) tx_buffer_size = UART_TX_BUFFER_MIN;
+    if(tx_buffer_size > UART_TX_BUFFER_MAX) tx_buffer_size = UART_TX_BUFFER_MAX;
+    return tx_buffer_size;
+}
+
+// Grow the TX ring once the rates of newly subscribed streams are measured
+static void uart_stream_resize_link() {
+    portENTER_CRITICAL(&stream_lock);
+    bool due = link_resize_windows > 0 && --link_resize_windows == 0;
+    portEXIT_CRITICAL(&stream_lock);
+    if(!due) return;
+
+    uart_link_config_t config;
+    uart_link_get_config(&config);
+    size_t tx_buffer_size = uart_stream_tx_buffer_size(uart_stream_get_bandwidth());
+    if(tx_buffer_size <= config.tx_buffer_size) return;
+
+    config.tx_buffer_size = tx_buffer_size;
+    if(uart_link_configure(&config) == ESP_OK) {
+        ESP_LOGI(TAG, "TX ring %u bytes", (unsigned)tx_buffer_size);
+    }
+}
+
+static bool uart_stream_wanted(uart_stream_id_e stream) {
+    return xEventGroupGetBits(xEventGroupDataStreamMode) & BIT_UART_STREAM(stream);
+}
+
+// Bytes the head item will put on the link, 0 if it is going to be left out
+static size_t uart_stream_cost(uart_stream_id_e stream, const uart_stream_item_t * item) {
+    if(!uart_stream_wanted(stream) || streams[stream].count + 1 < streams[stream].decimation) {
+        return 0;
+    }
+
+    switch(stream) {
+        case UART_STREAM_IMU:
+        case UART_STREAM_HEART_RATE:
+            return UART_FRAME_OVERHEAD + item->values.len * sizeof(float);
+        case UART_STREAM_MIC: {
+            // One frame per UART_FRAME_MAX_PAYLOAD bytes of samples, see uart_stream_send_mic()
+            size_t bytes = item->mic.len * sizeof(int32_t);
+            size_t frames = (bytes + UART_FRAME_MAX_PAYLOAD - 1) / UART_FRAME_MAX_PAYLOAD;
+            return frames * UART_FRAME_OVERHEAD + bytes;
+        }
+        case UART_STREAM_FFT:
+            return UART_FRAME_OVERHEAD + item->fft.len * sizeof(float);
+        default:
+            return 0;
+    }
+}
+
+static void uart_stream_send_mic(uart_mic_data_t * mic) {
+    ESP_LOGD(TAG, "Received %d values from MIC", mic->len);
+    // Frames of up to UART_FRAME_MAX_PAYLOAD bytes, samples go straight from the pool block to the TX ring
+    size_t offset = 0;
+    while(offset < mic->len) {
+        size_t len = mic->len - offset;
+        if(len > UART_FRAME_MAX_PAYLOAD / sizeof(int32_t)) {
+            len = UART_FRAME_MAX_PAYLOAD / sizeof(int32_t);
+        }
+        uart_send_frame(UART_STREAM_MIC, UART_FRAME_TYPE_I32, &mic->data[offset], len * sizeof(int32_t), mic->timestamp);
+        offset += len;
+    }
+}
+
+static void uart_stream_send_fft(uart_fft_data_t * fft) {
+    static char names_buffer[UART_FFT_MAX_BANDS * 8];
+    static float band_values[UART_FFT_MAX_BANDS];
+    static const char * band_names_sent = NULL;
+    static size_t band_count_sent = 0;
+
+    ESP_LOGD(TAG, "Received %d values from FFT", fft->len);
+    if(fft->len == 0) return;
+
+    // Band names only go out when the layout changes
+    portENTER_CRITICAL(&stream_lock);
+    bool stale = fft_names_stale;
+    fft_names_stale = false;
+    portEXIT_CRITICAL(&stream_lock);
+    if(stale || band_names_sent != fft->freq[0].name || band_count_sent != fft->len) {
+        size_t pos = 0;
+        for(size_t i = 0; i < fft->len; i++) {
+            int n = snprintf(&names_buffer[pos], sizeof(names_buffer) - pos, "%s%s", i ? "," : "", fft->freq[i].name);
+            if(n < 0 || pos + n >= sizeof(names_buffer)) {
+                break;
+            }
+            pos += n;
+        }
+        uart_send_frame(UART_STREAM_FFT_NAMES, UART_FRAME_TYPE_U8, names_buffer, pos, fft->timestamp);
+        band_names_sent = fft->freq[0].name;
+        band_count_sent = fft->len;
+    }
+
+    for(size_t i = 0; i < fft->len; i++) {
+        band_values[i] = fft->freq[i].value;
+    }
+    uart_send_frame(UART_STREAM_FFT, UART_FRAME_TYPE_F32, band_values, fft->len * sizeof(float), fft->timestamp);
+}
+
+// Take the head item of a stream and send it, unless it is left out
+static void uart_stream_serve(uart_stream_id_e stream) {
+    static uart_stream_item_t item;
+    uart_stream_t * st = &streams[stream];
+
+    if(!spsc_ring_pop(&st->ring, &item)) {
+        return;
+    }
+
+    bool send = false;
+    if(uart_stream_wanted(stream)) {
+        portENTER_CRITICAL(&stream_lock);
+        if(++st->count >= st->decimation) {
+            st->count = 0;
+            send = true;
+        } else {
+            st->skipped++;
+        }
+        portEXIT_CRITICAL(&stream_lock);
+    }
+
+    switch(stream) {
+        case UART_STREAM_IMU:
+        case UART_STREAM_HEART_RATE:
+            if(send) {
+                uart_send_frame(stream, UART_FRAME_TYPE_F32, item.values.value, item.values.len * sizeof(float), item.values.timestamp);
+            }
+        break;
+        case UART_STREAM_MIC:
+            if(send) {
+                uart_stream_send_mic(&item.mic);
+            }
+        break;
+        case UART_STREAM_FFT:
+            if(send) {
+                uart_stream_send_fft(&item.fft);
+            }
+        break;
+        default:
+        break;
+    }
+
+    // Block goes back to the pool even if it was not sent
+    uart_stream_item_release(stream, &item);
+}
+
+// Send the console writes, they skip decimation
+static void uart_stream_serve_writes() {
+    uart_stream_write_t write;
+    while(xQueueReceive(xQueueUartStreamWrite, (void *)&write, 0) == pdPASS) {
+        uart_send_frame(write.stream, UART_FRAME_TYPE_F32, write.values.value, write.values.len * sizeof(float), write.values.timestamp);
+    }
+}
+
+/**
+ * Serve one item, false once every ring is empty.
+ *
+ * Which ring is served is up to the deficit round robin: every round a
+ * stream is credited a quantum of bytes and may send as long as its head
+ * item fits in its credit.
+ */
+static bool uart_stream_serve_next(uart_stream_id_e * current) {
+    static uart_stream_item_t head;
+    uint8_t empty = 0;
+
+    while(empty < UART_STREAM_MAX) {
+        uart_stream_t * st = &streams[*current];
+
+        if(st->items == NULL || !spsc_ring_peek(&st->ring, &head)) {
+            // Idle streams don't save credit
+            st->deficit = 0;
+            *current = (*current + 1) % UART_STREAM_MAX;
+            empty++;
+            continue;
+        }
+        empty = 0;
+
+        int32_t cost = uart_stream_cost(*current, &head);
+        if(cost > st->deficit) {
+            st->deficit += UART_STREAM_QUANTUM;
+            *current = (*current + 1) % UART_STREAM_MAX;
+            continue;
+        }
+
+        st->deficit -= cost;
+        uart_stream_serve(*current);
+        return true;
+    }
+    return false;
+}
+
+// ******************************************************************************************************
+
+esp_err_t uart_stream_send(uart_stream_id_e stream, const void * item) {
+    if(stream >= UART_STREAM_MAX || streams[stream].items == NULL || item == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uart_stream_item_t evicted;
+    spsc_ring_result_e result = spsc_ring_push(&streams[stream].ring, item, &evicted);
+    if(result == SPSC_RING_EVICTED) {
+        uart_stream_item_release(stream, &evicted);
+    } else if(result == SPSC_RING_REJECTED) {
+        memcpy(&evicted, item, streams[stream].item_size);
+        uart_stream_item_release(stream, &evicted);
+    }
+
+    if(data_stream_task) {
+        xTaskNotifyGive(data_stream_task);
+    }
+    return result == SPSC_RING_REJECTED ? ESP_ERR_NO_MEM : ESP_OK;
+}
+
+esp_err_t uart_stream_write_values(uart_stream_id_e stream, const uart_values_t * values, TickType_t timeout) {
+    if(stream >= UART_STREAM_MAX || values == NULL || values->len > UART_VALUES_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(stream != UART_STREAM_IMU && stream != UART_STREAM_HEART_RATE) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    uart_stream_write_t write = {
+        .stream = stream,
+        .values = *values,
+    };
+    if(xQueueSend(xQueueUartStreamWrite, (void *)&write, timeout) != pdPASS) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if(data_stream_task) {
+        xTaskNotifyGive(data_stream_task);
+    }
+    return ESP_OK;
+}
+
+esp_err_t uart_stream_subscribe(uart_stream_id_e stream, uint16_t decimation) {
+    if(stream >= UART_STREAM_MAX || streams[stream].items == NULL || decimation == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&stream_lock);
+    streams[stream].decimation = decimation;
+    streams[stream].count = 0;
+    if(stream == UART_STREAM_FFT) {
+        fft_names_stale = true;
+    }
+    // The window in progress only partly covers the new stream
+    link_resize_windows = 2;
+    portEXIT_CRITICAL(&stream_lock);
+
+    xEventGroupSetBits(xEventGroupDataStreamMode, BIT_UART_STREAM(stream));
+    ESP_LOGI(TAG, "Stream %s on, 1/%u", stream_names[stream], (unsigned)decimation);
+    return ESP_OK;
+}
+
+esp_err_t uart_stream_unsubscribe(uart_stream_id_e stream) {
+    if(stream >= UART_STREAM_MAX || streams[stream].items == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xEventGroupClearBits(xEventGroupDataStreamMode, BIT_UART_STREAM(stream));
+    ESP_LOGI(TAG, "Stream %s off", stream_names[stream]);
+    return ESP_OK;
+}
+
+bool uart_stream_is_subscribed(uart_stream_id_e stream) {
+    if(stream >= UART_STREAM_MAX) return false;
+    return uart_stream_wanted(stream);
+}
+
+esp_err_t uart_stream_get_info(uart_stream_id_e stream, uart_stream_info_t * info) {
+    if(stream >= UART_STREAM_MAX || info == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Band names follow the FFT subscription
+    uart_stream_id_e owner = stream == UART_STREAM_FFT_NAMES ? UART_STREAM_FFT : stream;
+    info->subscribed = uart_stream_wanted(owner);
+
+    portENTER_CRITICAL(&stream_lock);
+    info->decimation = streams[owner].decimation;
+    info->frames = streams[stream].frames;
+    info->skipped = streams[stream].skipped;
+    info->dropped = streams[stream].dropped;
+    info->bytes = streams[stream].bytes;
+    info->rate = streams[stream].rate;
+    portEXIT_CRITICAL(&stream_lock);
+    info->overflows = streams[stream].items ? spsc_ring_get_overflows(&streams[stream].ring) : 0;
+    return ESP_OK;
+}
+
+uint32_t uart_stream_get_bandwidth() {
+    uint32_t total = 0;
+    for(uart_stream_id_e stream = 0; stream < UART_STREAM_MAX; stream++) {
+        uart_stream_info_t info;
+        uart_stream_get_info(stream, &info);
+        if(info.subscribed) {
+            total += info.rate;
+        }
+    }
+    return total;
+}
+
+esp_err_t uart_stream_configure_link(uint32_t baud_rate, bool flow_ctrl) {
+    uint32_t bandwidth = uart_stream_get_bandwidth();
+    size_t tx_buffer_size = uart_stream_tx_buffer_size(bandwidth);
+
+    if(bandwidth > baud_rate / 10) {
+        ESP_LOGW(TAG, "Streams offer %u B/s, link carries %u B/s", (unsigned)bandwidth, (unsigned)(baud_rate / 10));
+    }
+
+    uart_link_config_t config = {
+        .baud_rate = baud_rate,
+        .flow_ctrl = flow_ctrl,
+        .tx_buffer_size = tx_buffer_size,
+    };
+    esp_err_t err = uart_link_configure(&config);
+    if(err == ESP_OK) {
+        ESP_LOGI(TAG, "Link %u baud, flow control %s, TX ring %u bytes", (unsigned)baud_rate, flow_ctrl ? "on" : "off", (unsigned)tx_buffer_size);
+    }
+    return err;
+}
+
+const char * uart_stream_to_string(uart_stream_id_e stream) {
+    return stream < UART_STREAM_MAX ? stream_names[stream] : "unknown";
+}
+
 void uart_set_stream_mode(uart_mode_e new_mode) {
-    if(xSemaphoreTake(xUartModeMutex, portMAX_DELAY) == pdTRUE) {
-        mode = new_mode;
-        ESP_LOGI(TAG, "New Mode: %d", mode);
-        xSemaphoreGive(xUartModeMutex);
-
-        // Set group bits
-        switch(mode) {
-            case UART_MODE_DISABLE:
-                xEventGroupClearBits(xEventGroupDataStreamMode, BIT_UART_STREAM_MODE_ALL | BIT_UART_STREAM_MODE_FFT | BIT_UART_STREAM_MODE_MIC);
-            break;
-            case UART_MODE_FFT_STREAM:
-                xEventGroupClearBits(xEventGroupDataStreamMode, BIT_UART_STREAM_MODE_ALL | BIT_UART_STREAM_MODE_MIC);
-                xEventGroupSetBits(xEventGroupDataStreamMode, BIT_UART_STREAM_MODE_FFT);
-            break;
-            case UART_MODE_MIC_STREAM:
-                xEventGroupClearBits(xEventGroupDataStreamMode, BIT_UART_STREAM_MODE_ALL | BIT_UART_STREAM_MODE_FFT);
-                xEventGroupSetBits(xEventGroupDataStreamMode, BIT_UART_STREAM_MODE_MIC);
-            break;
-            case UART_MODE_DATA_STREAM:
-                xEventGroupClearBits(xEventGroupDataStreamMode, BIT_UART_STREAM_MODE_MIC | BIT_UART_STREAM_MODE_FFT);
-                xEventGroupSetBits(xEventGroupDataStreamMode, BIT_UART_STREAM_MODE_ALL);
-            break;
+    ESP_LOGI(TAG, "New Mode: %d", new_mode);
+
+    for(uart_stream_id_e stream = 0; stream < UART_STREAM_MAX; stream++) {
+        if(streams[stream].items) {
+            uart_stream_unsubscribe(stream);
         }
     }
+
+    switch(new_mode) {
+        case UART_MODE_DATA_STREAM:
+            uart_stream_subscribe(UART_STREAM_IMU, 1);
+            uart_stream_subscribe(UART_STREAM_HEART_RATE, 1);
+        break;
+        case UART_MODE_MIC_STREAM:
+            uart_stream_subscribe(UART_STREAM_MIC, 1);
+        break;
+        case UART_MODE_FFT_STREAM:
+            uart_stream_subscribe(UART_STREAM_FFT, 1);
+        break;
+        case UART_MODE_DISABLE:
+        break;
+    }
     // Clear Plotter
 }
+
 /**
- * Stream data in the format:
- * DATA_1,DATA_2,DATA_3
+ * Stream data as binary frames, see uart_frame.h:
+ * IMU, HR    - float values
+ * MIC        - int32 samples, one frame per block
+ * FFT        - float per band, FFT_NAMES is sent first and whenever the bands change
 */
 void vDataStream( void *pvParameters ) {
-    uart_data_t lReceivedValue;
-    uart_mic_data_t lReceivedMicValue;
-    uart_fft_data_t lReceivedFFTValue;
-
-    // Init Queue
-    xQueueUartWriteBuffer = xQueueCreate(16, sizeof(uart_data_t));
-    xQueueUartStreamMicBuffer = xQueueCreate(16, sizeof(uart_data_t));
-    xQueueUartStreamFFTBuffer = xQueueCreate(16, sizeof(uart_data_t));
-    xUartModeMutex = xSemaphoreCreateMutex();
-    if(xUartModeMutex == NULL) {
-        ESP_LOGE(TAG, "ERROR Creating Mutex");
-        return;
+    data_stream_task = xTaskGetCurrentTaskHandle();
+
+    // Init rings
+    for(uart_stream_id_e stream = 0; stream < UART_STREAM_MAX; stream++) {
+        uart_stream_t * st = &streams[stream];
+        if(st->items) {
+            ESP_ERROR_CHECK(spsc_ring_init(&st->ring, st->items, st->item_size, st->ring_len, st->policy));
+        }
     }
 
+    xQueueUartStreamWrite = xQueueCreate(UART_STREAM_WRITE_QUEUE_LEN, sizeof(uart_stream_write_t));
+    configASSERT( xQueueUartStreamWrite );
+
     // Init Event Group for Data stream mode
     xEventGroupDataStreamMode = xEventGroupCreate();
     if(xEventGroupDataStreamMode == NULL) {
@@ -80,85 +525,21 @@ void vDataStream( void *pvParameters ) {
 	xEventGroupSetBits(xEventGroupTasks, BIT_TASK_DATA_STREAM);
     ESP_LOGI(TAG, "Data Stream Initialized");
 
-
-    char data_buffer[256] = {0};
-    data_stream_t data_packet;
-    memset(&data_packet, 0, sizeof(data_stream_t));
-
-    bool send_data = false;
-
     // Start in disable mode
     uart_set_stream_mode(UART_MODE_DISABLE);
 
+    uart_stream_id_e current = 0;
+    bool idle = true;
+    rate_window_start = esp_timer_get_time();
     while(1) {
-        switch(mode) {
-            case UART_MODE_DATA_STREAM:
-                while(uxQueueMessagesWaiting(xQueueUartWriteBuffer)) {
-                    if( xQueueReceive( xQueueUartWriteBuffer, (void *)&lReceivedValue, portMAX_DELAY ) == pdPASS ) {
-                        data_packet.data[lReceivedValue.id] = lReceivedValue.data;
-                        send_data = true;
-                    }
-                }
-
-                if(send_data) {
-                    sprintf(data_buffer, "Accel_x:%2.2f,Accel_y:%2.2f,Accel_z:%2.2f,    \
-                                        Gyro_x:%2.2f,Gyro_y:%2.2f,Gyro_z:%2.2f,         \
-                                        MIC:%2.2f,HR:%2.2f\n",
-                                        data_packet.data[UART_DATA_ID_ACCEL_X],
-                                        data_packet.data[UART_DATA_ID_ACCEL_Y],
-                                        data_packet.data[UART_DATA_ID_ACCEL_Z],
-                                        data_packet.data[UART_DATA_ID_GYR_X],
-                                        data_packet.data[UART_DATA_ID_GYR_Y],
-                                        data_packet.data[UART_DATA_ID_GYR_Z],
-                                        data_packet.data[UART_DATA_ID_MIC],
-                                        data_packet.data[UART_DATA_ID_HEART_RATE]);
-
-                    if(!uart_write(data_buffer, strlen(data_buffer))) {
-                        ESP_LOGE(TAG, "ERROR WRITING DATA");
-                    }
-                    // send_data = false;
-                }
-
-                vTaskDelay( 20 / portTICK_RATE_MS );
-            break;
-            case UART_MODE_MIC_STREAM:
-                if( xQueueReceive( xQueueUartStreamMicBuffer, (void *)&lReceivedMicValue, portMAX_DELAY ) == pdPASS ) {
-                    ESP_LOGD(TAG, "Received %d values from MIC", lReceivedMicValue.len);
-                    if(lReceivedMicValue.len) {
-                        for(uint32_t i = 0; i<lReceivedMicValue.len; i++) {
-                            sprintf(data_buffer, "MIN:-100000,MAX:100000,MIC:%d\n", lReceivedMicValue.data[i]);
-                            if(!uart_write(data_buffer, strlen(data_buffer))) {
-                                ESP_LOGE(TAG, "ERROR WRITING DATA");
-                                break;
-                            }
-                        }
-                    }
-                }
-            break;
-            case UART_MODE_FFT_STREAM:
-                if( xQueueReceive( xQueueUartStreamFFTBuffer, (void *)&lReceivedFFTValue, portMAX_DELAY ) == pdPASS ) {
-                    ESP_LOGD(TAG, "Received %d values from FFT", lReceivedFFTValue.len);
-
-                    if(lReceivedFFTValue.len) {
-                        sprintf(data_buffer, "31.5Hz:%2.2f,63Hz:%2.2f,94.5Hz:%2.2f,126Hz:%2.2f,257.5Hz:%2.2f\n",
-                        lReceivedFFTValue.freq[0].value,
-                        lReceivedFFTValue.freq[1].value,
-                        lReceivedFFTValue.freq[2].value,
-                        lReceivedFFTValue.freq[3].value,
-                        lReceivedFFTValue.freq[4].value);
-
-                        if(!uart_write(data_buffer, strlen(data_buffer))) {
-                            ESP_LOGE(TAG, "ERROR WRITING DATA");
-                            }
-                    }
-                }
-            break;
-            case UART_MODE_DISABLE:
-                vTaskDelay(pdMS_TO_TICKS(1000));
-            break;
-            default:
-                ESP_LOGE(TAG, "INVALID MODE");
-            break;
+        // Producers notify every push, wake up now and then so rates decay when streams go quiet
+        if(idle) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(UART_STREAM_RATE_WINDOW_US / 1000));
+        }
+        if(uart_stream_update_rates()) {
+            uart_stream_resize_link();
         }
+        uart_stream_serve_writes();
+        idle = !uart_stream_serve_next(&current);
     }
 }
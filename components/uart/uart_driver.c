@@ -1,14 +1,35 @@
 #include "uart_driver.h"
+#include <string.h>
+#include <esp_timer.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
+// Keeps records from different writers in one piece, also guards the link state
+static SemaphoreHandle_t write_mutex = NULL;
+static StaticSemaphore_t write_mutex_buffer;
 
-esp_err_t uart_init() {
+static uart_link_config_t link_config = {
+    .baud_rate = UART_BAUDRATE,
+    .flow_ctrl = false,
+    .tx_buffer_size = UART_TX_BUFFER_MIN,
+};
+static uart_link_stats_t link_stats;
+
+// Estimated bytes still waiting in the TX ring, drains at the line rate
+static uint32_t backlog = 0;
+static int64_t backlog_time = 0;
+
+//***************************************************************************************************************
+
+static esp_err_t uart_link_install(const uart_link_config_t * config) {
     esp_err_t err = ESP_OK;
     const uart_config_t uart_config = {
-        .baud_rate = UART_BAUDRATE,
+        .baud_rate = config->baud_rate,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .flow_ctrl = config->flow_ctrl ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = UART_FIFO_LEN - 8,
         .source_clk = UART_SCLK_APB,
     };
     err = uart_param_config(UART_NUM_1, &uart_config);
@@ -16,20 +37,156 @@ esp_err_t uart_init() {
         return err;
     }
 
-    err = uart_set_pin(UART_NUM_1, TX_PIN, RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    err = uart_set_pin(UART_NUM_1, TX_PIN, RX_PIN, config->flow_ctrl ? RTS_PIN : UART_PIN_NO_CHANGE,
+                        config->flow_ctrl ? CTS_PIN : UART_PIN_NO_CHANGE);
     if(err != ESP_OK) {
         return err;
     }
 
-    err = uart_driver_install(UART_NUM_1, RX_BUF_SIZE * 2, TX_BUF_SIZE * 2, 0, NULL, 0);
-    if(err != ESP_OK) {
-        return err;
+    return uart_driver_install(UART_NUM_1, RX_BUF_SIZE * 2, config->tx_buffer_size, 0, NULL, 0);
+}
+
+// Drain the backlog estimate up to now, 10 bits per byte on the line
+static void uart_link_drain() {
+    int64_t now = esp_timer_get_time();
+    uint64_t drained = (uint64_t)(now - backlog_time) * (link_config.baud_rate / 10) / 1000000;
+    backlog = drained >= backlog ? 0 : backlog - drained;
+    backlog_time = now;
+}
+
+static int uart_writev_locked(const uart_iovec_t * iov, size_t count) {
+    int written = 0;
+    for(size_t i = 0; i < count; i++) {
+        if(iov[i].len == 0) continue;
+
+        int n = uart_write_bytes(UART_NUM_1, (const char *)iov[i].data, iov[i].len);
+        if(n < 0) {
+            return 0;
+        }
+        written += n;
     }
 
-    return ESP_OK;
+    uart_link_drain();
+    backlog += written;
+    if(backlog > link_stats.max_backlog) {
+        link_stats.max_backlog = backlog;
+    }
+    return written;
 }
 
-int uart_write(char * data, uint8_t len) {
+//***************************************************************************************************************
+
+esp_err_t uart_init() {
+    write_mutex = xSemaphoreCreateMutexStatic(&write_mutex_buffer);
+    backlog_time = esp_timer_get_time();
+    return uart_link_install(&link_config);
+}
+
+esp_err_t uart_link_configure(const uart_link_config_t * config) {
+    if(config == NULL || config->baud_rate == 0 || config->baud_rate > UART_BAUDRATE_MAX ||
+        config->tx_buffer_size < UART_TX_BUFFER_MIN || config->tx_buffer_size > UART_TX_BUFFER_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // The backlog estimate assumes the line never stops, frame drops can't be accounted with RTS/CTS
+    if(config->flow_ctrl) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if(write_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    // Let what is queued go out at the old settings
+    uart_wait_tx_done(UART_NUM_1, pdMS_TO_TICKS(100));
+    uart_driver_delete(UART_NUM_1);
+
+    esp_err_t err = uart_link_install(config);
+    if(err == ESP_OK) {
+        link_config = *config;
+    } else {
+        uart_driver_delete(UART_NUM_1);
+        uart_link_install(&link_config);
+    }
+    backlog = 0;
+    backlog_time = esp_timer_get_time();
+    xSemaphoreGive(write_mutex);
+    return err;
+}
+
+void uart_link_get_config(uart_link_config_t * config) {
+    if(config == NULL || write_mutex == NULL) return;
+
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    *config = link_config;
+    xSemaphoreGive(write_mutex);
+}
+
+void uart_link_get_stats(uart_link_stats_t * stats) {
+    if(stats == NULL || write_mutex == NULL) return;
+
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    *stats = link_stats;
+    xSemaphoreGive(write_mutex);
+}
+
+void uart_link_reset_stats() {
+    if(write_mutex == NULL) return;
+
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    memset(&link_stats, 0, sizeof(uart_link_stats_t));
+    xSemaphoreGive(write_mutex);
+}
+
+int uart_write(char * data, size_t len) {
     if(data == NULL) return 0;
-    return uart_write_bytes(UART_NUM_1, (const char *)data, len);
+
+    uart_iovec_t iov = {
+        .data = data,
+        .len = len,
+    };
+    return uart_writev(&iov, 1);
+}
+
+int uart_writev(const uart_iovec_t * iov, size_t count) {
+    if(iov == NULL || write_mutex == NULL) return 0;
+
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    int written = uart_writev_locked(iov, count);
+    xSemaphoreGive(write_mutex);
+    return written;
+}
+
+int uart_write_frame(const uart_frame_header_t * header, const void * payload) {
+    if(header == NULL || header->len > UART_FRAME_MAX_PAYLOAD || (header->len && payload == NULL)) return 0;
+    if(write_mutex == NULL) return 0;
+
+    uint8_t head[UART_FRAME_HEADER_SIZE];
+    uint8_t tail[UART_FRAME_CRC_SIZE];
+    uint16_t crc = uart_frame_encode_header(head, header);
+    crc = uart_frame_crc16(crc, (const uint8_t *)payload, header->len);
+    uart_frame_encode_crc(tail, crc);
+
+    const uart_iovec_t iov[] = {
+        { .data = head, .len = sizeof(head) },
+        { .data = payload, .len = header->len },
+        { .data = tail, .len = sizeof(tail) },
+    };
+    size_t frame_len = UART_FRAME_OVERHEAD + header->len;
+    int written = 0;
+
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    uart_link_drain();
+    // An empty ring takes any frame, the minimum ring size fits the largest one
+    if(backlog > 0 && backlog + frame_len > link_config.tx_buffer_size) {
+        // Host or line can't keep up, drop instead of blocking the caller
+        link_stats.dropped_frames++;
+        link_stats.dropped_bytes += frame_len;
+    } else {
+        written = uart_writev_locked(iov, sizeof(iov) / sizeof(iov[0]));
+        if(written) {
+            link_stats.frames++;
+        }
+    }
+    xSemaphoreGive(write_mutex);
+    return written;
 }
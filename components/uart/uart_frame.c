@@ -0,0 +1,135 @@
+#include "uart_frame.h"
+#include <string.h>
+
+//***************************************************************************************************************
+
+static void put_u16(uint8_t * out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static void put_u32(uint8_t * out, uint32_t value) {
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+    out[2] = (value >> 16) & 0xFF;
+    out[3] = value >> 24;
+}
+
+static uint16_t get_u16(const uint8_t * in) {
+    return in[0] | (in[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t * in) {
+    return in[0] | (in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+//***************************************************************************************************************
+
+uint16_t uart_frame_crc16(uint16_t crc, const uint8_t * data, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for(uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint16_t uart_frame_encode_header(uint8_t * out, const uart_frame_header_t * header) {
+    out[0] = UART_FRAME_SYNC_0;
+    out[1] = UART_FRAME_SYNC_1;
+    out[2] = header->stream;
+    out[3] = header->type;
+    put_u16(&out[4], header->seq);
+    put_u32(&out[6], header->timestamp);
+    put_u16(&out[10], header->len);
+
+    // Sync word is not covered
+    return uart_frame_crc16(0xFFFF, &out[2], UART_FRAME_HEADER_SIZE - 2);
+}
+
+void uart_frame_encode_crc(uint8_t * out, uint16_t crc) {
+    put_u16(out, crc);
+}
+
+size_t uart_frame_encode(uint8_t * out, size_t size, const uart_frame_header_t * header, const void * payload) {
+    if(!out || !header || header->len > UART_FRAME_MAX_PAYLOAD) return 0;
+
+    size_t frame_len = UART_FRAME_OVERHEAD + header->len;
+    if(frame_len > size) return 0;
+
+    uint16_t crc = uart_frame_encode_header(out, header);
+    if(header->len) {
+        memcpy(&out[UART_FRAME_HEADER_SIZE], payload, header->len);
+        crc = uart_frame_crc16(crc, &out[UART_FRAME_HEADER_SIZE], header->len);
+    }
+    uart_frame_encode_crc(&out[UART_FRAME_HEADER_SIZE + header->len], crc);
+    return frame_len;
+}
+
+//***************************************************************************************************************
+
+void uart_frame_decoder_init(uart_frame_decoder_t * decoder) {
+    memset(decoder, 0, sizeof(uart_frame_decoder_t));
+}
+
+static void uart_frame_decoder_drop(uart_frame_decoder_t * decoder, size_t count) {
+    decoder->len -= count;
+    memmove(decoder->buffer, &decoder->buffer[count], decoder->len);
+}
+
+uart_frame_status_e uart_frame_decoder_push(uart_frame_decoder_t * decoder, uint8_t byte) {
+    uart_frame_status_e status = UART_FRAME_NONE;
+
+    // Last frame handed out is no longer needed
+    if(decoder->consumed) {
+        uart_frame_decoder_drop(decoder, decoder->consumed);
+        decoder->consumed = 0;
+        decoder->payload = NULL;
+    }
+    decoder->buffer[decoder->len++] = byte;
+
+    while(decoder->len) {
+        // Skip to the next sync word
+        size_t skip = 0;
+        while(skip < decoder->len && !(decoder->buffer[skip] == UART_FRAME_SYNC_0 &&
+                (skip + 1 == decoder->len || decoder->buffer[skip + 1] == UART_FRAME_SYNC_1))) {
+            skip++;
+        }
+        if(skip) uart_frame_decoder_drop(decoder, skip);
+
+        if(decoder->len < UART_FRAME_HEADER_SIZE) break;
+
+        size_t payload_len = get_u16(&decoder->buffer[10]);
+        if(payload_len > UART_FRAME_MAX_PAYLOAD) {
+            // Not a frame start, try from the next byte
+            decoder->len_errors++;
+            status = UART_FRAME_LEN_ERROR;
+            uart_frame_decoder_drop(decoder, 1);
+            continue;
+        }
+
+        size_t frame_len = UART_FRAME_OVERHEAD + payload_len;
+        if(decoder->len < frame_len) break;
+
+        uint16_t crc = uart_frame_crc16(0xFFFF, &decoder->buffer[2], UART_FRAME_HEADER_SIZE - 2 + payload_len);
+        if(crc != get_u16(&decoder->buffer[UART_FRAME_HEADER_SIZE + payload_len])) {
+            // Bytes after the false start may hold frames, resync inside them
+            decoder->crc_errors++;
+            status = UART_FRAME_CRC_ERROR;
+            uart_frame_decoder_drop(decoder, 1);
+            continue;
+        }
+
+        decoder->header.stream = decoder->buffer[2];
+        decoder->header.type = decoder->buffer[3];
+        decoder->header.seq = get_u16(&decoder->buffer[4]);
+        decoder->header.timestamp = get_u32(&decoder->buffer[6]);
+        decoder->header.len = payload_len;
+        decoder->payload = &decoder->buffer[UART_FRAME_HEADER_SIZE];
+        decoder->consumed = frame_len;
+        decoder->frames++;
+        return UART_FRAME_READY;
+    }
+    return status;
+}
@@ -0,0 +1,173 @@
+#include "esp_dsp.h"
+#include <math.h>
+
+// Twiddles of the largest transform, cos and sin pairs in bit reversed order
+static float w_fc32[HOST_DSP_MAX_FFT_SIZE];
+static int w_fc32_size = 0;
+static int16_t w_sc16[HOST_DSP_MAX_FFT_SIZE];
+static int w_sc16_size = 0;
+
+//******************************************************************************************************************
+
+static int bit_reverse(int index, int n) {
+    int result = 0;
+    for(int bit = 1; bit < n; bit <<= 1) {
+        result = (result << 1) | (index & 1);
+        index >>= 1;
+    }
+    return result;
+}
+
+static int valid_size(int n, int table_size) {
+    return n >= 2 && n <= table_size && (n & (n - 1)) == 0;
+}
+
+//******************************************************************************************************************
+
+esp_err_t dsps_fft2r_init_fc32(float * fft_table_buff, int table_size) {
+    if(fft_table_buff || !valid_size(table_size, HOST_DSP_MAX_FFT_SIZE)) return ESP_ERR_INVALID_ARG;
+
+    int half = table_size / 2;
+    for(int i = 0; i < half; i++) {
+        int k = bit_reverse(i, half);
+        w_fc32[2 * k + 0] = cosf(2 * M_PI * i / table_size);
+        w_fc32[2 * k + 1] = sinf(2 * M_PI * i / table_size);
+    }
+    w_fc32_size = table_size;
+    return ESP_OK;
+}
+
+esp_err_t dsps_fft2r_fc32(float * data, int N) {
+    if(!valid_size(N, w_fc32_size)) return ESP_ERR_INVALID_ARG;
+
+    int ie = 1;
+    for(int N2 = N / 2; N2 > 0; N2 >>= 1) {
+        int ia = 0;
+        for(int j = 0; j < ie; j++) {
+            float c = w_fc32[2 * j + 0];
+            float s = w_fc32[2 * j + 1];
+            for(int i = 0; i < N2; i++) {
+                int m = ia + N2;
+                float re = c * data[2 * m] + s * data[2 * m + 1];
+                float im = c * data[2 * m + 1] - s * data[2 * m];
+                data[2 * m] = data[2 * ia] - re;
+                data[2 * m + 1] = data[2 * ia + 1] - im;
+                data[2 * ia] = data[2 * ia] + re;
+                data[2 * ia + 1] = data[2 * ia + 1] + im;
+                ia++;
+            }
+            ia += N2;
+        }
+        ie <<= 1;
+    }
+    return ESP_OK;
+}
+
+esp_err_t dsps_bit_rev_fc32(float * data, int N) {
+    for(int i = 0; i < N; i++) {
+        int j = bit_reverse(i, N);
+        if(j > i) {
+            float re = data[2 * i], im = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = re;
+            data[2 * j + 1] = im;
+        }
+    }
+    return ESP_OK;
+}
+
+// Z = FFT(x1 + j*x2) in, X1[0..N/2) out in the first half and X2[0..N/2) in the second.
+// Bins k and N/2-k read and write the same four slots, so they are split together.
+esp_err_t dsps_cplx2reC_fc32(float * data, int N) {
+    if(N <= 2 || (N & (N - 1)) != 0) return ESP_ERR_INVALID_ARG;
+
+    int half = N / 2;
+    // DC of both signals is real
+    data[2 * half] = data[1];
+    data[2 * half + 1] = 0;
+    data[1] = 0;
+
+    for(int k = 1; k <= half / 2; k++) {
+        // Z[k], Z[N-k] give bin k, Z[N/2-k], Z[N/2+k] give bin N/2-k
+        int bin[2] = { k, half - k };
+        float re[4] = { data[2 * k], data[2 * (N - k)], data[2 * (half - k)], data[2 * (half + k)] };
+        float im[4] = { data[2 * k + 1], data[2 * (N - k) + 1], data[2 * (half - k) + 1], data[2 * (half + k) + 1] };
+        // X1 = (Z[k] + conj(Z[N-k])) / 2, X2 = (Z[k] - conj(Z[N-k])) / 2j
+        for(int i = 0; i < 2; i++) {
+            float a_re = re[2 * i], a_im = im[2 * i];
+            float b_re = re[2 * i + 1], b_im = im[2 * i + 1];
+            data[2 * bin[i]] = 0.5f * (a_re + b_re);
+            data[2 * bin[i] + 1] = 0.5f * (a_im - b_im);
+            data[2 * (half + bin[i])] = 0.5f * (a_im + b_im);
+            data[2 * (half + bin[i]) + 1] = 0.5f * (b_re - a_re);
+        }
+    }
+    return ESP_OK;
+}
+
+//******************************************************************************************************************
+
+esp_err_t dsps_fft2r_init_sc16(int16_t * fft_table_buff, int table_size) {
+    if(fft_table_buff || !valid_size(table_size, HOST_DSP_MAX_FFT_SIZE)) return ESP_ERR_INVALID_ARG;
+
+    int half = table_size / 2;
+    for(int i = 0; i < half; i++) {
+        int k = bit_reverse(i, half);
+        w_sc16[2 * k + 0] = (int16_t)lround(INT16_MAX * cos(2 * M_PI * i / table_size));
+        w_sc16[2 * k + 1] = (int16_t)lround(INT16_MAX * sin(2 * M_PI * i / table_size));
+    }
+    w_sc16_size = table_size;
+    return ESP_OK;
+}
+
+esp_err_t dsps_fft2r_sc16(int16_t * data, int N) {
+    if(!valid_size(N, w_sc16_size)) return ESP_ERR_INVALID_ARG;
+
+    int ie = 1;
+    for(int N2 = N / 2; N2 > 0; N2 >>= 1) {
+        int ia = 0;
+        for(int j = 0; j < ie; j++) {
+            int32_t c = w_sc16[2 * j + 0];
+            int32_t s = w_sc16[2 * j + 1];
+            for(int i = 0; i < N2; i++) {
+                int m = ia + N2;
+                // Butterfly in Q15 with one bit of headroom taken per stage, rounded
+                int64_t re = (int64_t)c * data[2 * m] + (int64_t)s * data[2 * m + 1];
+                int64_t im = (int64_t)c * data[2 * m + 1] - (int64_t)s * data[2 * m];
+                int64_t a_re = (int64_t)data[2 * ia] << 15;
+                int64_t a_im = (int64_t)data[2 * ia + 1] << 15;
+                data[2 * m] = (int16_t)((a_re - re + (1 << 15)) >> 16);
+                data[2 * m + 1] = (int16_t)((a_im - im + (1 << 15)) >> 16);
+                data[2 * ia] = (int16_t)((a_re + re + (1 << 15)) >> 16);
+                data[2 * ia + 1] = (int16_t)((a_im + im + (1 << 15)) >> 16);
+                ia++;
+            }
+            ia += N2;
+        }
+        ie <<= 1;
+    }
+    return ESP_OK;
+}
+
+esp_err_t dsps_bit_rev_sc16_ansi(int16_t * data, int N) {
+    for(int i = 0; i < N; i++) {
+        int j = bit_reverse(i, N);
+        if(j > i) {
+            int16_t re = data[2 * i], im = data[2 * i + 1];
+            data[2 * i] = data[2 * j];
+            data[2 * i + 1] = data[2 * j + 1];
+            data[2 * j] = re;
+            data[2 * j + 1] = im;
+        }
+    }
+    return ESP_OK;
+}
+
+//******************************************************************************************************************
+
+void dsps_wind_hann_f32(float * window, int len) {
+    for(int i = 0; i < len; i++) {
+        window[i] = 0.5 - 0.5 * cos(2 * M_PI * i / (len - 1));
+    }
+}
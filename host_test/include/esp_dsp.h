@@ -0,0 +1,26 @@
+#ifndef _HOST_ESP_DSP_H_
+#define _HOST_ESP_DSP_H_
+
+/* Stand-in for the esp-dsp functions the mic spectrum uses, following the
+   esp-dsp ANSI reference: radix-2 FFT over a bit reversed twiddle table,
+   output in bit reversed order, the sc16 FFT scaling every stage by 1/2. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define HOST_DSP_MAX_FFT_SIZE       4096
+
+esp_err_t dsps_fft2r_init_fc32(float * fft_table_buff, int table_size);
+esp_err_t dsps_fft2r_fc32(float * data, int N);
+esp_err_t dsps_bit_rev_fc32(float * data, int N);
+esp_err_t dsps_cplx2reC_fc32(float * data, int N);
+
+esp_err_t dsps_fft2r_init_sc16(int16_t * fft_table_buff, int table_size);
+esp_err_t dsps_fft2r_sc16(int16_t * data, int N);
+esp_err_t dsps_bit_rev_sc16_ansi(int16_t * data, int N);
+
+void dsps_wind_hann_f32(float * window, int len);
+
+#endif //_HOST_ESP_DSP_H_
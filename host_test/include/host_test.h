@@ -0,0 +1,25 @@
+#ifndef _HOST_TEST_H_
+#define _HOST_TEST_H_
+
+#include <stdio.h>
+
+/* Minimal test helpers, a failed check is reported and the run goes on */
+
+static int host_test_failures = 0;
+
+#define TEST_CHECK(cond) do { \
+        if(!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            host_test_failures++; \
+        } \
+    } while(0)
+
+#define TEST_RUN(test) do { \
+        int before = host_test_failures; \
+        test(); \
+        printf("%-40s %s\n", #test, host_test_failures == before ? "ok" : "FAILED"); \
+    } while(0)
+
+#define TEST_RESULT()   (host_test_failures ? 1 : 0)
+
+#endif //_HOST_TEST_H_
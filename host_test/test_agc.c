@@ -0,0 +1,204 @@
+/**
+ * @file test_agc.c
+ *
+ * @brief AGC test vectors: 0 dB scaling, attack and release step responses, gate hold.
+ *
+ * Input is a sine at a given level below the I2S full scale, in blocks of
+ * AGC_TEST_BLOCK samples at 16 kHz.
+ */
+
+#include "agc.h"
+#include "host_test.h"
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define AGC_TEST_RATE       16000.0f
+#define AGC_TEST_BLOCK      256
+#define AGC_TEST_BLOCK_MS   (1000.0f * AGC_TEST_BLOCK / AGC_TEST_RATE)
+
+static int32_t block[AGC_TEST_BLOCK];
+static uint32_t phase = 0;
+
+//******************************************************************************************************************
+
+static void make_block(float level_dbfs) {
+    double amplitude = 2147483647.0 * pow(10.0, level_dbfs / 20.0);
+    for(int i = 0; i < AGC_TEST_BLOCK; i++) {
+        // 1 kHz, a whole number of periods per block so every block has the same peak
+        block[i] = (int32_t)lrint(amplitude * sin(2 * M_PI * (phase + i) / 16.0 + 0.1));
+    }
+    phase += AGC_TEST_BLOCK;
+}
+
+static float process(agc_t * agc, float level_dbfs, int blocks) {
+    for(int b = 0; b < blocks; b++) {
+        make_block(level_dbfs);
+        agc_process(agc, block, AGC_TEST_BLOCK);
+    }
+    return agc_get_gain_db(agc);
+}
+
+static float to_linear(float db) {
+    return powf(10.0f, db / 20.0f);
+}
+
+// Gain after a time t of one pole smoothing toward wanted, in dB
+static float expected_gain_db(float start_db, float wanted_db, float t_ms, float tau_ms) {
+    float start = to_linear(start_db);
+    float wanted = to_linear(wanted_db);
+    return 20.0f * log10f(wanted + (start - wanted) * expf(-t_ms / tau_ms));
+}
+
+static void init_default(agc_t * agc) {
+    agc_config_t config;
+    agc_get_default_config(&config);
+    TEST_CHECK(agc_init(agc, &config, AGC_TEST_RATE) == ESP_OK);
+}
+
+//******************************************************************************************************************
+
+static void test_init_rejects_bad_config(void) {
+    agc_t agc;
+    agc_config_t config;
+    agc_get_default_config(&config);
+    TEST_CHECK(agc_init(&agc, &config, 0) == ESP_ERR_INVALID_ARG);
+
+    config.min_gain_db = config.max_gain_db + 1;
+    TEST_CHECK(agc_init(&agc, &config, AGC_TEST_RATE) == ESP_ERR_INVALID_ARG);
+
+    agc_get_default_config(&config);
+    config.attack_ms = 0;
+    TEST_CHECK(agc_init(&agc, &config, AGC_TEST_RATE) == ESP_ERR_INVALID_ARG);
+}
+
+// Gain pinned at 0 dB is the old fixed >>5, give or take the float rounding of a 32 bit sample
+static void test_unity_gain_scaling(void) {
+    agc_t agc;
+    agc_config_t config;
+    agc_get_default_config(&config);
+    config.min_gain_db = 0;
+    config.max_gain_db = 0;
+    TEST_CHECK(agc_init(&agc, &config, AGC_TEST_RATE) == ESP_OK);
+
+    srand(3);
+    for(int b = 0; b < 8; b++) {
+        int32_t input[AGC_TEST_BLOCK];
+        for(int i = 0; i < AGC_TEST_BLOCK; i++) {
+            input[i] = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand());
+        }
+        input[0] = INT32_MIN;
+        input[1] = INT32_MAX;
+        memcpy(block, input, sizeof(block));
+        agc_process(&agc, block, AGC_TEST_BLOCK);
+
+        for(int i = 0; i < AGC_TEST_BLOCK; i++) {
+            int32_t expected = input[i] >> 5;
+            TEST_CHECK(abs(block[i] - expected) <= 1 + abs(expected) / (1 << 22));
+            TEST_CHECK(block[i] <= (int32_t)AGC_OUTPUT_FULL_SCALE && block[i] >= -(int32_t)AGC_OUTPUT_FULL_SCALE);
+        }
+    }
+    TEST_CHECK(fabsf(agc_get_gain_db(&agc)) < 1e-4f);
+}
+
+// Loud step: the gain drops toward target - level with the attack time constant
+static void test_attack_step(void) {
+    agc_t agc;
+    init_default(&agc);
+
+    const float level = -2.0f;
+    const float wanted = AGC_TARGET_DBFS - level;
+    const int blocks = 2;
+    float gain = process(&agc, level, blocks);
+    float expected = expected_gain_db(0, wanted, blocks * AGC_TEST_BLOCK_MS, AGC_ATTACK_MS);
+    printf("  after %.0f ms: %.2f dB, expected %.2f dB\n", blocks * AGC_TEST_BLOCK_MS, gain, expected);
+    TEST_CHECK(fabsf(gain - expected) < 0.1f);
+    TEST_CHECK(fabsf(agc_get_level_dbfs(&agc) - level) < 0.05f);
+
+    // Settled after a few time constants
+    gain = process(&agc, level, 10);
+    TEST_CHECK(fabsf(gain - wanted) < 0.05f);
+    TEST_CHECK(!agc.gated);
+}
+
+// Quiet step after settling: the gain rises with the release time constant, up to the maximum
+static void test_release_step(void) {
+    agc_t agc;
+    init_default(&agc);
+
+    const float loud = -6.0f;
+    float start = process(&agc, loud, 20);
+    TEST_CHECK(fabsf(start - (AGC_TARGET_DBFS - loud)) < 0.05f);
+
+    const float quiet = -50.0f;
+    const float wanted = AGC_MAX_GAIN_DB;
+    const int blocks = (int)(AGC_RELEASE_MS / AGC_TEST_BLOCK_MS);
+    float gain = process(&agc, quiet, blocks);
+    float expected = expected_gain_db(start, wanted, blocks * AGC_TEST_BLOCK_MS, AGC_RELEASE_MS);
+    printf("  after %.0f ms: %.2f dB, expected %.2f dB\n", blocks * AGC_TEST_BLOCK_MS, gain, expected);
+    TEST_CHECK(fabsf(gain - expected) < 0.1f);
+
+    // One release time constant in, still well short of the maximum
+    TEST_CHECK(gain < wanted - 1.0f);
+    gain = process(&agc, quiet, 10 * blocks);
+    TEST_CHECK(fabsf(gain - wanted) < 0.05f);
+}
+
+// Blocks under the gate keep whatever gain was reached, silence is not pumped up
+static void test_gate_hold(void) {
+    agc_t agc;
+    init_default(&agc);
+
+    float held = process(&agc, -20.0f, 20);
+    float gain = process(&agc, AGC_GATE_DBFS - 10.0f, 200);
+    TEST_CHECK(agc.gated);
+    TEST_CHECK(fabsf(gain - held) < 1e-4f);
+
+    // Signal back above the gate, the gain moves again
+    gain = process(&agc, -40.0f, 20);
+    TEST_CHECK(!agc.gated);
+    TEST_CHECK(gain > held + 0.5f);
+}
+
+// The gain is ramped over the block, no step at the block boundary
+static void test_gain_ramp(void) {
+    agc_t agc;
+    init_default(&agc);
+
+    int32_t input[AGC_TEST_BLOCK];
+    for(int i = 0; i < AGC_TEST_BLOCK; i++) input[i] = 1 << 28;
+    memcpy(block, input, sizeof(block));
+    agc_process(&agc, block, AGC_TEST_BLOCK);
+
+    // -18 dBFS in, so the gain rises: first sample close to the 0 dB start, last one at the new gain
+    float first = (float)block[0] / (input[0] >> 5);
+    float last = (float)block[AGC_TEST_BLOCK - 1] / (input[0] >> 5);
+    TEST_CHECK(fabsf(first - 1.0f) < 0.05f);
+    TEST_CHECK(fabsf(20.0f * log10f(last) - agc_get_gain_db(&agc)) < 0.05f);
+    for(int i = 1; i < AGC_TEST_BLOCK; i++) {
+        TEST_CHECK(block[i] >= block[i - 1]);
+    }
+}
+
+// For a sine the RMS detector reads 3 dB below the peak one
+static void test_rms_detector(void) {
+    agc_t agc;
+    agc_config_t config;
+    agc_get_default_config(&config);
+    config.detector = AGC_DETECTOR_RMS;
+    TEST_CHECK(agc_init(&agc, &config, AGC_TEST_RATE) == ESP_OK);
+
+    process(&agc, -10.0f, 1);
+    TEST_CHECK(fabsf(agc_get_level_dbfs(&agc) - (-10.0f - 3.01f)) < 0.05f);
+}
+
+int main(void) {
+    TEST_RUN(test_init_rejects_bad_config);
+    TEST_RUN(test_unity_gain_scaling);
+    TEST_RUN(test_attack_step);
+    TEST_RUN(test_release_step);
+    TEST_RUN(test_gate_hold);
+    TEST_RUN(test_gain_ramp);
+    TEST_RUN(test_rms_detector);
+    return TEST_RESULT();
+}
@@ -0,0 +1,289 @@
+/**
+ * @file test_ble_conn_policy.c
+ *
+ * @brief Connection parameter policy against a fake GAP.
+ *
+ * The fake GAP stands in for the BLE stack and the central: it records the
+ * update requests the policy sends, can fail sending them, and answers the
+ * way a given central would, by feeding ble_conn_policy_on_update() back.
+ */
+
+#include "ble_conn_policy.h"
+#include "host_test.h"
+#include <string.h>
+
+#define GAP_LOG_LEN         16
+
+typedef enum {
+    CENTRAL_ACCEPTS = 0,            // Settles on the largest interval of the range
+    CENTRAL_REJECTS,                // Refuses every request
+    CENTRAL_FIXED,                  // Accepts but stays on its own interval
+    CENTRAL_SILENT,                 // Never answers
+} central_e;
+
+typedef struct {
+    central_e central;
+    uint16_t fixed_interval;        // Interval used by CENTRAL_FIXED
+    uint16_t min_supported;         // CENTRAL_ACCEPTS refuses ranges ending below this interval
+    int send_failures;              // Next requests that fail to send
+    ble_conn_params_t log[GAP_LOG_LEN];
+    uint32_t sent;
+    uint32_t failed;
+    bool answer_pending;
+} fake_gap_t;
+
+static fake_gap_t gap;
+static ble_conn_policy_t policy;
+
+//******************************************************************************************************************
+
+static esp_err_t gap_request(void * ctx, const ble_conn_params_t * params) {
+    TEST_CHECK(ctx == &gap);
+    if(gap.send_failures > 0) {
+        gap.send_failures--;
+        gap.failed++;
+        return ESP_FAIL;
+    }
+    if(gap.sent < GAP_LOG_LEN) {
+        gap.log[gap.sent] = *params;
+    }
+    gap.sent++;
+    gap.answer_pending = true;
+    return ESP_OK;
+}
+
+static const ble_conn_policy_backend_t gap_backend = {
+    .request = gap_request,
+    .ctx = &gap,
+};
+
+// Deliver the central's answer to the last request, the way the GAP event handler does
+static bool gap_answer(void) {
+    if(!gap.answer_pending || gap.sent == 0) return false;
+    gap.answer_pending = false;
+
+    const ble_conn_params_t * request = &gap.log[(gap.sent - 1) % GAP_LOG_LEN];
+    switch(gap.central) {
+        case CENTRAL_ACCEPTS:
+            if(request->max_int < gap.min_supported) {
+                ble_conn_policy_on_update(&policy, false, 0, 0, 0);
+            } else {
+                ble_conn_policy_on_update(&policy, true, request->max_int, request->latency, request->timeout);
+            }
+            break;
+        case CENTRAL_REJECTS:
+            ble_conn_policy_on_update(&policy, false, 0, 0, 0);
+            break;
+        case CENTRAL_FIXED:
+            ble_conn_policy_on_update(&policy, true, gap.fixed_interval, 0, request->timeout);
+            break;
+        case CENTRAL_SILENT:
+            return false;
+    }
+    return true;
+}
+
+static void gap_answer_all(void) {
+    while(gap_answer()) {}
+}
+
+static void gap_connect(central_e central, uint16_t interval) {
+    memset(&gap, 0, sizeof(gap));
+    gap.central = central;
+    TEST_CHECK(ble_conn_policy_init(&policy, &gap_backend) == ESP_OK);
+    ble_conn_policy_on_connect(&policy, interval, 0, 500);
+}
+
+static bool same_params(const ble_conn_params_t * a, const ble_conn_params_t * b) {
+    return a->min_int == b->min_int && a->max_int == b->max_int && a->latency == b->latency && a->timeout == b->timeout;
+}
+
+//******************************************************************************************************************
+
+static void test_init_rejects_missing_backend(void) {
+    ble_conn_policy_backend_t backend = { 0 };
+    TEST_CHECK(ble_conn_policy_init(&policy, NULL) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(ble_conn_policy_init(&policy, &backend) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(ble_conn_policy_init(NULL, &gap_backend) == ESP_ERR_INVALID_ARG);
+}
+
+// Low latency table: ranges get longer, latency stays 0
+static void test_step_table(void) {
+    uint8_t count = ble_conn_policy_step_count();
+    TEST_CHECK(count > 1);
+    TEST_CHECK(ble_conn_policy_step(0)->min_int == 6 && ble_conn_policy_step(0)->max_int == 12);
+    for(uint8_t i = 0; i < count; i++) {
+        const ble_conn_params_t * step = ble_conn_policy_step(i);
+        TEST_CHECK(step->min_int <= step->max_int);
+        TEST_CHECK(step->latency == 0);
+        TEST_CHECK(step->timeout == BLE_CONN_POLICY_TIMEOUT);
+        if(i > 0) TEST_CHECK(step->max_int >= ble_conn_policy_step(i - 1)->max_int);
+    }
+    TEST_CHECK(ble_conn_policy_step(count) == NULL);
+
+    TEST_CHECK(strcmp(ble_conn_policy_state_to_string(BLE_CONN_POLICY_ACCEPTED), "accepted") == 0);
+    TEST_CHECK(strcmp(ble_conn_policy_state_to_string(BLE_CONN_POLICY_MAX), "unknown") == 0);
+}
+
+// Central takes the first request
+static void test_acceptance(void) {
+    gap_connect(CENTRAL_ACCEPTS, 24);
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_REQUESTED);
+    TEST_CHECK(gap.sent == 1);
+    TEST_CHECK(same_params(&gap.log[0], ble_conn_policy_step(0)));
+    // Connect parameters are kept until the central answers
+    TEST_CHECK(policy.interval == 24 && policy.timeout == 500);
+
+    gap_answer_all();
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_ACCEPTED);
+    TEST_CHECK(policy.step == 0);
+    TEST_CHECK(policy.interval == 12 && policy.latency == 0 && policy.timeout == BLE_CONN_POLICY_TIMEOUT);
+    TEST_CHECK(policy.stats.requests == 1 && policy.stats.rejections == 0 && policy.stats.updates == 1);
+    TEST_CHECK(gap.sent == 1);
+}
+
+// Every refusal moves one step down, the central's own parameters are kept at the end
+static void test_rejection_walk_down(void) {
+    gap_connect(CENTRAL_REJECTS, 40);
+    gap_answer_all();
+
+    uint8_t count = ble_conn_policy_step_count();
+    TEST_CHECK(gap.sent == count);
+    for(uint8_t i = 0; i < count; i++) {
+        TEST_CHECK(same_params(&gap.log[i], ble_conn_policy_step(i)));
+    }
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_GAVE_UP);
+    TEST_CHECK(policy.interval == 40 && policy.timeout == 500);
+    TEST_CHECK(policy.stats.requests == count && policy.stats.rejections == count && policy.stats.updates == 0);
+}
+
+// A central that supports only longer intervals settles on the first step it can do
+static void test_walk_down_to_supported_step(void) {
+    gap_connect(CENTRAL_ACCEPTS, 40);
+    gap.min_supported = 20;
+    gap_answer_all();
+
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_ACCEPTED);
+    TEST_CHECK(policy.step == 2);
+    TEST_CHECK(policy.interval == ble_conn_policy_step(2)->max_int);
+    TEST_CHECK(policy.stats.rejections == 2);
+}
+
+// Accepted, but on an interval outside the requested range: counts as a rejection
+static void test_out_of_range_answer(void) {
+    gap_connect(CENTRAL_FIXED, 40);
+    gap.fixed_interval = 30;
+    TEST_CHECK(gap_answer());
+
+    // 37.5 ms is outside 7.5 - 15 ms, the next step goes out and the interval is recorded
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_REQUESTED);
+    TEST_CHECK(policy.step == 1);
+    TEST_CHECK(policy.interval == 30);
+    TEST_CHECK(policy.stats.rejections == 1 && policy.stats.updates == 1);
+
+    // It lands inside the 30 - 50 ms step eventually
+    gap_answer_all();
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_ACCEPTED);
+    TEST_CHECK(policy.step == 3);
+    TEST_CHECK(policy.stats.requests == 4 && policy.stats.rejections == 3);
+
+    // A latency above the step's is out of range too
+    gap_connect(CENTRAL_SILENT, 40);
+    ble_conn_policy_on_update(&policy, true, 10, 4, 400);
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_REQUESTED && policy.step == 1);
+    TEST_CHECK(policy.latency == 4);
+}
+
+// A request the stack fails to send is a rejection, the next step goes out right away
+static void test_send_failure(void) {
+    memset(&gap, 0, sizeof(gap));
+    gap.central = CENTRAL_ACCEPTS;
+    gap.send_failures = 2;
+    TEST_CHECK(ble_conn_policy_init(&policy, &gap_backend) == ESP_OK);
+    ble_conn_policy_on_connect(&policy, 40, 0, 500);
+
+    TEST_CHECK(gap.failed == 2 && gap.sent == 1);
+    TEST_CHECK(same_params(&gap.log[0], ble_conn_policy_step(2)));
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_REQUESTED && policy.step == 2);
+    TEST_CHECK(policy.stats.requests == 3 && policy.stats.rejections == 2);
+
+    gap_answer_all();
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_ACCEPTED && policy.step == 2);
+
+    // Nothing can be sent at all
+    memset(&gap, 0, sizeof(gap));
+    gap.send_failures = ble_conn_policy_step_count();
+    TEST_CHECK(ble_conn_policy_init(&policy, &gap_backend) == ESP_OK);
+    ble_conn_policy_on_connect(&policy, 40, 0, 500);
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_GAVE_UP);
+    TEST_CHECK(gap.sent == 0);
+    TEST_CHECK(policy.interval == 40);
+}
+
+// Updates the central starts after the negotiation are recorded, not answered with requests
+static void test_central_initiated_update(void) {
+    gap_connect(CENTRAL_ACCEPTS, 24);
+    gap_answer_all();
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_ACCEPTED);
+
+    ble_conn_policy_on_update(&policy, true, 36, 2, 600);
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_ACCEPTED);
+    TEST_CHECK(policy.interval == 36 && policy.latency == 2 && policy.timeout == 600);
+    TEST_CHECK(policy.stats.updates == 2);
+    TEST_CHECK(gap.sent == 1);
+
+    // Same after giving up
+    gap_connect(CENTRAL_REJECTS, 40);
+    gap_answer_all();
+    ble_conn_policy_on_update(&policy, true, 8, 0, 400);
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_GAVE_UP);
+    TEST_CHECK(policy.interval == 8);
+    TEST_CHECK(gap.sent == ble_conn_policy_step_count());
+}
+
+// Disconnect forgets the link, the next connection starts from the top of the table
+static void test_disconnect_reset(void) {
+    gap_connect(CENTRAL_REJECTS, 40);
+    gap_answer_all();
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_GAVE_UP);
+
+    ble_conn_policy_on_disconnect(&policy);
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_IDLE);
+    TEST_CHECK(policy.step == 0 && policy.interval == 0 && policy.latency == 0 && policy.timeout == 0);
+
+    // Late answers while disconnected change nothing
+    ble_conn_policy_on_update(&policy, true, 6, 0, 400);
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_IDLE && policy.interval == 0);
+
+    // Statistics run across connections
+    uint32_t requests = policy.stats.requests;
+    gap.central = CENTRAL_ACCEPTS;
+    gap.sent = 0;
+    ble_conn_policy_on_connect(&policy, 24, 0, 500);
+    TEST_CHECK(gap.sent == 1 && same_params(&gap.log[0], ble_conn_policy_step(0)));
+    gap_answer_all();
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_ACCEPTED && policy.interval == 12);
+    TEST_CHECK(policy.stats.requests == requests + 1);
+
+    // Disconnect with a request in flight
+    ble_conn_policy_on_disconnect(&policy);
+    gap.central = CENTRAL_SILENT;
+    ble_conn_policy_on_connect(&policy, 24, 0, 500);
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_REQUESTED);
+    ble_conn_policy_on_disconnect(&policy);
+    ble_conn_policy_on_update(&policy, false, 0, 0, 0);
+    TEST_CHECK(policy.state == BLE_CONN_POLICY_IDLE && policy.step == 0);
+}
+
+int main(void) {
+    TEST_RUN(test_init_rejects_missing_backend);
+    TEST_RUN(test_step_table);
+    TEST_RUN(test_acceptance);
+    TEST_RUN(test_rejection_walk_down);
+    TEST_RUN(test_walk_down_to_supported_step);
+    TEST_RUN(test_out_of_range_answer);
+    TEST_RUN(test_send_failure);
+    TEST_RUN(test_central_initiated_update);
+    TEST_RUN(test_disconnect_reset);
+    return TEST_RESULT();
+}
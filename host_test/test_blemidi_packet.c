@@ -0,0 +1,348 @@
+/**
+ * @file test_blemidi_packet.c
+ *
+ * @brief BLE-MIDI packet builder against a strict reference parser.
+ *
+ * The reference parser follows the BLE-MIDI packet layout but is stricter
+ * than the spec about running status: it never carries it into the next
+ * packet and drops it on any system message, realtime included. That is
+ * what the builder promises, so a parser of either kind reads its packets.
+ *
+ * The round trip sends random batches of channel, system common and
+ * realtime messages with the driver's flush timing and compares what the
+ * parser reads, timestamps included, with what was sent.
+ */
+
+#include "blemidi_packet.h"
+#include "host_test.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CAPTURE_PACKETS     8192
+#define STREAM_SIZE         (1 << 20)
+#define FLUSH_MS            15      // BLEMIDI_OUTBUFFER_FLUSH_MS
+
+typedef struct {
+    uint8_t data[BLEMIDI_PACKET_MAX_LEN];
+    size_t len;
+} captured_packet_t;
+
+static captured_packet_t packets[CAPTURE_PACKETS];
+static uint32_t packet_count;
+static size_t largest_packet;
+
+static blemidi_packet_t builder;
+
+static void capture(void * ctx, const uint8_t * packet, size_t len) {
+    TEST_CHECK(len <= BLEMIDI_PACKET_MAX_LEN);
+    if(len > largest_packet) largest_packet = len;
+    if(packet_count < CAPTURE_PACKETS) {
+        memcpy(packets[packet_count].data, packet, len);
+        packets[packet_count].len = len;
+        packet_count++;
+    }
+}
+
+static const blemidi_packet_backend_t capture_backend = {
+    .send = capture,
+};
+
+static void reset(size_t mtu) {
+    packet_count = 0;
+    largest_packet = 0;
+    TEST_CHECK(blemidi_packet_init(&builder, &capture_backend, mtu) == ESP_OK);
+}
+
+static bool packet_is(uint32_t index, const uint8_t * expected, size_t len) {
+    return index < packet_count && packets[index].len == len && memcmp(packets[index].data, expected, len) == 0;
+}
+
+//******************************************************************************************************************
+// Reference parser
+//******************************************************************************************************************
+
+// Messages as read back: timestamp (2 bytes, little endian) then the full message with its status
+static uint8_t parsed[STREAM_SIZE];
+static size_t parsed_len;
+
+static size_t message_len(uint8_t status) {
+    switch(status & 0xF0) {
+        case 0xC0:
+        case 0xD0:
+            return 2;
+        case 0xF0:
+            switch(status) {
+                case 0xF1:
+                case 0xF3:
+                    return 2;
+                case 0xF2:
+                    return 3;
+                default:
+                    return 1;
+            }
+        default:
+            return 3;
+    }
+}
+
+// False if the packet is malformed for a strict parser
+static bool reference_parse(const uint8_t * packet, size_t len) {
+    if(len < 3 || (packet[0] & 0xC0) != 0x80) return false;
+
+    uint16_t high = packet[0] & 0x3F;
+    uint8_t last_low = 0;
+    bool first = true;
+    uint8_t running = 0;
+    size_t pos = 1;
+
+    while(pos < len) {
+        // timestampLow, a wrap of the low part carries into the high one
+        if(!(packet[pos] & 0x80)) return false;
+        uint8_t low = packet[pos++] & 0x7F;
+        if(!first && low < last_low) high = (high + 1) & 0x3F;
+        last_low = low;
+        first = false;
+        if(pos >= len) return false;
+
+        uint8_t message[3];
+        if(packet[pos] & 0x80) {
+            message[0] = packet[pos++];
+        } else if(running) {
+            message[0] = running;
+        } else {
+            return false;
+        }
+
+        size_t data_len = message_len(message[0]) - 1;
+        if(pos + data_len > len) return false;
+        for(size_t i = 0; i < data_len; i++) {
+            if(packet[pos] & 0x80) return false;
+            message[1 + i] = packet[pos++];
+        }
+
+        running = message[0] < 0xF0 ? message[0] : 0;
+
+        uint16_t timestamp = (high << 7) | low;
+        parsed[parsed_len++] = timestamp & 0xFF;
+        parsed[parsed_len++] = timestamp >> 8;
+        memcpy(&parsed[parsed_len], message, data_len + 1);
+        parsed_len += data_len + 1;
+    }
+    return true;
+}
+
+//******************************************************************************************************************
+
+static void test_init_rejects_bad_args(void) {
+    blemidi_packet_backend_t backend = { 0 };
+    TEST_CHECK(blemidi_packet_init(&builder, &backend, 20) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(blemidi_packet_init(&builder, &capture_backend, 2) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(blemidi_packet_init(&builder, &capture_backend, BLEMIDI_PACKET_MAX_LEN + 1) == ESP_ERR_INVALID_ARG);
+
+    reset(20);
+    blemidi_packet_set_mtu(&builder, 1000);
+    TEST_CHECK(builder.mtu == BLEMIDI_PACKET_MAX_LEN);
+    blemidi_packet_set_mtu(&builder, 0);
+    TEST_CHECK(builder.mtu == 3);
+
+    uint8_t cc[3] = { 0xB0, 0x10, 0x00 };
+    TEST_CHECK(blemidi_packet_push(&builder, 0, cc, 0) == ESP_ERR_INVALID_ARG);
+}
+
+static void test_running_status(void) {
+    reset(20);
+    uint8_t cc[3] = { 0xB0, 0x10, 0x01 };
+    uint8_t other[3] = { 0xB1, 0x10, 0x03 };
+    blemidi_packet_push(&builder, 0x0081, cc, 3);
+    cc[2] = 0x02;
+    blemidi_packet_push(&builder, 0x0082, cc, 3);
+    blemidi_packet_push(&builder, 0x0083, other, 3);
+    blemidi_packet_flush(&builder);
+
+    // Repeat goes out without its status, a new status in full
+    const uint8_t expected[] = { 0x81, 0x81, 0xB0, 0x10, 0x01, 0x82, 0x10, 0x02, 0x83, 0xB1, 0x10, 0x03 };
+    TEST_CHECK(packet_count == 1);
+    TEST_CHECK(packet_is(0, expected, sizeof(expected)));
+}
+
+static void test_running_status_reset_on_flush(void) {
+    reset(20);
+    uint8_t cc[3] = { 0xB0, 0x10, 0x01 };
+    blemidi_packet_push(&builder, 0, cc, 3);
+    blemidi_packet_flush(&builder);
+    blemidi_packet_push(&builder, 0, cc, 3);
+    blemidi_packet_flush(&builder);
+
+    // Empty flush sends nothing
+    blemidi_packet_flush(&builder);
+
+    const uint8_t expected[] = { 0x80, 0x80, 0xB0, 0x10, 0x01 };
+    TEST_CHECK(packet_count == 2);
+    TEST_CHECK(packet_is(0, expected, sizeof(expected)));
+    TEST_CHECK(packet_is(1, expected, sizeof(expected)));
+}
+
+static void test_running_status_reset_on_system(void) {
+    static const uint8_t system[][3] = {
+        { 0xF8 },                   // Clock, realtime
+        { 0xFE },                   // Active sensing, realtime
+        { 0xF3, 0x05 },             // Song select, system common
+        { 0xF6 },                   // Tune request, system common
+    };
+
+    for(size_t i = 0; i < sizeof(system) / sizeof(system[0]); i++) {
+        reset(40);
+        uint8_t cc[3] = { 0xB0, 0x10, 0x01 };
+        size_t system_len = message_len(system[i][0]);
+        blemidi_packet_push(&builder, 0, cc, 3);
+        blemidi_packet_push(&builder, 0, system[i], system_len);
+        blemidi_packet_push(&builder, 0, cc, 3);
+        blemidi_packet_flush(&builder);
+
+        uint8_t expected[16] = { 0x80, 0x80, 0xB0, 0x10, 0x01, 0x80 };
+        size_t len = 6;
+        memcpy(&expected[len], system[i], system_len);
+        len += system_len;
+        const uint8_t tail[] = { 0x80, 0xB0, 0x10, 0x01 };
+        memcpy(&expected[len], tail, sizeof(tail));
+        len += sizeof(tail);
+
+        TEST_CHECK(packet_count == 1);
+        TEST_CHECK(packet_is(0, expected, len));
+    }
+}
+
+// A message that would reach the MTU starts a new packet, with its status in full
+static void test_packet_boundary(void) {
+    reset(20);
+    uint8_t cc[3] = { 0xB0, 0x10, 0x00 };
+    for(uint8_t i = 0; i < 6; i++) {
+        cc[2] = i;
+        blemidi_packet_push(&builder, 0, cc, 3);
+    }
+    blemidi_packet_flush(&builder);
+
+    // 2 + 3 for the first message, 3 for every repeat: 17 bytes, another one would make 20
+    const uint8_t first[] = { 0x80, 0x80, 0xB0, 0x10, 0x00, 0x80, 0x10, 0x01, 0x80, 0x10, 0x02,
+                              0x80, 0x10, 0x03, 0x80, 0x10, 0x04 };
+    const uint8_t second[] = { 0x80, 0x80, 0xB0, 0x10, 0x05 };
+    TEST_CHECK(packet_count == 2);
+    TEST_CHECK(packet_is(0, first, sizeof(first)));
+    TEST_CHECK(packet_is(1, second, sizeof(second)));
+}
+
+// Long SysEx: packets of up to MTU bytes, continuations only carry timestampHigh
+static void test_sysex_segments(void) {
+    const size_t mtu = 20;
+    reset(mtu);
+    uint8_t cc[3] = { 0xB0, 0x10, 0x00 };
+    uint8_t sysex[50];
+    sysex[0] = 0xF0;
+    for(size_t i = 1; i < sizeof(sysex) - 1; i++) sysex[i] = i;
+    sysex[sizeof(sysex) - 1] = 0xF7;
+
+    blemidi_packet_send(&builder, 0x0100, cc, 3);
+    blemidi_packet_send(&builder, 0x0100, sysex, sizeof(sysex));
+    blemidi_packet_send(&builder, 0x0100, cc, 3);
+    blemidi_packet_flush(&builder);
+
+    // Pending CC, two full SysEx segments, then the last one shares its packet with the next CC
+    const uint8_t tail_cc[] = { 0x80, 0xB0, 0x10, 0x00 };
+    TEST_CHECK(packet_count == 4);
+    if(packet_count != 4) return;
+
+    uint8_t joined[sizeof(sysex)];
+    size_t joined_len = 0;
+    for(uint32_t p = 1; p < 4; p++) {
+        size_t header = p == 1 ? 2 : 1;
+        size_t trailer = p == 3 ? sizeof(tail_cc) : 0;
+        TEST_CHECK(packets[p].len <= mtu);
+        TEST_CHECK(packets[p].data[0] == 0x82);
+        TEST_CHECK(p == 1 ? packets[p].data[1] == 0x80 && packets[p].data[2] == 0xF0 : packets[p].data[1] < 0x80);
+        memcpy(&joined[joined_len], &packets[p].data[header], packets[p].len - header - trailer);
+        joined_len += packets[p].len - header - trailer;
+    }
+    TEST_CHECK(joined_len == sizeof(sysex) && memcmp(joined, sysex, sizeof(sysex)) == 0);
+
+    // The CC after the SysEx carries its status, the flush before the segments ended running status
+    TEST_CHECK(memcmp(&packets[3].data[packets[3].len - sizeof(tail_cc)], tail_cc, sizeof(tail_cc)) == 0);
+}
+
+static size_t random_message(uint8_t * message) {
+    static const uint8_t statuses[] = { 0xB0, 0xB0, 0xB0, 0xB0, 0xB1, 0x90, 0x80, 0xC0, 0xD0, 0xE0,
+                                        0xF1, 0xF2, 0xF3, 0xF6, 0xF8, 0xFA, 0xFC, 0xFE };
+    message[0] = statuses[rand() % sizeof(statuses)];
+    size_t len = message_len(message[0]);
+    for(size_t i = 1; i < len; i++) message[i] = rand() & 0x7F;
+    return len;
+}
+
+// Driver timing: the 1 ms tick flushes when FLUSH_MS have passed since the last flush
+static void test_round_trip(void) {
+    static uint8_t sent[STREAM_SIZE];
+    size_t sent_len = 0;
+    static const size_t mtus[] = { 20, 40, BLEMIDI_PACKET_MAX_LEN - 3 };
+
+    srand(1);
+    for(size_t m = 0; m < sizeof(mtus) / sizeof(mtus[0]); m++) {
+        reset(mtus[m]);
+        sent_len = 0;
+        parsed_len = 0;
+        uint16_t timestamp = 0;
+        uint16_t last_flush = 0;
+        uint32_t messages = 0;
+
+        for(int batch = 0; batch < 2000; batch++) {
+            int count = 1 + rand() % 12;
+            for(int i = 0; i < count; i++) {
+                uint8_t message[3];
+                size_t len = random_message(message);
+                TEST_CHECK(blemidi_packet_send(&builder, timestamp, message, len) == ESP_OK);
+
+                uint16_t wire_timestamp = timestamp & 0x1FFF;
+                sent[sent_len++] = wire_timestamp & 0xFF;
+                sent[sent_len++] = wire_timestamp >> 8;
+                memcpy(&sent[sent_len], message, len);
+                sent_len += len;
+                messages++;
+            }
+
+            uint16_t elapsed = rand() % 8;
+            for(uint16_t t = 0; t < elapsed; t++) {
+                timestamp++;
+                if((uint16_t)(timestamp - last_flush) > FLUSH_MS) {
+                    blemidi_packet_flush(&builder);
+                    last_flush = timestamp;
+                }
+            }
+        }
+        blemidi_packet_flush(&builder);
+        TEST_CHECK(packet_count < CAPTURE_PACKETS);
+
+        size_t air = 0;
+        bool parsed_all = true;
+        for(uint32_t p = 0; p < packet_count; p++) {
+            TEST_CHECK(packets[p].len <= mtus[m]);
+            parsed_all &= reference_parse(packets[p].data, packets[p].len);
+            air += packets[p].len;
+        }
+        TEST_CHECK(parsed_all);
+        TEST_CHECK(parsed_len == sent_len);
+        TEST_CHECK(memcmp(parsed, sent, sent_len) == 0);
+        TEST_CHECK(largest_packet <= mtus[m]);
+        printf("  MTU %3zu: %u messages in %u packets, %zu bytes on air\n",
+            mtus[m], (unsigned)messages, (unsigned)packet_count, air);
+    }
+}
+
+int main(void) {
+    TEST_RUN(test_init_rejects_bad_args);
+    TEST_RUN(test_running_status);
+    TEST_RUN(test_running_status_reset_on_flush);
+    TEST_RUN(test_running_status_reset_on_system);
+    TEST_RUN(test_packet_boundary);
+    TEST_RUN(test_sysex_segments);
+    TEST_RUN(test_round_trip);
+    return TEST_RESULT();
+}
@@ -0,0 +1,96 @@
+/**
+ * @file test_fast_log.c
+ *
+ * @brief Error bound of fast_db10() against 10*log10f(), and a microbenchmark.
+ *
+ * The benchmark only reports, host timings say little about the target.
+ */
+
+#include "fast_log.h"
+#include "host_test.h"
+#include <math.h>
+#include <float.h>
+#include <time.h>
+
+#define FAST_LOG_MAX_ERROR_DB       0.003
+#define FAST_LOG_BENCH_LEN          4096
+#define FAST_LOG_BENCH_ROUNDS       2000
+
+static double db_error(float x) {
+    return fabs((double)fast_db10(x) - 10.0 * log10((double)x));
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//******************************************************************************************************************
+
+// Every mantissa step of one octave, the polynomial error repeats in all others
+static void test_error_one_octave(void) {
+    double max_error = 0;
+    for(uint32_t m = 0; m < (1u << 23); m++) {
+        union { float f; uint32_t u; } v = { .u = 0x3F800000 | m };
+        double error = db_error(v.f);
+        if(error > max_error) max_error = error;
+    }
+    printf("  max error in [1, 2): %.5f dB\n", max_error);
+    TEST_CHECK(max_error < FAST_LOG_MAX_ERROR_DB);
+}
+
+// Whole normal range, exponent term included
+static void test_error_normal_range(void) {
+    double max_error = 0;
+    for(float x = FLT_MIN; x < FLT_MAX / 1.001f; x *= 1.001f) {
+        double error = db_error(x);
+        if(error > max_error) max_error = error;
+    }
+    printf("  max error over normal floats: %.5f dB\n", max_error);
+    TEST_CHECK(max_error < FAST_LOG_MAX_ERROR_DB);
+}
+
+// Exact at powers of two, where the polynomial is evaluated at 0
+static void test_powers_of_two(void) {
+    for(int e = -126; e <= 127; e++) {
+        TEST_CHECK(db_error(ldexpf(1.0f, e)) < 1e-3);
+    }
+    TEST_CHECK(fabsf(fast_db10(1.0f)) < 1e-6f);
+}
+
+static void test_benchmark(void) {
+    static float input[FAST_LOG_BENCH_LEN];
+    for(int i = 0; i < FAST_LOG_BENCH_LEN; i++) {
+        input[i] = 1e-6f + (float)i * 37.0f;
+    }
+
+    volatile float sink = 0;
+    double start = now_s();
+    for(int r = 0; r < FAST_LOG_BENCH_ROUNDS; r++) {
+        float sum = 0;
+        for(int i = 0; i < FAST_LOG_BENCH_LEN; i++) sum += 10.0f * log10f(input[i]);
+        sink += sum;
+    }
+    double reference = now_s() - start;
+
+    start = now_s();
+    for(int r = 0; r < FAST_LOG_BENCH_ROUNDS; r++) {
+        float sum = 0;
+        for(int i = 0; i < FAST_LOG_BENCH_LEN; i++) sum += fast_db10(input[i]);
+        sink += sum;
+    }
+    double fast = now_s() - start;
+    (void)sink;
+
+    double calls = (double)FAST_LOG_BENCH_LEN * FAST_LOG_BENCH_ROUNDS;
+    printf("  10*log10f %.2f ns/call, fast_db10 %.2f ns/call\n", reference * 1e9 / calls, fast * 1e9 / calls);
+}
+
+int main(void) {
+    TEST_RUN(test_error_one_octave);
+    TEST_RUN(test_error_normal_range);
+    TEST_RUN(test_powers_of_two);
+    TEST_RUN(test_benchmark);
+    return TEST_RESULT();
+}
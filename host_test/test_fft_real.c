@@ -0,0 +1,198 @@
+/**
+ * @file test_fft_real.c
+ *
+ * @brief fft_real_fc32() bin by bin against a direct DFT, and a benchmark
+ * against the complex FFT path it replaced.
+ *
+ * The old path ran an N point dsps_fft2r_fc32() on the samples with zeroed
+ * imaginary parts, then dsps_bit_rev_fc32() and dsps_cplx2reC_fc32(). The
+ * benchmark only reports, host timings say little about the target.
+ */
+
+#include "fft_real.h"
+#include "esp_dsp.h"
+#include "host_test.h"
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Largest error of a bin, relative to the largest bin of the DFT
+#define FFT_REAL_MAX_ERROR      2e-6
+#define FFT_REAL_BENCH_ROUNDS   20000
+
+static float input[FFT_REAL_MAX_SIZE];
+static float data[FFT_REAL_MAX_SIZE * 2];
+static double dft_re[FFT_REAL_MAX_SIZE / 2 + 1];
+static double dft_im[FFT_REAL_MAX_SIZE / 2 + 1];
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Bins 0..N/2 of the real input
+static void dft(const float * x, int n) {
+    for(int k = 0; k <= n / 2; k++) {
+        double re = 0, im = 0;
+        for(int i = 0; i < n; i++) {
+            // Reduce k*i first, the angle stays exact for large N
+            double angle = 2 * M_PI * (double)(((long)k * i) % n) / n;
+            re += x[i] * cos(angle);
+            im -= x[i] * sin(angle);
+        }
+        dft_re[k] = re;
+        dft_im[k] = im;
+    }
+}
+
+static void make_input(int n, unsigned seed) {
+    srand(seed);
+    for(int i = 0; i < n; i++) {
+        input[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+    }
+    // A component at Nyquist so its bin is not just noise
+    for(int i = 0; i < n; i++) {
+        input[i] += (i & 1) ? -0.5f : 0.5f;
+    }
+}
+
+// Largest bin error of fft_real_fc32() over the largest DFT bin, Nyquist included
+static double real_fft_error(int n) {
+    dft(input, n);
+    for(int i = 0; i < n; i++) data[i] = input[i];
+    TEST_CHECK(fft_real_fc32(data, n) == ESP_OK);
+
+    double peak = 0;
+    for(int k = 0; k <= n / 2; k++) {
+        peak = fmax(peak, hypot(dft_re[k], dft_im[k]));
+    }
+
+    // DC and Nyquist are packed in bin 0
+    double error = fmax(fabs(data[0] - dft_re[0]), fabs(data[1] - dft_re[n / 2]));
+    for(int k = 1; k < n / 2; k++) {
+        error = fmax(error, hypot(data[2 * k] - dft_re[k], data[2 * k + 1] - dft_im[k]));
+    }
+    return error / peak;
+}
+
+static void complex_path(const float * x, int n) {
+    for(int i = 0; i < n; i++) {
+        data[2 * i + 0] = x[i];
+        data[2 * i + 1] = 0;
+    }
+    dsps_fft2r_fc32(data, n);
+    dsps_bit_rev_fc32(data, n);
+    dsps_cplx2reC_fc32(data, n);
+}
+
+//******************************************************************************************************************
+
+static void test_init_rejects_bad_size(void) {
+    TEST_CHECK(fft_real_init_fc32(2) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(fft_real_init_fc32(96) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(fft_real_init_fc32(FFT_REAL_MAX_SIZE * 2) == ESP_ERR_INVALID_ARG);
+
+    // The transform only runs at the size the table was built for
+    TEST_CHECK(fft_real_init_fc32(64) == ESP_OK);
+    TEST_CHECK(fft_real_fc32(data, 128) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(fft_real_fc32(NULL, 64) == ESP_ERR_INVALID_ARG);
+}
+
+static void test_matches_dft(void) {
+    for(int n = 4; n <= FFT_REAL_MAX_SIZE; n *= 2) {
+        TEST_CHECK(fft_real_init_fc32(n) == ESP_OK);
+        double worst = 0;
+        for(unsigned seed = 1; seed <= 3; seed++) {
+            make_input(n, seed);
+            worst = fmax(worst, real_fft_error(n));
+        }
+        printf("  N = %4d: max bin error %.2e\n", n, worst);
+        TEST_CHECK(worst < FFT_REAL_MAX_ERROR);
+    }
+}
+
+// Single tones land in their bin with the expected sign, Nyquist in the imaginary slot of bin 0
+static void test_tones(void) {
+    const int n = 256;
+    TEST_CHECK(fft_real_init_fc32(n) == ESP_OK);
+
+    for(int i = 0; i < n; i++) data[i] = 1.0f;
+    TEST_CHECK(fft_real_fc32(data, n) == ESP_OK);
+    TEST_CHECK(fabsf(data[0] - n) < 1e-3f);
+    TEST_CHECK(fabsf(data[1]) < 1e-3f);
+
+    for(int i = 0; i < n; i++) data[i] = (i & 1) ? -1.0f : 1.0f;
+    TEST_CHECK(fft_real_fc32(data, n) == ESP_OK);
+    TEST_CHECK(fabsf(data[0]) < 1e-3f);
+    TEST_CHECK(fabsf(data[1] - n) < 1e-3f);
+
+    // sin at bin 5 is -j*N/2 in bin 5 and nothing elsewhere
+    for(int i = 0; i < n; i++) data[i] = sinf(2 * M_PI * 5 * i / n);
+    TEST_CHECK(fft_real_fc32(data, n) == ESP_OK);
+    for(int k = 1; k < n / 2; k++) {
+        float expected_im = k == 5 ? -n / 2.0f : 0.0f;
+        TEST_CHECK(fabsf(data[2 * k]) < 1e-3f && fabsf(data[2 * k + 1] - expected_im) < 1e-3f);
+    }
+}
+
+// The old path gives the same bins, so the spectrum scale didn't change
+static void test_matches_complex_path(void) {
+    const int n = 256;
+    static float reference[FFT_REAL_MAX_SIZE * 2];
+    TEST_CHECK(fft_real_init_fc32(n) == ESP_OK);
+    make_input(n, 11);
+
+    complex_path(input, n);
+    for(int i = 0; i < n; i++) reference[i] = data[i];
+    for(int i = 0; i < n; i++) data[i] = input[i];
+    TEST_CHECK(fft_real_fc32(data, n) == ESP_OK);
+
+    double error = 0, peak = 0;
+    for(int k = 1; k < n / 2; k++) {
+        peak = fmax(peak, hypot(reference[2 * k], reference[2 * k + 1]));
+        error = fmax(error, hypot(data[2 * k] - reference[2 * k], data[2 * k + 1] - reference[2 * k + 1]));
+    }
+    TEST_CHECK(fabs(data[0] - reference[0]) <= FFT_REAL_MAX_ERROR * peak);
+    TEST_CHECK(error <= FFT_REAL_MAX_ERROR * peak);
+}
+
+static void test_benchmark(void) {
+    for(int n = 256; n <= 1024; n *= 4) {
+        TEST_CHECK(fft_real_init_fc32(n) == ESP_OK);
+        make_input(n, 5);
+        int rounds = FFT_REAL_BENCH_ROUNDS * 256 / n;
+
+        volatile float sink = 0;
+        double start = now_s();
+        for(int r = 0; r < rounds; r++) {
+            complex_path(input, n);
+            sink += data[2];
+        }
+        double complex_s = now_s() - start;
+
+        start = now_s();
+        for(int r = 0; r < rounds; r++) {
+            for(int i = 0; i < n; i++) data[i] = input[i];
+            fft_real_fc32(data, n);
+            sink += data[2];
+        }
+        double real_s = now_s() - start;
+        (void)sink;
+
+        printf("  N = %4d: complex + cplx2reC %.2f us, fft_real_fc32 %.2f us (%.2fx)\n",
+            n, complex_s * 1e6 / rounds, real_s * 1e6 / rounds, complex_s / real_s);
+    }
+}
+
+int main(void) {
+    // Covers the complex path at N as well as the N/2 point transform inside fft_real_fc32()
+    TEST_CHECK(dsps_fft2r_init_fc32(NULL, FFT_REAL_MAX_SIZE) == ESP_OK);
+
+    TEST_RUN(test_init_rejects_bad_size);
+    TEST_RUN(test_matches_dft);
+    TEST_RUN(test_tones);
+    TEST_RUN(test_matches_complex_path);
+    TEST_RUN(test_benchmark);
+    return TEST_RESULT();
+}
@@ -0,0 +1,334 @@
+/**
+ * @file test_i2c_engine.c
+ *
+ * @brief I2C engine core against a simulated bus.
+ *
+ * The simulated bus runs on a virtual clock: every transfer takes the time
+ * of its bytes at 100 kHz, so latencies are exact. Transfers to a register
+ * marked as failing return ESP_FAIL. Free ring slots are counted the way
+ * i2c_app.c counts them with a semaphore: taken before a submit, given back
+ * by the release hook.
+ */
+
+#include "i2c_engine.h"
+#include "host_test.h"
+#include <string.h>
+
+#define SIM_LOG_LEN         64
+#define SIM_BYTE_US         90      // 9 clocks per byte at 100 kHz
+#define SIM_FAIL_REGISTER   0xEE
+
+typedef struct {
+    int64_t now_us;
+    int lock_depth;
+    uint32_t kicks;
+    uint32_t slots;                 // Free slots, the counting semaphore of i2c_app.c
+    i2c_transfer_t log[SIM_LOG_LEN];
+    uint32_t log_len;
+} sim_bus_t;
+
+static sim_bus_t bus;
+static i2c_engine_t engine;
+
+// Completion callbacks, in call order
+typedef struct {
+    uint8_t register_address;
+    esp_err_t err;
+} sim_done_t;
+
+static sim_done_t done[SIM_LOG_LEN];
+static uint32_t done_len;
+
+//******************************************************************************************************************
+
+static esp_err_t sim_transfer(const i2c_transfer_t * transfer) {
+    TEST_CHECK(bus.lock_depth == 0);
+    if(bus.log_len < SIM_LOG_LEN) {
+        bus.log[bus.log_len++] = *transfer;
+    }
+
+    // Address and register bytes, then the data
+    bus.now_us += (2 + transfer->size) * SIM_BYTE_US;
+    if(transfer->op == I2C_OP_READ && transfer->data) {
+        memset(transfer->data, transfer->register_address, transfer->size);
+    }
+    return transfer->register_address == SIM_FAIL_REGISTER ? ESP_FAIL : ESP_OK;
+}
+
+static int64_t sim_now_us(void) {
+    return bus.now_us;
+}
+
+static void sim_lock(void) {
+    TEST_CHECK(bus.lock_depth == 0);
+    bus.lock_depth++;
+}
+
+static void sim_unlock(void) {
+    TEST_CHECK(bus.lock_depth == 1);
+    bus.lock_depth--;
+}
+
+static void sim_kick(void) {
+    bus.kicks++;
+}
+
+static void sim_release(void) {
+    TEST_CHECK(bus.lock_depth == 0);
+    bus.slots++;
+}
+
+static const i2c_engine_backend_t sim_backend = {
+    .transfer = sim_transfer,
+    .now_us = sim_now_us,
+    .lock = sim_lock,
+    .unlock = sim_unlock,
+    .kick = sim_kick,
+    .release = sim_release,
+};
+
+static void sim_done(void * ctx, esp_err_t err) {
+    TEST_CHECK(bus.lock_depth == 0);
+    if(done_len < SIM_LOG_LEN) {
+        done[done_len].register_address = (uint8_t)(uintptr_t)ctx;
+        done[done_len].err = err;
+        done_len++;
+    }
+}
+
+static void sim_reset(void) {
+    memset(&bus, 0, sizeof(bus));
+    bus.slots = I2C_ENGINE_RING_SIZE;
+    memset(done, 0, sizeof(done));
+    done_len = 0;
+    TEST_CHECK(i2c_engine_init(&engine, &sim_backend) == ESP_OK);
+}
+
+static esp_err_t sim_submit(i2c_op_e op, uint8_t register_address, uint8_t size, uint8_t * data) {
+    i2c_transfer_t transfer = {
+        .op = op,
+        .device_address = 0x68,
+        .register_address = register_address,
+        .size = size,
+        .data = data,
+        .cb = sim_done,
+        .ctx = (void *)(uintptr_t)register_address,
+    };
+    return i2c_engine_submit(&engine, &transfer);
+}
+
+// Like i2c_app_submit_cb(): take a slot first, with no slot left it would block for good
+static esp_err_t sim_submit_slot(const i2c_transfer_t * transfer) {
+    if(bus.slots == 0) {
+        return ESP_ERR_TIMEOUT;
+    }
+    bus.slots--;
+    esp_err_t err = i2c_engine_submit(&engine, transfer);
+    if(err != ESP_OK) {
+        bus.slots++;
+    }
+    return err;
+}
+
+static uint32_t sim_service_all(void) {
+    uint32_t count = 0;
+    while(i2c_engine_service(&engine)) {
+        count++;
+    }
+    return count;
+}
+
+//******************************************************************************************************************
+
+static void test_init_rejects_incomplete_backend(void) {
+    i2c_engine_backend_t backend = sim_backend;
+    backend.transfer = NULL;
+    TEST_CHECK(i2c_engine_init(&engine, &backend) == ESP_ERR_INVALID_ARG);
+
+    // Waking the servicing context is optional
+    backend = sim_backend;
+    backend.kick = NULL;
+    TEST_CHECK(i2c_engine_init(&engine, &backend) == ESP_OK);
+    TEST_CHECK(i2c_engine_service(&engine) == false);
+}
+
+static void test_submission_order(void) {
+    sim_reset();
+    uint8_t data[4][2];
+    for(uint8_t i = 0; i < 4; i++) {
+        TEST_CHECK(sim_submit(i & 1 ? I2C_OP_WRITE : I2C_OP_READ, 0x10 + i, 2, data[i]) == ESP_OK);
+    }
+    TEST_CHECK(bus.kicks == 4);
+    TEST_CHECK(i2c_engine_pending(&engine) == 4);
+
+    TEST_CHECK(sim_service_all() == 4);
+    TEST_CHECK(bus.log_len == 4);
+    TEST_CHECK(done_len == 4);
+    for(uint8_t i = 0; i < 4; i++) {
+        TEST_CHECK(bus.log[i].register_address == 0x10 + i);
+        TEST_CHECK(bus.log[i].op == (i & 1 ? I2C_OP_WRITE : I2C_OP_READ));
+        TEST_CHECK(done[i].register_address == 0x10 + i);
+        TEST_CHECK(done[i].err == ESP_OK);
+    }
+    // Reads land in the caller's buffer
+    TEST_CHECK(data[0][0] == 0x10 && data[2][1] == 0x12);
+    TEST_CHECK(i2c_engine_pending(&engine) == 0);
+}
+
+static void test_ring_full_and_wrap(void) {
+    sim_reset();
+    uint8_t data[1];
+    uint8_t next = 0;
+
+    for(int i = 0; i < I2C_ENGINE_RING_SIZE; i++) {
+        TEST_CHECK(sim_submit(I2C_OP_READ, next++, 1, data) == ESP_OK);
+    }
+    TEST_CHECK(sim_submit(I2C_OP_READ, 0xFF, 1, data) == ESP_ERR_NO_MEM);
+    TEST_CHECK(bus.kicks == I2C_ENGINE_RING_SIZE);
+
+    // Free part of the ring, then refill it across the end of the array
+    for(int i = 0; i < 10; i++) {
+        TEST_CHECK(i2c_engine_service(&engine));
+    }
+    for(int i = 0; i < 10; i++) {
+        TEST_CHECK(sim_submit(I2C_OP_READ, next++, 1, data) == ESP_OK);
+    }
+    TEST_CHECK(sim_submit(I2C_OP_READ, 0xFF, 1, data) == ESP_ERR_NO_MEM);
+    TEST_CHECK(sim_service_all() == I2C_ENGINE_RING_SIZE);
+
+    TEST_CHECK(bus.log_len == next);
+    for(uint32_t i = 0; i < bus.log_len; i++) {
+        TEST_CHECK(bus.log[i].register_address == i);
+    }
+
+    i2c_engine_stats_t stats;
+    i2c_engine_get_stats(&engine, &stats);
+    TEST_CHECK(stats.submitted == next);
+    TEST_CHECK(stats.completed == next);
+    TEST_CHECK(stats.rejected == 2);
+    TEST_CHECK(stats.max_pending == I2C_ENGINE_RING_SIZE);
+}
+
+static void test_callback_status(void) {
+    sim_reset();
+    uint8_t data[1];
+    TEST_CHECK(sim_submit(I2C_OP_WRITE, 0x01, 1, data) == ESP_OK);
+    TEST_CHECK(sim_submit(I2C_OP_WRITE, SIM_FAIL_REGISTER, 1, data) == ESP_OK);
+    TEST_CHECK(sim_submit(I2C_OP_WRITE, 0x02, 1, data) == ESP_OK);
+
+    // No callback is fine too
+    i2c_transfer_t silent = { .op = I2C_OP_WRITE, .register_address = SIM_FAIL_REGISTER, .size = 1, .data = data };
+    TEST_CHECK(i2c_engine_submit(&engine, &silent) == ESP_OK);
+
+    TEST_CHECK(sim_service_all() == 4);
+    TEST_CHECK(done_len == 3);
+    TEST_CHECK(done[0].err == ESP_OK);
+    TEST_CHECK(done[1].register_address == SIM_FAIL_REGISTER && done[1].err == ESP_FAIL);
+    TEST_CHECK(done[2].err == ESP_OK);
+
+    i2c_engine_stats_t stats;
+    i2c_engine_get_stats(&engine, &stats);
+    TEST_CHECK(stats.errors == 2);
+    TEST_CHECK(stats.completed == 4);
+}
+
+// A callback may queue follow-up work even when the ring was full
+static void sim_done_requeue(void * ctx, esp_err_t err) {
+    sim_done(ctx, err);
+    if(done_len == 1) {
+        static uint8_t data[1];
+        TEST_CHECK(sim_submit(I2C_OP_READ, 0x80, 1, data) == ESP_OK);
+    }
+}
+
+static void test_callback_requeue_on_full_ring(void) {
+    sim_reset();
+    uint8_t data[1];
+    for(int i = 0; i < I2C_ENGINE_RING_SIZE; i++) {
+        i2c_transfer_t transfer = {
+            .op = I2C_OP_READ,
+            .register_address = i,
+            .size = 1,
+            .data = data,
+            .cb = i == 0 ? sim_done_requeue : sim_done,
+            .ctx = (void *)(uintptr_t)i,
+        };
+        TEST_CHECK(i2c_engine_submit(&engine, &transfer) == ESP_OK);
+    }
+
+    TEST_CHECK(sim_service_all() == I2C_ENGINE_RING_SIZE + 1);
+    TEST_CHECK(bus.log[I2C_ENGINE_RING_SIZE].register_address == 0x80);
+}
+
+// The callback submits through the slot count, which must already have the slot back
+static void sim_done_requeue_slot(void * ctx, esp_err_t err) {
+    sim_done(ctx, err);
+    TEST_CHECK(bus.slots == 1);
+    static uint8_t data[1];
+    i2c_transfer_t transfer = {
+        .op = I2C_OP_READ,
+        .register_address = 0x80,
+        .size = 1,
+        .data = data,
+        .cb = sim_done,
+        .ctx = (void *)(uintptr_t)0x80,
+    };
+    TEST_CHECK(sim_submit_slot(&transfer) == ESP_OK);
+}
+
+static void test_callback_requeue_through_slots(void) {
+    sim_reset();
+    uint8_t data[1];
+    for(int i = 0; i < I2C_ENGINE_RING_SIZE; i++) {
+        i2c_transfer_t transfer = {
+            .op = I2C_OP_READ,
+            .register_address = i,
+            .size = 1,
+            .data = data,
+            .cb = i == 0 ? sim_done_requeue_slot : sim_done,
+            .ctx = (void *)(uintptr_t)i,
+        };
+        TEST_CHECK(sim_submit_slot(&transfer) == ESP_OK);
+    }
+    i2c_transfer_t extra = { .op = I2C_OP_READ, .register_address = 0xFF, .size = 1, .data = data };
+    TEST_CHECK(sim_submit_slot(&extra) == ESP_ERR_TIMEOUT);
+
+    TEST_CHECK(sim_service_all() == I2C_ENGINE_RING_SIZE + 1);
+    TEST_CHECK(bus.log[I2C_ENGINE_RING_SIZE].register_address == 0x80);
+    TEST_CHECK(done_len == I2C_ENGINE_RING_SIZE + 1);
+    TEST_CHECK(bus.slots == I2C_ENGINE_RING_SIZE);
+}
+
+static void test_latency(void) {
+    sim_reset();
+    uint8_t data[14];
+
+    // Queued together at t = 0, each waits for the ones ahead of it
+    TEST_CHECK(sim_submit(I2C_OP_READ, 0x3B, 14, data) == ESP_OK);
+    TEST_CHECK(sim_submit(I2C_OP_READ, 0x3B, 14, data) == ESP_OK);
+    TEST_CHECK(sim_submit(I2C_OP_WRITE, 0x6B, 1, data) == ESP_OK);
+    sim_service_all();
+
+    i2c_engine_stats_t stats;
+    i2c_engine_get_stats(&engine, &stats);
+    TEST_CHECK(stats.max_latency_us == (16 + 16 + 3) * SIM_BYTE_US);
+
+    // A transfer queued on an idle bus only sees its own time
+    sim_reset();
+    bus.now_us = 1000000;
+    TEST_CHECK(sim_submit(I2C_OP_READ, 0x75, 1, data) == ESP_OK);
+    sim_service_all();
+    i2c_engine_get_stats(&engine, &stats);
+    TEST_CHECK(stats.max_latency_us == 3 * SIM_BYTE_US);
+}
+
+int main(void) {
+    TEST_RUN(test_init_rejects_incomplete_backend);
+    TEST_RUN(test_submission_order);
+    TEST_RUN(test_ring_full_and_wrap);
+    TEST_RUN(test_callback_status);
+    TEST_RUN(test_callback_requeue_on_full_ring);
+    TEST_RUN(test_callback_requeue_through_slots);
+    TEST_RUN(test_latency);
+    return TEST_RESULT();
+}
@@ -0,0 +1,157 @@
+/**
+ * @file test_spectrum_snr.c
+ *
+ * @brief SNR of the fixed-point spectrum front end against the float one.
+ *
+ * spectrum.c is built twice, once per AUDIO_FFT_FIXED_POINT setting, and
+ * both paths see the same frames at the AGC output scale. The SNR is taken
+ * on bin magnitudes: energy of the float spectrum over the energy of the
+ * difference. The float path is first checked against a double DFT.
+ *
+ * The sc16 FFT drops a bit per stage, so the SNR falls about 1 dB per dB
+ * of input level below full scale: around 60 dB near full scale, 40 dB at
+ * -20 dBFS and 22 to 26 dB at -40 dBFS.
+ */
+
+#include "spectrum.h"
+#include "esp_dsp.h"
+#include "agc.h"
+#include "host_test.h"
+#include <math.h>
+#include <stdlib.h>
+
+static int32_t frame[SPECTRUM_MAX_WINDOW];
+static float reference[SPECTRUM_MAX_WINDOW / 2];
+
+//******************************************************************************************************************
+
+// Tone at a level relative to the AGC output full scale, plus optional white noise
+static void make_frame(int window, double bin, double level_dbfs, double noise_dbfs) {
+    double amplitude = AGC_OUTPUT_FULL_SCALE * pow(10.0, level_dbfs / 20.0);
+    double noise = AGC_OUTPUT_FULL_SCALE * pow(10.0, noise_dbfs / 20.0);
+    for(int i = 0; i < window; i++) {
+        double x = amplitude * sin(2 * M_PI * bin * i / window + 0.3);
+        x += noise * (2.0 * rand() / RAND_MAX - 1.0);
+        frame[i] = (int32_t)lrint(x);
+    }
+}
+
+static double snr_db(const float * expected, const float * actual, int bins) {
+    double signal = 0;
+    double error = 0;
+    for(int k = 0; k < bins; k++) {
+        double a = sqrt(expected[k]);
+        double b = sqrt(actual[k]);
+        signal += a * a;
+        error += (a - b) * (a - b);
+    }
+    return error > 0 ? 10.0 * log10(signal / error) : INFINITY;
+}
+
+static int peak_bin(const float * power, int bins) {
+    int peak = 1;
+    for(int k = 1; k < bins; k++) {
+        if(power[k] > power[peak]) peak = k;
+    }
+    return peak;
+}
+
+static double measure(int window, double bin, double level_dbfs, double noise_dbfs, int * float_peak, int * q15_peak) {
+    TEST_CHECK(spectrum_init_f32(window) == ESP_OK);
+    TEST_CHECK(spectrum_init_q15(window) == ESP_OK);
+
+    make_frame(window, bin, level_dbfs, noise_dbfs);
+    const float * power = spectrum_power_f32(frame, window);
+    for(int k = 0; k < window / 2; k++) reference[k] = power[k];
+    power = spectrum_power_q15(frame, window);
+
+    if(float_peak) *float_peak = peak_bin(reference, window / 2);
+    if(q15_peak) *q15_peak = peak_bin(power, window / 2);
+    return snr_db(reference, power, window / 2);
+}
+
+//******************************************************************************************************************
+
+// The float path is the reference, check it against a plain DFT first
+static void test_float_matches_dft(void) {
+    const int window = 256;
+    TEST_CHECK(spectrum_init_f32(window) == ESP_OK);
+    make_frame(window, 21.4, -6, -60);
+    const float * power = spectrum_power_f32(frame, window);
+
+    double signal = 0;
+    double error = 0;
+    for(int k = 1; k < window / 2; k++) {
+        double re = 0, im = 0;
+        for(int n = 0; n < window; n++) {
+            double w = 0.5 - 0.5 * cos(2 * M_PI * n / (window - 1));
+            re += frame[n] * w * cos(2 * M_PI * k * n / window);
+            im -= frame[n] * w * sin(2 * M_PI * k * n / window);
+        }
+        double expected = (re * re + im * im) / window;
+        signal += expected;
+        error += fabs(expected - power[k]);
+    }
+    TEST_CHECK(error / signal < 1e-4);
+}
+
+static void test_snr_tone_levels(void) {
+    static const struct {
+        double level_dbfs;
+        double min_snr_db;
+    } cases[] = {
+        { -1, 55 },
+        { -6, 50 },
+        { -20, 36 },
+        { -40, 18 },
+    };
+    static const int windows[] = { 256, 512, 1024 };
+
+    for(size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+        for(size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+            int float_peak, q15_peak;
+            double snr = measure(windows[w], windows[w] * 0.0731, cases[c].level_dbfs, -120, &float_peak, &q15_peak);
+            printf("  window %4d tone %4.0f dBFS: SNR %5.1f dB\n", windows[w], cases[c].level_dbfs, snr);
+            TEST_CHECK(snr > cases[c].min_snr_db);
+            TEST_CHECK(float_peak == q15_peak);
+        }
+    }
+}
+
+// Broadband input, every bin carries signal
+static void test_snr_noise(void) {
+    srand(1);
+    double snr = measure(512, 100.5, -12, -20, NULL, NULL);
+    printf("  window  512 tone -12 dBFS + noise -20 dBFS: SNR %5.1f dB\n", snr);
+    TEST_CHECK(snr > 44);
+}
+
+// Samples above the AGC output full scale saturate instead of wrapping
+static void test_q15_saturates(void) {
+    const int window = 256;
+    TEST_CHECK(spectrum_init_q15(window) == ESP_OK);
+    for(int i = 0; i < window; i++) {
+        frame[i] = (i & 8) ? INT32_MAX : INT32_MIN;
+    }
+    const float * power = spectrum_power_q15(frame, window);
+    // Square wave of period 16, the fundamental lands on bin 16
+    TEST_CHECK(peak_bin(power, window / 2) == 16);
+}
+
+static void test_init_rejects_bad_window(void) {
+    TEST_CHECK(spectrum_init_f32(SPECTRUM_MAX_WINDOW * 2) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(spectrum_init_q15(2) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(spectrum_init_q15(384) == ESP_ERR_INVALID_ARG);
+}
+
+int main(void) {
+    TEST_CHECK(dsps_fft2r_init_fc32(NULL, HOST_DSP_MAX_FFT_SIZE) == ESP_OK);
+    TEST_CHECK(dsps_fft2r_init_sc16(NULL, HOST_DSP_MAX_FFT_SIZE) == ESP_OK);
+
+    TEST_RUN(test_float_matches_dft);
+    TEST_RUN(test_snr_tone_levels);
+    TEST_RUN(test_snr_noise);
+    TEST_RUN(test_q15_saturates);
+    TEST_RUN(test_init_rejects_bad_window);
+    return TEST_RESULT();
+}
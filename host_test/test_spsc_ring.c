@@ -0,0 +1,258 @@
+/**
+ * @file test_spsc_ring.c
+ *
+ * @brief SPSC ring single threaded behaviour and a producer/consumer stress test.
+ *
+ * In the stress test a producer thread pushes numbered items into a small
+ * ring while a consumer thread pops them. Both yield after bursts of random
+ * length so the ring keeps going from empty to full, also on a single core
+ * where the threads only meet through preemption. Every item carries its
+ * number in all of its words, so a torn copy shows up as mixed words. Each
+ * number has to end up exactly once as popped, evicted or refused, and the
+ * popped ones in order.
+ */
+
+#include "spsc_ring.h"
+#include "host_test.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STRESS_ITEMS        (1u << 21)
+#define STRESS_CAPACITY     16
+#define STRESS_WORDS        15
+
+typedef struct {
+    uint32_t seq;
+    uint32_t copy[STRESS_WORDS];
+} stress_item_t;
+
+typedef enum {
+    SEEN_NONE = 0,
+    SEEN_POPPED,
+    SEEN_EVICTED,
+    SEEN_REFUSED,
+} seen_e;
+
+static spsc_ring_t ring;
+static stress_item_t storage[STRESS_CAPACITY];
+static uint8_t seen_by_producer[STRESS_ITEMS];
+static uint8_t seen_by_consumer[STRESS_ITEMS];
+static atomic_bool producer_done;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t evicted;
+    uint32_t refused;
+    uint32_t popped;
+    uint32_t peeked;
+    uint32_t torn;
+    uint32_t out_of_order;
+} stress_stats_t;
+
+static stress_stats_t stats;
+
+//******************************************************************************************************************
+
+static uint32_t xorshift(uint32_t * state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static void make_item(stress_item_t * item, uint32_t seq) {
+    item->seq = seq;
+    for(int i = 0; i < STRESS_WORDS; i++) item->copy[i] = seq ^ (i * 0x9E3779B9u);
+}
+
+static bool item_intact(const stress_item_t * item) {
+    if(item->seq >= STRESS_ITEMS) return false;
+    for(int i = 0; i < STRESS_WORDS; i++) {
+        if(item->copy[i] != (item->seq ^ (i * 0x9E3779B9u))) return false;
+    }
+    return true;
+}
+
+static void * stress_producer(void * arg) {
+    stress_item_t item, evicted;
+    uint32_t random = 1;
+    uint32_t burst = 0;
+    for(uint32_t seq = 0; seq < STRESS_ITEMS; seq++) {
+        if(burst-- == 0) {
+            sched_yield();
+            burst = xorshift(&random) % (2 * STRESS_CAPACITY);
+        }
+        make_item(&item, seq);
+        stats.pushed++;
+        switch(spsc_ring_push(&ring, &item, &evicted)) {
+            case SPSC_RING_PUSHED:
+                break;
+            case SPSC_RING_EVICTED:
+                stats.evicted++;
+                if(!item_intact(&evicted)) {
+                    stats.torn++;
+                } else {
+                    seen_by_producer[evicted.seq] = SEEN_EVICTED;
+                }
+                break;
+            case SPSC_RING_REJECTED:
+                stats.refused++;
+                seen_by_producer[seq] = SEEN_REFUSED;
+                break;
+        }
+    }
+    atomic_store(&producer_done, true);
+    return NULL;
+}
+
+static void * stress_consumer(void * arg) {
+    stress_item_t item;
+    uint32_t last = 0;
+    bool first = true;
+    uint32_t round = 0;
+    uint32_t random = 7;
+    uint32_t burst = 0;
+
+    while(1) {
+        if(burst-- == 0) {
+            sched_yield();
+            burst = xorshift(&random) % (2 * STRESS_CAPACITY);
+        }
+        bool done = atomic_load(&producer_done);
+        // Peek now and then, the copy must be whole too
+        if((++round & 7) == 0 && spsc_ring_peek(&ring, &item)) {
+            stats.peeked++;
+            if(!item_intact(&item)) stats.torn++;
+        }
+
+        if(spsc_ring_pop(&ring, &item)) {
+            if(!item_intact(&item)) {
+                stats.torn++;
+                continue;
+            }
+            stats.popped++;
+            if(!first && item.seq <= last) stats.out_of_order++;
+            seen_by_consumer[item.seq] = SEEN_POPPED;
+            last = item.seq;
+            first = false;
+        } else if(done) {
+            // Producer finished before this empty pop, nothing is left
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void stress(spsc_ring_policy_e policy) {
+    memset(&stats, 0, sizeof(stats));
+    memset(seen_by_producer, SEEN_NONE, sizeof(seen_by_producer));
+    memset(seen_by_consumer, SEEN_NONE, sizeof(seen_by_consumer));
+    atomic_store(&producer_done, false);
+    TEST_CHECK(spsc_ring_init(&ring, storage, sizeof(stress_item_t), STRESS_CAPACITY, policy) == ESP_OK);
+
+    pthread_t producer, consumer;
+    TEST_CHECK(pthread_create(&consumer, NULL, stress_consumer, NULL) == 0);
+    TEST_CHECK(pthread_create(&producer, NULL, stress_producer, NULL) == 0);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+
+    printf("  pushed %u: popped %u, evicted %u, refused %u, peeked %u\n",
+        (unsigned)stats.pushed, (unsigned)stats.popped, (unsigned)stats.evicted, (unsigned)stats.refused, (unsigned)stats.peeked);
+    TEST_CHECK(stats.torn == 0);
+    TEST_CHECK(stats.out_of_order == 0);
+    TEST_CHECK(stats.popped + stats.evicted + stats.refused == stats.pushed);
+    TEST_CHECK(spsc_ring_get_overflows(&ring) == stats.evicted + stats.refused);
+    TEST_CHECK(spsc_ring_count(&ring) == 0);
+
+    // Every item went exactly one way
+    uint32_t missing = 0, twice = 0;
+    for(uint32_t seq = 0; seq < STRESS_ITEMS; seq++) {
+        if(seen_by_producer[seq] == SEEN_NONE && seen_by_consumer[seq] == SEEN_NONE) missing++;
+        if(seen_by_producer[seq] != SEEN_NONE && seen_by_consumer[seq] != SEEN_NONE) twice++;
+    }
+    TEST_CHECK(missing == 0);
+    TEST_CHECK(twice == 0);
+
+    // Both the full and the normal path ran, otherwise the test proves little
+    TEST_CHECK(stats.evicted + stats.refused > STRESS_ITEMS / 100);
+    TEST_CHECK(stats.popped > STRESS_ITEMS / 4);
+    TEST_CHECK(policy == SPSC_RING_DROP_OLDEST ? stats.refused == 0 : stats.evicted == 0);
+}
+
+//******************************************************************************************************************
+
+static void test_init_rejects_bad_capacity(void) {
+    TEST_CHECK(spsc_ring_init(&ring, storage, sizeof(stress_item_t), 12, SPSC_RING_DROP_NEWEST) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(spsc_ring_init(&ring, storage, sizeof(stress_item_t), 0, SPSC_RING_DROP_NEWEST) == ESP_ERR_INVALID_ARG);
+    TEST_CHECK(spsc_ring_init(&ring, NULL, sizeof(stress_item_t), 16, SPSC_RING_DROP_NEWEST) == ESP_ERR_INVALID_ARG);
+}
+
+static void test_drop_newest(void) {
+    uint32_t buffer[4];
+    uint32_t value;
+    TEST_CHECK(spsc_ring_init(&ring, buffer, sizeof(uint32_t), 4, SPSC_RING_DROP_NEWEST) == ESP_OK);
+    TEST_CHECK(!spsc_ring_pop(&ring, &value));
+
+    for(uint32_t i = 0; i < 6; i++) {
+        TEST_CHECK(spsc_ring_push(&ring, &i, NULL) == (i < 4 ? SPSC_RING_PUSHED : SPSC_RING_REJECTED));
+    }
+    TEST_CHECK(spsc_ring_count(&ring) == 4);
+    TEST_CHECK(spsc_ring_get_overflows(&ring) == 2);
+
+    TEST_CHECK(spsc_ring_peek(&ring, &value) && value == 0);
+    for(uint32_t i = 0; i < 4; i++) {
+        TEST_CHECK(spsc_ring_pop(&ring, &value) && value == i);
+    }
+    TEST_CHECK(!spsc_ring_pop(&ring, &value));
+}
+
+static void test_drop_oldest(void) {
+    uint32_t buffer[4];
+    uint32_t value, evicted;
+    TEST_CHECK(spsc_ring_init(&ring, buffer, sizeof(uint32_t), 4, SPSC_RING_DROP_OLDEST) == ESP_OK);
+
+    for(uint32_t i = 0; i < 6; i++) {
+        spsc_ring_result_e result = spsc_ring_push(&ring, &i, &evicted);
+        TEST_CHECK(result == (i < 4 ? SPSC_RING_PUSHED : SPSC_RING_EVICTED));
+        if(result == SPSC_RING_EVICTED) TEST_CHECK(evicted == i - 4);
+    }
+    TEST_CHECK(spsc_ring_count(&ring) == 4);
+    TEST_CHECK(spsc_ring_get_overflows(&ring) == 2);
+    for(uint32_t i = 2; i < 6; i++) {
+        TEST_CHECK(spsc_ring_pop(&ring, &value) && value == i);
+    }
+}
+
+// Indices are free running, the ring keeps working across their wrap
+static void test_index_wrap(void) {
+    uint32_t buffer[4];
+    uint32_t value;
+    TEST_CHECK(spsc_ring_init(&ring, buffer, sizeof(uint32_t), 4, SPSC_RING_DROP_NEWEST) == ESP_OK);
+    atomic_store(&ring.head, UINT32_MAX - 1);
+    atomic_store(&ring.tail, UINT32_MAX - 1);
+
+    for(uint32_t i = 0; i < 4; i++) TEST_CHECK(spsc_ring_push(&ring, &i, NULL) == SPSC_RING_PUSHED);
+    TEST_CHECK(spsc_ring_push(&ring, &value, NULL) == SPSC_RING_REJECTED);
+    for(uint32_t i = 0; i < 4; i++) TEST_CHECK(spsc_ring_pop(&ring, &value) && value == i);
+}
+
+static void test_stress_drop_newest(void) {
+    stress(SPSC_RING_DROP_NEWEST);
+}
+
+static void test_stress_drop_oldest(void) {
+    stress(SPSC_RING_DROP_OLDEST);
+}
+
+int main(void) {
+    TEST_RUN(test_init_rejects_bad_capacity);
+    TEST_RUN(test_drop_newest);
+    TEST_RUN(test_drop_oldest);
+    TEST_RUN(test_index_wrap);
+    TEST_RUN(test_stress_drop_newest);
+    TEST_RUN(test_stress_drop_oldest);
+    return TEST_RESULT();
+}
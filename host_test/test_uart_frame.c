@@ -0,0 +1,266 @@
+/**
+ * @file test_uart_frame.c
+ *
+ * @brief Frame encoder and decoder round trip, resynchronization and throughput.
+ *
+ * Streams of random frames go through the decoder byte by byte, clean, with
+ * corrupted frames and with stray bytes and false sync words between frames.
+ * Every intact frame must come out once, in order and unchanged.
+ */
+
+#include "uart_frame.h"
+#include "host_test.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define STREAM_FRAMES       500
+#define STREAM_SIZE         (STREAM_FRAMES * (UART_FRAME_OVERHEAD + UART_FRAME_MAX_PAYLOAD + 32))
+#define BENCH_PAYLOAD       256
+#define BENCH_FRAMES        20000
+
+typedef struct {
+    uart_frame_header_t header;
+    uint8_t payload[UART_FRAME_MAX_PAYLOAD];
+    bool intact;
+} sent_frame_t;
+
+static sent_frame_t sent[STREAM_FRAMES];
+static uint8_t stream[STREAM_SIZE];
+static size_t stream_len;
+static uart_frame_decoder_t decoder;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//******************************************************************************************************************
+
+static void make_frame(sent_frame_t * frame, uint16_t seq) {
+    frame->header.stream = rand() % UART_STREAM_MAX;
+    frame->header.type = rand() % UART_FRAME_TYPE_MAX;
+    frame->header.seq = seq;
+    frame->header.timestamp = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+    // Mostly short frames, some empty and some at the maximum
+    int pick = rand() % 10;
+    frame->header.len = pick == 0 ? 0 : pick == 1 ? UART_FRAME_MAX_PAYLOAD : rand() % 128;
+    for(int i = 0; i < frame->header.len; i++) {
+        frame->payload[i] = rand();
+    }
+    frame->intact = true;
+}
+
+static void append(const uint8_t * data, size_t len) {
+    TEST_CHECK(stream_len + len <= STREAM_SIZE);
+    memcpy(&stream[stream_len], data, len);
+    stream_len += len;
+}
+
+static void append_frame(sent_frame_t * frame) {
+    uint8_t out[UART_FRAME_OVERHEAD + UART_FRAME_MAX_PAYLOAD];
+    size_t len = uart_frame_encode(out, sizeof(out), &frame->header, frame->payload);
+    TEST_CHECK(len == (size_t)UART_FRAME_OVERHEAD + frame->header.len);
+    append(out, len);
+}
+
+// Feed the whole stream, check what comes out against the intact frames
+static void check_stream(int frames) {
+    // Idle line at the end, the decoder hands out at most one frame per byte
+    static const uint8_t idle[UART_FRAME_OVERHEAD + UART_FRAME_MAX_PAYLOAD];
+    append(idle, sizeof(idle));
+
+    uart_frame_decoder_init(&decoder);
+    int next = 0;
+    for(size_t i = 0; i < stream_len; i++) {
+        if(uart_frame_decoder_push(&decoder, stream[i]) != UART_FRAME_READY) continue;
+
+        while(next < frames && !sent[next].intact) next++;
+        TEST_CHECK(next < frames);
+        if(next >= frames) return;
+
+        const sent_frame_t * expected = &sent[next++];
+        TEST_CHECK(decoder.header.stream == expected->header.stream);
+        TEST_CHECK(decoder.header.type == expected->header.type);
+        TEST_CHECK(decoder.header.seq == expected->header.seq);
+        TEST_CHECK(decoder.header.timestamp == expected->header.timestamp);
+        TEST_CHECK(decoder.header.len == expected->header.len);
+        TEST_CHECK(memcmp(decoder.payload, expected->payload, expected->header.len) == 0);
+    }
+    while(next < frames && !sent[next].intact) next++;
+    TEST_CHECK(next == frames);
+}
+
+static int intact_count(int frames) {
+    int count = 0;
+    for(int i = 0; i < frames; i++) count += sent[i].intact;
+    return count;
+}
+
+//******************************************************************************************************************
+
+// CRC-16/CCITT-FALSE check value
+static void test_crc_check_value(void) {
+    TEST_CHECK(uart_frame_crc16(0xFFFF, (const uint8_t *)"123456789", 9) == 0x29B1);
+}
+
+static void test_encode_bounds(void) {
+    uint8_t out[UART_FRAME_OVERHEAD + 4];
+    uint8_t payload[4] = { 1, 2, 3, 4 };
+    uart_frame_header_t header = { .stream = UART_STREAM_IMU, .type = UART_FRAME_TYPE_U8, .len = 4 };
+    TEST_CHECK(uart_frame_encode(out, sizeof(out), &header, payload) == sizeof(out));
+    TEST_CHECK(uart_frame_encode(out, sizeof(out) - 1, &header, payload) == 0);
+
+    header.len = UART_FRAME_MAX_PAYLOAD + 1;
+    TEST_CHECK(uart_frame_encode(out, sizeof(out), &header, payload) == 0);
+}
+
+static void test_round_trip(void) {
+    srand(1);
+    stream_len = 0;
+    for(int i = 0; i < STREAM_FRAMES; i++) {
+        make_frame(&sent[i], i);
+        append_frame(&sent[i]);
+    }
+    check_stream(STREAM_FRAMES);
+    TEST_CHECK(decoder.frames == STREAM_FRAMES);
+    TEST_CHECK(decoder.crc_errors == 0);
+    TEST_CHECK(decoder.len_errors == 0);
+}
+
+// One bit flipped in the header, payload or CRC: that frame only is lost
+static void test_corrupted_crc(void) {
+    srand(2);
+    stream_len = 0;
+    int corrupted = 0;
+    for(int i = 0; i < STREAM_FRAMES; i++) {
+        make_frame(&sent[i], i);
+        size_t start = stream_len;
+        append_frame(&sent[i]);
+
+        if(i % 3 == 1) {
+            // Past the sync word, which is not covered by the CRC
+            size_t offset = 2 + rand() % (stream_len - start - 2);
+            stream[start + offset] ^= 1 << (rand() % 8);
+            sent[i].intact = false;
+            corrupted++;
+        }
+    }
+    check_stream(STREAM_FRAMES);
+    printf("  %d corrupted: %u frames, %u CRC errors, %u length errors\n", corrupted,
+        (unsigned)decoder.frames, (unsigned)decoder.crc_errors, (unsigned)decoder.len_errors);
+    TEST_CHECK(decoder.frames == (uint32_t)intact_count(STREAM_FRAMES));
+    TEST_CHECK(decoder.crc_errors + decoder.len_errors >= (uint32_t)corrupted);
+}
+
+// Noise, lone sync bytes and false frame starts between frames
+static void test_stray_sync_bytes(void) {
+    srand(3);
+    stream_len = 0;
+    for(int i = 0; i < STREAM_FRAMES; i++) {
+        switch(i % 5) {
+            case 1: {
+                static const uint8_t lone[] = { UART_FRAME_SYNC_0, UART_FRAME_SYNC_0, 0x00, UART_FRAME_SYNC_1 };
+                append(lone, sizeof(lone));
+                break;
+            }
+            case 2: {
+                // Sync word with a length above the maximum
+                static const uint8_t bad_len[] = { UART_FRAME_SYNC_0, UART_FRAME_SYNC_1, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF };
+                append(bad_len, sizeof(bad_len));
+                break;
+            }
+            case 3: {
+                // Sync word with a plausible header, swallows the next frames until its CRC fails
+                uint8_t false_start[UART_FRAME_HEADER_SIZE] = { UART_FRAME_SYNC_0, UART_FRAME_SYNC_1 };
+                false_start[10] = rand() & 0xFF;
+                false_start[11] = rand() % (UART_FRAME_MAX_PAYLOAD >> 8);
+                append(false_start, sizeof(false_start));
+                break;
+            }
+            case 4: {
+                uint8_t noise[16];
+                for(size_t n = 0; n < sizeof(noise); n++) noise[n] = rand();
+                append(noise, rand() % sizeof(noise));
+                break;
+            }
+        }
+        make_frame(&sent[i], i);
+        append_frame(&sent[i]);
+    }
+    check_stream(STREAM_FRAMES);
+    printf("  %u frames, %u CRC errors, %u length errors\n",
+        (unsigned)decoder.frames, (unsigned)decoder.crc_errors, (unsigned)decoder.len_errors);
+    TEST_CHECK(decoder.frames == STREAM_FRAMES);
+    TEST_CHECK(decoder.len_errors > 0);
+    TEST_CHECK(decoder.crc_errors > 0);
+}
+
+// Frame truncated by a reset of the sender, the next one still decodes
+static void test_truncated_frame(void) {
+    srand(4);
+    stream_len = 0;
+    for(int i = 0; i < 3; i++) {
+        make_frame(&sent[i], i);
+        sent[i].header.len = 64;
+    }
+    uint8_t out[UART_FRAME_OVERHEAD + UART_FRAME_MAX_PAYLOAD];
+    size_t len = uart_frame_encode(out, sizeof(out), &sent[0].header, sent[0].payload);
+    append(out, len / 2);
+    sent[0].intact = false;
+    append_frame(&sent[1]);
+    append_frame(&sent[2]);
+
+    check_stream(3);
+    TEST_CHECK(decoder.frames == 2);
+}
+
+// Reports only, host timings say little about the target
+static void test_benchmark(void) {
+    static uint8_t payload[BENCH_PAYLOAD];
+    for(int i = 0; i < BENCH_PAYLOAD; i++) payload[i] = i * 7;
+    uart_frame_header_t header = { .stream = UART_STREAM_MIC, .type = UART_FRAME_TYPE_I16, .len = BENCH_PAYLOAD };
+
+    stream_len = 0;
+    double start = now_s();
+    for(int i = 0; i < BENCH_FRAMES; i++) {
+        header.seq = i;
+        size_t len = uart_frame_encode(&stream[stream_len], STREAM_SIZE - stream_len, &header, payload);
+        TEST_CHECK(len);
+        stream_len += len;
+        if(STREAM_SIZE - stream_len < UART_FRAME_OVERHEAD + BENCH_PAYLOAD) stream_len = 0;
+    }
+    double encode = now_s() - start;
+
+    stream_len = 0;
+    for(int i = 0; i < 1000; i++) {
+        header.seq = i;
+        stream_len += uart_frame_encode(&stream[stream_len], STREAM_SIZE - stream_len, &header, payload);
+    }
+    uart_frame_decoder_init(&decoder);
+    int rounds = BENCH_FRAMES / 1000;
+    start = now_s();
+    for(int r = 0; r < rounds; r++) {
+        for(size_t i = 0; i < stream_len; i++) {
+            uart_frame_decoder_push(&decoder, stream[i]);
+        }
+    }
+    double decode = now_s() - start;
+    TEST_CHECK(decoder.frames >= (uint32_t)(rounds * 1000 - 1));
+
+    double bytes = (double)BENCH_FRAMES * (UART_FRAME_OVERHEAD + BENCH_PAYLOAD);
+    printf("  %d byte payloads: encode %.0f MB/s, decode %.0f MB/s\n", BENCH_PAYLOAD, bytes / encode * 1e-6, bytes / decode * 1e-6);
+}
+
+int main(void) {
+    TEST_RUN(test_crc_check_value);
+    TEST_RUN(test_encode_bounds);
+    TEST_RUN(test_round_trip);
+    TEST_RUN(test_corrupted_crc);
+    TEST_RUN(test_stray_sync_bytes);
+    TEST_RUN(test_truncated_frame);
+    TEST_RUN(test_benchmark);
+    return TEST_RESULT();
+}
@@ -33,8 +33,7 @@ static void initialize_nvs(void);
 // Task Handlers
 TaskHandle_t xTaskConsoleHandle;
 TaskHandle_t xTaskMPU6050Handle;
-TaskHandle_t xTaskI2CReadHandle;
-TaskHandle_t xTaskI2CWriteHandle;
+TaskHandle_t xTaskI2CHandle;
 TaskHandle_t xTaskUartHandle;
 
 
@@ -95,21 +94,12 @@ void app_main(void)
     }
 
     //Core 1
-    xTaskCreatePinnedToCore(vI2CWrite,
-                            "vI2CWrite",
+    xTaskCreatePinnedToCore(vI2CTask,
+                            "vI2CTask",
                             STACK_SIZE_2048 * 2,
                             NULL,
                             osPriorityHigh,
-                            &xTaskI2CWriteHandle,
-                            APP_CPU_NUM
-                            );
-
-    xTaskCreatePinnedToCore(vI2CRead,
-                            "vI2CRead",
-                            STACK_SIZE_2048 * 2,
-                            NULL,
-                            osPriorityHigh,
-                            &xTaskI2CReadHandle,
+                            &xTaskI2CHandle,
                             APP_CPU_NUM
                             );
 
@@ -8,8 +8,10 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "common.h"
+#include "app_mailbox.h"
 #include "task_console.h"
 #include "i2c_app.h"
 #include "i2c_driver.h"
@@ -36,13 +38,52 @@ TaskHandle_t xTaskBatteryHandle;
 static const char* TAG = "MidiControler";
 static midi_controller_state_e bio_midi_state = STATE_IDLE;
 
-QueueHandle_t xQueueAppData;
-static app_data_t dataReceived;
 
 // Flag connected to BLE
 static int8_t midi_connected = 0;
+
+// Controller tick, follows the BLE connection interval
+static TaskHandle_t midi_controller_task = NULL;
+static esp_timer_handle_t midi_tick_timer = NULL;
+static uint32_t midi_tick_period_us = 0;
 //**********************************************************************************************************
 
+static void midi_tick_callback(void * arg) {
+    xTaskNotifyGive(midi_controller_task);
+}
+
+static void midi_tick_start() {
+    uint32_t period = blemidi_get_conn_interval_us();
+    if(period < MIDI_TICK_MIN_US) {
+        period = MIDI_TICK_MIN_US;
+    }
+
+    esp_timer_stop(midi_tick_timer);
+    esp_err_t err = esp_timer_start_periodic(midi_tick_timer, period);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "ERROR Starting MIDI tick: %s", esp_err_to_name(err));
+        return;
+    }
+    midi_tick_period_us = period;
+    ESP_LOGI(TAG, "MIDI tick every %u us", (unsigned)period);
+}
+
+static void midi_tick_stop() {
+    esp_timer_stop(midi_tick_timer);
+    midi_tick_period_us = 0;
+}
+
+// The central may change the connection interval at any time
+static void midi_tick_follow_interval() {
+    uint32_t period = blemidi_get_conn_interval_us();
+    if(period < MIDI_TICK_MIN_US) {
+        period = MIDI_TICK_MIN_US;
+    }
+    if(period != midi_tick_period_us) {
+        midi_tick_start();
+    }
+}
+
 static void set_led_color(led_color_e color, uint16_t freq) {
     LED_Status led;
     memset(&led, 0, sizeof(LED_Status));
@@ -79,8 +120,10 @@ static void set_state(midi_controller_state_e new_state) {
     // Set App Group bit
     if(new_state == STATE_RUN) {
         xEventGroupSetBits(xEventGroupApp, BIT_APP_SEND_DATA);
+        midi_tick_start();
     }else{
         xEventGroupClearBits(xEventGroupApp, BIT_APP_SEND_DATA);
+        midi_tick_stop();
     }
 
     //Led Color according to state
@@ -149,7 +192,10 @@ void onDisconnect(){
 //**********************************************************************************************************
 // Midi Data processing
 const char * data_id_to_string[DATA_ID_MAX] = {"DATA_ID_ROLL","DATA_ID_PITCH", "DATA_ID_YAW", "DATA_ID_TEMPERATURE",
-                                              "DATA_ID_PRESSURE", "DATA_ID_FFT", "DATA_ID_HEART_RATE"};
+                                              "DATA_ID_PRESSURE", "DATA_ID_FFT", "DATA_ID_HEART_RATE",
+                                              "DATA_ID_BAND_0", "DATA_ID_BAND_1", "DATA_ID_BAND_2", "DATA_ID_BAND_3",
+                                              "DATA_ID_BAND_4", "DATA_ID_BAND_5", "DATA_ID_BAND_6", "DATA_ID_BAND_7",
+                                              "DATA_ID_RMS", "DATA_ID_CENTROID", "DATA_ID_FLUX"};
 
 static uint8_t map_value_u8(float value, float in_min, float in_max, uint8_t out_min, uint8_t out_max) {
     if(value > in_max) return out_max;
@@ -191,15 +237,36 @@ esp_err_t midi_proccess_data(data_id_e id, float value ) {
             midi_message.data = map_value_u8(value, 36, 37.5, 0, 127);
         break;
         case DATA_ID_FFT:
-
             midi_message.control_number = MIDI_CONTROLER_GPC_7;
-            midi_message.data = map_value_u8(value, 150, 200, 0, 127);
-            // ESP_LOGE(TAG, "FFT");
+            midi_message.data = map_value_u8(value, 0, 4000, 0, 127);
         break;
         case DATA_ID_HEART_RATE:
             midi_message.control_number = MIDI_CONTROLER_GPC_8;
             midi_message.data = map_value_u8(value, 20, 200, 0, 127);
         break;
+        case DATA_ID_BAND_0:
+        case DATA_ID_BAND_1:
+        case DATA_ID_BAND_2:
+        case DATA_ID_BAND_3:
+        case DATA_ID_BAND_4:
+        case DATA_ID_BAND_5:
+        case DATA_ID_BAND_6:
+        case DATA_ID_BAND_7:
+            midi_message.control_number = MIDI_CONTROLER_BAND_0 + (id - DATA_ID_BAND_0);
+            midi_message.data = map_value_u8(value, 150, 210, 0, 127);
+        break;
+        case DATA_ID_RMS:
+            midi_message.control_number = MIDI_CONTROLER_RMS;
+            midi_message.data = map_value_u8(value, 80, 150, 0, 127);
+        break;
+        case DATA_ID_CENTROID:
+            midi_message.control_number = MIDI_CONTROLER_CENTROID;
+            midi_message.data = map_value_u8(value, 0, 4000, 0, 127);
+        break;
+        case DATA_ID_FLUX:
+            midi_message.control_number = MIDI_CONTROLER_FLUX;
+            midi_message.data = map_value_u8(value, 0, 0.5, 0, 127);
+        break;
         case DATA_ID_MAX:
 
         break;
@@ -220,8 +287,8 @@ esp_err_t midi_proccess_data(data_id_e id, float value ) {
         return ESP_OK;
     }
     last_value[id] = midi_message.data;
-    ESP_LOGI(TAG, "0x%X | 0x%X | 0x%X - %d ", message[0], message[1], message[2], message[2]);
-    blemidi_tick();
+    ESP_LOGD(TAG, "0x%X | 0x%X | 0x%X - %d ", message[0], message[1], message[2], message[2]);
+    // Only buffered here, midi_send_changed() flushes the whole tick at once
     if(blemidi_send_message(0, message, 3) < 0 ) {
         ESP_LOGE(TAG, "ERROR sending message to BLEMIDI");
         return ESP_ERR_INVALID_STATE;
@@ -229,13 +296,49 @@ esp_err_t midi_proccess_data(data_id_e id, float value ) {
     return ESP_OK;
 }
 
+// Send the freshest value of every changed ID as one packet
+static void midi_send_changed(uint32_t dirty) {
+    if(dirty == 0) return;
+
+    // One timestamp for the tick, every message of the packet carries its low byte
+    blemidi_tick();
+    for(data_id_e id = 0; id < DATA_ID_MAX; id++) {
+        float value;
+        if((dirty & APP_MAILBOX_BIT(id)) && app_mailbox_read(id, &value, NULL)) {
+            midi_proccess_data(id, value);
+        }
+    }
+    blemidi_outbuffer_flush(0);
+}
+
+static void midi_send_battery_level() {
+    static int64_t last_send = 0;
+    int64_t now = esp_timer_get_time();
+    if(last_send != 0 && now - last_send < (int64_t)MIDI_BATTERY_PERIOD_MS * 1000) {
+        return;
+    }
+
+    uint8_t battery_level;
+    if(battery_app_read_percent(&battery_level) != ESP_OK) {
+        ESP_LOGE(TAG, "ERROR Reading Battery Level");
+        return;
+    }
+    blemidi_send_battery_level(battery_level);
+    last_send = now;
+}
+
 //**********************************************************************************************************
 // Midi Controller Task
 
 void vMidiController(void * pvParameters) {
 
-    // init app queue
-    xQueueAppData = xQueueCreate(16, sizeof(app_data_t));
+    // Sensors publish into the mailbox, the tick picks up what changed
+    midi_controller_task = xTaskGetCurrentTaskHandle();
+    const esp_timer_create_args_t midi_tick_args = {
+        .callback = &midi_tick_callback,
+        .name = "midi_tick",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&midi_tick_args, &midi_tick_timer));
 
     xTaskCreatePinnedToCore(vMPU6050Task,
                             "vMPU6050Task",
@@ -311,11 +414,7 @@ void vMidiController(void * pvParameters) {
     while(1) {
 
         // ESP_LOGI(TAG, "BioMidi State: %s", state_to_string[bio_midi_state], value);
-        uint8_t battery_level;
-        if(battery_app_read_percent(&battery_level) != ESP_OK) {
-            ESP_LOGE(TAG, "ERROR Reading Battery Level");
-        }
-        blemidi_send_battery_level(battery_level);
+        midi_send_battery_level();
 
         switch(bio_midi_state) {
             case STATE_IDLE:
@@ -347,9 +446,10 @@ void vMidiController(void * pvParameters) {
             break;
             case STATE_RUN:
             {
-                if( xQueueReceive( xQueueAppData, (void *)&dataReceived, portMAX_DELAY ) == pdPASS ) {
-                    midi_proccess_data(dataReceived.id, dataReceived.data);
-                }
+                // One pass per connection event, everything that changed goes out in one packet
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MIDI_TICK_TIMEOUT_MS));
+                midi_tick_follow_interval();
+                midi_send_changed(app_mailbox_take());
             }
             break;
             case STATE_SLEEP:
@@ -4,6 +4,21 @@
 #include <stdint.h>
 
 #define BIOMIDI_MIDI_CHANNEL    0xA
+
+// Fastest controller tick, the shortest BLE connection interval
+#ifndef MIDI_TICK_MIN_US
+#define MIDI_TICK_MIN_US            7500
+#endif
+
+// Longest wait for a tick before the state is looked at again
+#ifndef MIDI_TICK_TIMEOUT_MS
+#define MIDI_TICK_TIMEOUT_MS        100
+#endif
+
+// Battery level is sent this often
+#ifndef MIDI_BATTERY_PERIOD_MS
+#define MIDI_BATTERY_PERIOD_MS      10000
+#endif
 typedef enum {
     STATE_IDLE = 0,
     STATE_WAITING_CONNECTION,
@@ -43,6 +58,18 @@ typedef enum {
     MIDI_CONTROLER_GPC_6 = 0x51,
     MIDI_CONTROLER_GPC_7 = 0x52,
     MIDI_CONTROLER_GPC_8 = 0x53,
+    // Undefined controllers, used for the mic features
+    MIDI_CONTROLER_BAND_0 = 0x14,
+    MIDI_CONTROLER_BAND_1 = 0x15,
+    MIDI_CONTROLER_BAND_2 = 0x16,
+    MIDI_CONTROLER_BAND_3 = 0x17,
+    MIDI_CONTROLER_BAND_4 = 0x18,
+    MIDI_CONTROLER_BAND_5 = 0x19,
+    MIDI_CONTROLER_BAND_6 = 0x1A,
+    MIDI_CONTROLER_BAND_7 = 0x1B,
+    MIDI_CONTROLER_RMS = 0x1C,
+    MIDI_CONTROLER_CENTROID = 0x1D,
+    MIDI_CONTROLER_FLUX = 0x1E,
 }midi_controller_number_e;
 
 typedef struct {